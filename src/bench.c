@@ -0,0 +1,358 @@
+// Headless benchmark: runs the simulation without opening a window and reports the throughput of
+// each solver, as a table or as CSV for tracking scaling across releases and machines.
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXTLIB_IMPL
+#include "body.h"
+#include "extlib.h"
+#include "raylib.h"
+#include "recorder.h"
+#include "replay.h"
+#include "scenario.h"
+#include "simulation.h"
+#include "thread.h"
+#include "tuner.h"
+
+static const char* escape_keys[ESCAPE_COUNT] = {
+    [ESCAPE_KEEP] = "keep",
+    [ESCAPE_REMOVE] = "remove",
+    [ESCAPE_AGGREGATE] = "aggregate",
+};
+
+// Lets the tuner pick the solver before every substep (see tuner.h)
+#define SOLVER_AUTO (SOLVER_COUNT)
+
+typedef struct {
+    size_t bodies, steps, threads;
+    // Substeps between energy samples, 0 to leave energy diagnostics off
+    size_t energy_interval;
+    unsigned seed;
+    Scenario scenario;
+    size_t sweep_min, sweep_max;
+    int solver;  // -1 for all of them, or SOLVER_AUTO
+    bool block_steps;
+    bool merge;
+    // Keeps the bodies in the order they were generated
+    bool no_reorder;
+    EscapePolicy escape;
+    // Records every timed substep there unless NULL
+    const char* record;
+    // Replays this input log instead of benchmarking the solvers, unless NULL
+    const char* replay;
+    bool csv;
+} Options;
+
+typedef struct {
+    double seconds;
+    double steps_per_sec;
+    // Pairs of bodies whose forces were summed directly per second, counting one force pass per
+    // substep, or NAN unless every timed substep ran a direct solver
+    double pairs_per_sec;
+    double ns_per_body_step;
+    // Peak of the bytes allocated by the simulation, plus the pages of the job scratch arenas,
+    // which are kept until the end once grown
+    size_t peak_bytes;
+    size_t threads;
+    // Largest relative drift of the total energy over the timed steps, if sampled
+    double max_drift;
+} Result;
+
+// Wraps the default allocator keeping track of the peak of live bytes.
+// Only the thread driving the simulation allocates through it, so no synchronization is needed:
+// job workers and the recorder's writer thread take their memory from the default allocator.
+typedef struct {
+    Ext_Allocator base;
+    size_t allocated, peak;
+} TrackingAllocator;
+
+static void track(TrackingAllocator* a, size_t old_size, size_t new_size) {
+    a->allocated = a->allocated - old_size + new_size;
+    if(a->allocated > a->peak) a->peak = a->allocated;
+}
+
+static void* tracking_alloc(Ext_Allocator* a, size_t size) {
+    track((TrackingAllocator*)a, 0, size);
+    return ext_default_allocator.base.alloc(&ext_default_allocator.base, size);
+}
+
+static void* tracking_realloc(Ext_Allocator* a, void* ptr, size_t old_size, size_t new_size) {
+    track((TrackingAllocator*)a, old_size, new_size);
+    return ext_default_allocator.base.realloc(&ext_default_allocator.base, ptr, old_size, new_size);
+}
+
+static void tracking_free(Ext_Allocator* a, void* ptr, size_t size) {
+    if(!ptr) return;
+    track((TrackingAllocator*)a, size, 0);
+    ext_default_allocator.base.free(&ext_default_allocator.base, ptr, size);
+}
+
+static const char* solver_key(int solver) {
+    return solver == SOLVER_AUTO ? "auto" : solver_keys[solver];
+}
+
+static Result run(int solver, size_t n, const Options* opt) {
+    TrackingAllocator tracker = {{tracking_alloc, tracking_realloc, tracking_free}, 0, 0};
+    ext_push_context_allocator(&tracker.base);
+
+    Simulation sim;
+    simulation_init(&sim, opt->threads);
+    sim.solver = solver == SOLVER_AUTO ? SOLVER_BARNES_HUT : (Solver)solver;
+    sim.block_steps = opt->block_steps;
+    sim.merge = opt->merge;
+    sim.reorder = !opt->no_reorder;
+    sim.escape = opt->escape;
+    sim.bodies.allocator = &tracker.base;
+#ifdef SIMULATION_ENERGY
+    sim.energy_interval = opt->energy_interval;
+#endif
+    // The default scale keeps the density (and thus the Barnes-Hut tree shape) comparable across
+    // body counts
+    scenario_generate(&sim.bodies,
+                      &(ScenarioConfig){.kind = opt->scenario, .bodies = n, .seed = opt->seed});
+
+    // Untimed step, so that lazily grown buffers (tree arena, job deques) are already in place,
+    // and the first trials of the tuner are done
+    Tuner tuner = tuner_new();
+    Tuner* tuned = solver == SOLVER_AUTO ? &tuner : NULL;
+    const float dt = 1.0f / SIMULATION_STEPS;
+    if(tuned) tuner_update(tuned, &sim);
+    simulation_step(&sim, dt);
+
+    Recorder rec = {0};
+    if(opt->record && !recorder_start(&rec, opt->record, 1, RECORDER_DELTA)) exit(1);
+
+    // Only the active bodies get their forces computed with block timesteps
+    double pairs = 0;
+    double start = thread_clock();
+    for(size_t i = 0; i < opt->steps; i++) {
+        if(tuned) tuner_update(tuned, &sim);
+        bool direct = sim.solver == SOLVER_DIRECT || sim.solver == SOLVER_DIRECT_SIMD;
+        simulation_step(&sim, dt);
+        pairs += direct ? (double)sim.active * (sim.bodies.size - 1) : NAN;
+        recorder_capture(&rec, &sim.bodies, sim.steps, sim.generation);
+    }
+    double seconds = thread_clock() - start;
+
+    if(opt->record) {
+        recorder_stop(&rec);
+        fprintf(stderr, "%s: recorded %zu frames (%zu dropped), %.2f MiB\n", solver_key(solver),
+                atomic_load(&rec.frames), atomic_load(&rec.dropped),
+                atomic_load(&rec.bytes) / (1024.0 * 1024.0));
+    }
+
+    Result res = {
+        .seconds = seconds,
+        .steps_per_sec = opt->steps / seconds,
+        .pairs_per_sec = pairs / seconds,
+        .ns_per_body_step = seconds * 1e9 / ((double)n * opt->steps),
+        .peak_bytes = tracker.peak + ext_arena_pool_stats(&sim.pool.scratch).reserved,
+        .threads = sim.pool.workers,
+#ifdef SIMULATION_ENERGY
+        .max_drift = sim.energy.max_drift,
+#endif
+    };
+
+    tuner_destroy(&tuner);
+    simulation_destroy(&sim);
+    ext_pop_context();
+    return res;
+}
+
+// Replays an input log logged by `raylib-gravity --log`, reporting how long it took and whether it
+// reproduced the logged state. Returns the exit code: non-zero on mismatch, so that `git bisect
+// run` can look for what broke determinism.
+static int replay(const Options* opt) {
+    Simulation sim;
+    simulation_init(&sim, opt->threads);
+#ifdef SIMULATION_ENERGY
+    sim.energy_interval = opt->energy_interval;
+#endif
+    uint64_t expected;
+    double start = thread_clock();
+    bool ok = replay_run(opt->replay, &sim, NULL, &expected);
+    double seconds = thread_clock() - start;
+
+    uint64_t checksum = input_checksum(&sim);
+    printf("replayed %zu substeps in %.3f s (%.2f steps/s) on %zu threads, %zu bodies\n",
+           sim.steps, seconds, sim.steps / seconds, sim.pool.workers, sim.bodies.size);
+    int status = 0;
+    if(!ok) {
+        status = 1;
+    } else if(!expected) {
+        printf("checksum %016" PRIx64 ", the log has no end to compare with\n", checksum);
+    } else if(checksum != expected) {
+        printf("checksum %016" PRIx64 " doesn't match the logged %016" PRIx64 "\n", checksum,
+               expected);
+        status = 1;
+    } else {
+        printf("checksum %016" PRIx64 " matches\n", checksum);
+    }
+    simulation_destroy(&sim);
+    return status;
+}
+
+static void print_header(const Options* opt) {
+    if(opt->csv) {
+        printf("solver,bodies,steps,threads,seconds,steps_per_sec,pairs_per_sec,"
+               "ns_per_body_step,peak_bytes,max_energy_drift\n");
+    } else {
+        printf("%-12s %9s %7s %7s %12s %12s %14s %10s %12s\n", "solver", "bodies", "steps",
+               "threads", "steps/s", "pairs/s", "ns/body-step", "peak MiB", "energy drift");
+    }
+}
+
+static void print_result(int solver, size_t n, const Options* opt, const Result* r) {
+    // Left blank for the approximate solvers, whose cost isn't in pairs
+    char pairs[32] = "";
+    if(!isnan(r->pairs_per_sec)) {
+        snprintf(pairs, sizeof(pairs), opt->csv ? "%.6e" : "%.4e", r->pairs_per_sec);
+    } else if(!opt->csv) {
+        strcpy(pairs, "-");
+    }
+    if(opt->csv) {
+        printf("%s,%zu,%zu,%zu,%.6f,%.3f,%s,%.3f,%zu,%.6e\n", solver_key(solver), n, opt->steps,
+               r->threads, r->seconds, r->steps_per_sec, pairs, r->ns_per_body_step,
+               r->peak_bytes, r->max_drift);
+    } else {
+        printf("%-12s %9zu %7zu %7zu %12.2f %12s %14.2f %10.2f %12.4e\n", solver_key(solver), n,
+               opt->steps, r->threads, r->steps_per_sec, pairs, r->ns_per_body_step,
+               r->peak_bytes / (1024.0 * 1024.0), r->max_drift);
+    }
+    fflush(stdout);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "built with the %s integrator at %d substeps per simulated second\n"
+            "  -n N             number of bodies (default: 4096)\n"
+            "  -s STEPS         number of timed substeps (default: %d)\n"
+            "  -t THREADS       worker threads, 0 for one per hardware thread (default: 0)\n"
+            "  --solver NAME    only run one solver: direct, simd, barnes-hut, pm or p3m, or\n"
+            "                   auto to let the tuner pick them\n"
+            "  --sweep MIN MAX  run every power of two number of bodies in [MIN, MAX]\n"
+            "  --scenario NAME  initial conditions: plummer, disk, collision or uniform\n"
+            "                   (default: uniform)\n"
+            "  --seed SEED      seed for the initial conditions (default: 1)\n"
+            "  --energy K       sample the energy drift every K substeps (default: off)\n"
+            "  --block          use block timesteps, Verlet integrator only\n"
+            "  --merge          merge colliding bodies, throughput is still counted for N\n"
+            "  --no-reorder     never sort the bodies along a Morton curve\n"
+            "  --escape POLICY  what happens to escaped bodies: keep, remove or aggregate\n"
+            "                   (default: keep)\n"
+            "  --record PATH    record the positions after every timed substep to PATH\n"
+            "  --replay LOG     replay an input log of raylib-gravity --log and check that it\n"
+            "                   reproduces the logged state, instead of benchmarking\n"
+            "  --csv            print results as CSV\n",
+            prog, integrator_name, SIMULATION_STEPS, SIMULATION_STEPS);
+}
+
+static bool parse_size(const char* s, size_t* out) {
+    char* end;
+    unsigned long long v = strtoull(s, &end, 10);
+    if(*s == '\0' || *end != '\0') return false;
+    *out = v;
+    return true;
+}
+
+static bool parse_args(int argc, char** argv, Options* opt) {
+    for(int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_next = i + 1 < argc;
+        size_t seed;
+        if(strcmp(arg, "-n") == 0 && has_next) {
+            if(!parse_size(argv[++i], &opt->bodies) || !opt->bodies) return false;
+        } else if(strcmp(arg, "-s") == 0 && has_next) {
+            if(!parse_size(argv[++i], &opt->steps) || !opt->steps) return false;
+        } else if(strcmp(arg, "-t") == 0 && has_next) {
+            if(!parse_size(argv[++i], &opt->threads)) return false;
+        } else if(strcmp(arg, "--seed") == 0 && has_next) {
+            if(!parse_size(argv[++i], &seed)) return false;
+            opt->seed = (unsigned)seed;
+        } else if(strcmp(arg, "--energy") == 0 && has_next) {
+            if(!parse_size(argv[++i], &opt->energy_interval)) return false;
+        } else if(strcmp(arg, "--sweep") == 0 && i + 2 < argc) {
+            if(!parse_size(argv[++i], &opt->sweep_min) || !opt->sweep_min) return false;
+            if(!parse_size(argv[++i], &opt->sweep_max)) return false;
+            if(opt->sweep_max < opt->sweep_min) return false;
+        } else if(strcmp(arg, "--solver") == 0 && has_next) {
+            const char* name = argv[++i];
+            opt->solver = strcmp(name, "auto") == 0 ? SOLVER_AUTO : -1;
+            for(int s = 0; s < SOLVER_COUNT; s++) {
+                if(strcmp(name, solver_keys[s]) == 0) opt->solver = s;
+            }
+            if(opt->solver < 0) return false;
+        } else if(strcmp(arg, "--scenario") == 0 && has_next) {
+            const char* name = argv[++i];
+            int scenario = -1;
+            for(int k = 0; k < SCENARIO_COUNT; k++) {
+                if(strcmp(name, scenario_names[k]) == 0) scenario = k;
+            }
+            if(scenario < 0) return false;
+            opt->scenario = scenario;
+        } else if(strcmp(arg, "--block") == 0) {
+            opt->block_steps = true;
+        } else if(strcmp(arg, "--merge") == 0) {
+            opt->merge = true;
+        } else if(strcmp(arg, "--no-reorder") == 0) {
+            opt->no_reorder = true;
+        } else if(strcmp(arg, "--escape") == 0 && has_next) {
+            const char* name = argv[++i];
+            int policy = -1;
+            for(int p = 0; p < ESCAPE_COUNT; p++) {
+                if(strcmp(name, escape_keys[p]) == 0) policy = p;
+            }
+            if(policy < 0) return false;
+            opt->escape = policy;
+        } else if(strcmp(arg, "--replay") == 0 && has_next) {
+            opt->replay = argv[++i];
+        } else if(strcmp(arg, "--record") == 0 && has_next) {
+            opt->record = argv[++i];
+        } else if(strcmp(arg, "--csv") == 0) {
+            opt->csv = true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options opt = {
+        .bodies = 4096,
+        .steps = SIMULATION_STEPS,
+        .seed = 1,
+        .scenario = SCENARIO_UNIFORM,
+        .solver = -1,
+    };
+    if(!parse_args(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if(opt.replay) return replay(&opt);
+
+    // Round the sweep bounds to powers of two
+    size_t first = opt.bodies, last = opt.bodies;
+    if(opt.sweep_min) {
+        first = 1;
+        while(first < opt.sweep_min) first <<= 1;
+        last = opt.sweep_max;
+    }
+
+    print_header(&opt);
+    for(size_t n = first; n <= last; n <<= 1) {
+        for(int s = 0; s <= SOLVER_AUTO; s++) {
+            if(opt.solver >= 0 ? s != opt.solver : s == SOLVER_AUTO) continue;
+            Result r = run(s, n, &opt);
+            print_result(s, n, &opt, &r);
+        }
+        if(!opt.sweep_min) break;
+    }
+}
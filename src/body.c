@@ -0,0 +1,92 @@
+#include "body.h"
+
+#include <string.h>
+
+static void bodies_grow(CelestialBodies* b, size_t newcap) {
+    if(!b->allocator) b->allocator = ext_context->alloc;
+#define X(T, name)                                                                            \
+    if(!b->name) {                                                                            \
+        b->name = b->allocator->alloc(b->allocator, newcap * sizeof(T));                      \
+    } else {                                                                                  \
+        b->name = b->allocator->realloc(b->allocator, b->name, b->capacity * sizeof(T),       \
+                                        newcap * sizeof(T));                                  \
+    }
+    CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    b->capacity = newcap;
+}
+
+void bodies_reserve(CelestialBodies* b, size_t requested_cap) {
+    if(b->capacity < requested_cap) {
+        size_t newcap = b->capacity ? b->capacity * 2 : EXT_ARRAY_INIT_CAP;
+        while(newcap < requested_cap) newcap *= 2;
+        bodies_grow(b, newcap);
+    }
+}
+
+void bodies_reserve_exact(CelestialBodies* b, size_t requested_cap) {
+    if(b->capacity < requested_cap) {
+        bodies_grow(b, requested_cap);
+    }
+}
+
+void bodies_push(CelestialBodies* b, CelestialBody body) {
+    bodies_reserve(b, b->size + 1);
+    size_t i = b->size++;
+    b->position[i] = body.position;
+    b->velocity[i] = body.velocity;
+    b->force[i] = body.force;
+    b->mass[i] = 1.0f / body.inv_mass;
+    b->inv_mass[i] = body.inv_mass;
+    b->level[i] = body.level;
+    b->radius[i] = body.radius;
+    b->color[i] = body.color;
+    b->id[i] = b->next_id++;
+}
+
+CelestialBody bodies_get(const CelestialBodies* b, size_t idx) {
+    EXT_ASSERT(idx < b->size, "body index out of bounds");
+    return (CelestialBody){
+        .position = b->position[idx],
+        .force = b->force[idx],
+        .velocity = b->velocity[idx],
+        .radius = b->radius[idx],
+        .inv_mass = b->inv_mass[idx],
+        .color = b->color[idx],
+        .level = b->level[idx],
+    };
+}
+
+void bodies_swap_remove(CelestialBodies* b, size_t idx) {
+    EXT_ASSERT(idx < b->size, "body index out of bounds");
+    size_t last = b->size - 1;
+    if(idx < last) {
+#define X(T, name) b->name[idx] = b->name[last];
+        CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    }
+    b->size--;
+}
+
+void bodies_copy(CelestialBodies* dst, const CelestialBodies* src) {
+    bodies_reserve_exact(dst, src->size);
+#define X(T, name) \
+    if(src->size) memcpy(dst->name, src->name, src->size * sizeof(T));
+    CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    dst->size = src->size;
+    dst->next_id = src->next_id;
+}
+
+void bodies_clear(CelestialBodies* b) {
+    b->size = 0;
+}
+
+void bodies_free(CelestialBodies* b) {
+    if(b->allocator) {
+#define X(T, name) b->allocator->free(b->allocator, b->name, b->capacity * sizeof(T));
+        CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    }
+    memset(b, 0, sizeof(*b));
+}
@@ -0,0 +1,81 @@
+#ifndef BODY_H
+#define BODY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "extlib.h"
+#include "raylib.h"
+
+#define G (30)
+
+// A single body, used to create and inspect bodies one at a time.
+// The simulation itself stores bodies as a structure of arrays (see `CelestialBodies`).
+typedef struct CelestialBody {
+    Vector2 position;
+    Vector2 force;
+    Vector2 velocity;
+    float radius;
+    float inv_mass;
+    Color color;
+    // Block timestep level, see `BLOCK_MAX_LEVEL`
+    uint8_t level;
+} CelestialBody;
+
+// Structure-of-arrays body storage. Every field is its own contiguous array of `size` elements, so
+// passes over the bodies only stream the data they actually use.
+// All arrays share `size` and `capacity` and grow together with the same semantics of the
+// `ext_array_*` macros: capacity doubles starting from `EXT_ARRAY_INIT_CAP`, and `allocator`
+// defaults to the current context allocator on first allocation.
+typedef struct {
+    // Hot data, touched by the force and integration passes
+    Vector2* position;
+    Vector2* velocity;
+    Vector2* force;
+    float* mass;
+    float* inv_mass;
+    uint8_t* level;
+
+    // Cold data, only used for rendering
+    float* radius;
+    Color* color;
+    // Identifier of each body, kept as the bodies get reordered and never reused, so that bodies
+    // can be told apart across reorderings
+    uint32_t* id;
+
+    size_t size, capacity;
+    // Identifier of the next body added
+    uint32_t next_id;
+    Allocator* allocator;
+} CelestialBodies;
+
+// X-macro listing all the arrays of `CelestialBodies`. Keep in sync with the struct above.
+#define CELESTIAL_BODIES_FIELDS(X) \
+    X(Vector2, position)           \
+    X(Vector2, velocity)           \
+    X(Vector2, force)              \
+    X(float, mass)                 \
+    X(float, inv_mass)             \
+    X(uint8_t, level)              \
+    X(float, radius)               \
+    X(Color, color)                \
+    X(uint32_t, id)
+
+// Same as `ext_array_reserve`, applied to all arrays
+void bodies_reserve(CelestialBodies* bodies, size_t requested_cap);
+// Same as `ext_array_reserve_exact`, applied to all arrays
+void bodies_reserve_exact(CelestialBodies* bodies, size_t requested_cap);
+// Appends a new body with a new identifier, growing the arrays if necessary
+void bodies_push(CelestialBodies* bodies, CelestialBody body);
+// Gathers the body at `idx` from all the arrays
+CelestialBody bodies_get(const CelestialBodies* bodies, size_t idx);
+// Removes the body at `idx` by swapping it with the last one. Complexity O(1).
+void bodies_swap_remove(CelestialBodies* bodies, size_t idx);
+// Replaces the content of `dst` with a copy of all the bodies in `src`
+void bodies_copy(CelestialBodies* dst, const CelestialBodies* src);
+// Removes all bodies. Complexity O(1).
+void bodies_clear(CelestialBodies* bodies);
+// Frees all the arrays
+void bodies_free(CelestialBodies* bodies);
+
+#endif
@@ -0,0 +1,120 @@
+#include "collision.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "raymath.h"
+
+// Cell coordinates are clamped so that bodies far away can't overflow them
+#define CELL_LIMIT (1 << 30)
+// End of a chain of bodies
+#define NO_BODY UINT32_MAX
+
+static CellKey cell_of(Vector2 p, float inv_size) {
+    return (CellKey){
+        (int32_t)Clamp(floorf(p.x * inv_size), -CELL_LIMIT, CELL_LIMIT),
+        (int32_t)Clamp(floorf(p.y * inv_size), -CELL_LIMIT, CELL_LIMIT),
+    };
+}
+
+static inline bool takes_part(const CelestialBodies* b, size_t i, size_t tick) {
+    return tick % (1u << b->level[i]) == 0;
+}
+
+// Merges body `j` into body `i`, leaving `j` with no mass to be removed afterwards. Returns the
+// energy taken out of the bodies: the kinetic energy of their relative motion, and their potential
+// energy on each other. Merged at their center of mass, their potential energy with the others only
+// changes to second order in their distance, which is neglected.
+static double merge(CelestialBodies* b, size_t i, size_t j) {
+    float mi = b->mass[i], mj = b->mass[j], m = mi + mj;
+    // K = 1/2 * mu * |vi - vj|^2 with mu the reduced mass, U = -G * (mi * mj / r)
+    double mu = (double)mi * mj / m;
+    double kinetic = 0.5 * mu * Vector2DistanceSqr(b->velocity[i], b->velocity[j]);
+    double r2 = fmax(Vector2DistanceSqr(b->position[i], b->position[j]), 1e-6);
+    double potential = -G * ((double)mi * mj) / sqrt(r2);
+    b->position[i] = Vector2Lerp(b->position[i], b->position[j], mj / m);
+    b->velocity[i] = Vector2Lerp(b->velocity[i], b->velocity[j], mj / m);
+    // Their attraction on each other cancels out, leaving the force of all the other bodies
+    b->force[i] = Vector2Add(b->force[i], b->force[j]);
+    // As large as both together
+    b->radius[i] = sqrtf(b->radius[i] * b->radius[i] + b->radius[j] * b->radius[j]);
+    if(mj > mi) b->color[i] = b->color[j];
+    if(b->level[j] < b->level[i]) b->level[i] = b->level[j];
+    b->mass[i] = m;
+    b->inv_mass[i] = 1 / m;
+    b->mass[j] = 0;
+    return kinetic + potential;
+}
+
+size_t collisions_merge(Collisions* c, CelestialBodies* b, size_t tick, double* energy) {
+    if(b->size < 2) return 0;
+
+    float max_radius = 0;
+    size_t taking_part = 0;
+    for(size_t i = 0; i < b->size; i++) {
+        if(!takes_part(b, i, tick)) continue;
+        max_radius = fmaxf(max_radius, b->radius[i]);
+        taking_part++;
+    }
+    if(max_radius <= 0) return 0;
+    float inv_size = 0.5f / max_radius;
+
+    if(c->capacity < b->size) {
+        size_t newcap = c->capacity ? c->capacity : 256;
+        while(newcap < b->size) newcap *= 2;
+        c->next = ext_realloc(c->next, sizeof(uint32_t) * c->capacity, sizeof(uint32_t) * newcap);
+        c->capacity = newcap;
+    }
+
+    // Bodies are pushed in front of their cell's chain, so going backwards every chain ends up
+    // sorted by index
+    // At most one cell per body, so the map never grows while filling it
+    if(c->cells.hashes) ext_hmap_clear(&c->cells);
+    ext_hmap_reserve(&c->cells, taking_part);
+    for(size_t i = b->size; i-- > 0;) {
+        if(!takes_part(b, i, tick)) continue;
+        CellEntry* e;
+        ext_hmap_get_default_int(&c->cells, cell_of(b->position[i], inv_size), NO_BODY, &e);
+        c->next[i] = e->value;
+        e->value = i;
+    }
+
+    // Each pair is tested once, from its lowest index. Bodies that grew by merging keep looking
+    // around their new position, anything they now miss is caught on the next call.
+    size_t merged = 0;
+    for(size_t i = 0; i < b->size; i++) {
+        if(b->mass[i] == 0 || !takes_part(b, i, tick)) continue;
+        CellKey k = cell_of(b->position[i], inv_size);
+        for(int dy = -1; dy <= 1; dy++) {
+            for(int dx = -1; dx <= 1; dx++) {
+                CellEntry* e;
+                ext_hmap_get_int(&c->cells, ((CellKey){k.x + dx, k.y + dy}), &e);
+                if(!e) continue;
+                for(uint32_t j = e->value; j != NO_BODY; j = c->next[j]) {
+                    if(j <= i || b->mass[j] == 0) continue;
+                    float r = b->radius[i] + b->radius[j];
+                    if(Vector2DistanceSqr(b->position[i], b->position[j]) < r * r) {
+                        double removed = merge(b, i, j);
+                        if(energy) *energy += removed;
+                        merged++;
+                    }
+                }
+            }
+        }
+    }
+
+    // Going backwards, the last body swapped into a removed one's place was always kept
+    if(merged) {
+        for(size_t i = b->size; i-- > 0;) {
+            if(b->mass[i] == 0) bodies_swap_remove(b, i);
+        }
+    }
+    return merged;
+}
+
+void collisions_destroy(Collisions* c) {
+    ext_hmap_free(&c->cells);
+    if(c->next) ext_free(c->next, sizeof(uint32_t) * c->capacity);
+    c->next = NULL;
+    c->capacity = 0;
+}
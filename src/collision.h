@@ -0,0 +1,51 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "body.h"
+#include "extlib.h"
+
+// Inelastic merging of colliding bodies.
+// Bodies are binned by center into a uniform grid of cells as wide as the largest body, stored
+// sparsely in a hashmap keyed by cell coordinates, so any two touching bodies are at most one cell
+// apart and each body only needs to be tested against the 3x3 block of cells around it. The grid
+// is rebuilt on every call, which costs O(N) rather than the O(N^2) of testing every pair.
+// Coordinates are hashed together as a single 64 bit integer (see `ext_hmap_get_int`).
+
+typedef struct {
+    int32_t x, y;
+} CellKey;
+
+typedef struct {
+    CellKey key;
+    // First body in the cell, the others are chained through `Collisions.next`
+    uint32_t value;
+} CellEntry;
+
+typedef struct {
+    CellEntry* entries;
+    size_t* hashes;
+    size_t size, capacity;
+    Ext_Allocator* allocator;
+} CellMap;
+
+// The map and chains are kept between calls, so after the first few they don't allocate at all
+typedef struct {
+    CellMap cells;
+    uint32_t* next;
+    size_t capacity;
+} Collisions;
+
+// Merges every pair of overlapping bodies into one, conserving mass and momentum and placed at
+// their center of mass, then removes the absorbed bodies with `bodies_swap_remove`. Only bodies
+// whose step ends at substep `tick` (see `BLOCK_MAX_LEVEL`) take part, as the velocity of the
+// others isn't known at this time, 0 for all of them. Unless `energy` is NULL, adds the energy the
+// merges took out of the bodies to it, kinetic energy lost and potential energy of the merged
+// pairs. Returns the number of bodies removed.
+size_t collisions_merge(Collisions* c, CelestialBodies* b, size_t tick, double* energy);
+// Frees all memory associated with the broadphase
+void collisions_destroy(Collisions* c);
+
+#endif
@@ -0,0 +1,115 @@
+#include "ephemeris.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "extlib.h"
+
+void ephemeris_init(Ephemeris* e) {
+    *e = (Ephemeris){0};
+    // Ephemerides are computed by the thread that asks for them, no need for extra workers
+    simulation_init(&e->sim, 1);
+    // The copies come in the order of the live simulation, which is recent enough for predictions
+    e->sim.reorder = false;
+}
+
+EphemerisDynamics ephemeris_dynamics(const Simulation* sim) {
+    return (EphemerisDynamics){
+        .solver = sim->solver,
+        .theta = sim->tree.theta,
+        .steps = sim->steps,
+        .block_steps = sim->block_steps,
+        .blocks = sim->blocks,
+        .merge = sim->merge,
+        .escape = sim->escape,
+        .escape_radius = sim->escape_radius,
+        .far = sim->far,
+    };
+}
+
+void ephemeris_begin(Ephemeris* e, const CelestialBodies* bodies,
+                     const EphemerisDynamics* dynamics, size_t rows) {
+    Simulation* sim = &e->sim;
+    bodies_copy(&sim->bodies, bodies);
+    sim->solver = dynamics->solver;
+    sim->tree.theta = dynamics->theta;
+    // Block timesteps in progress carry on where the live simulation is in them
+    sim->steps = dynamics->steps;
+    sim->block_steps = dynamics->block_steps;
+    sim->blocks = dynamics->blocks;
+    sim->merge = dynamics->merge;
+    sim->escape = dynamics->escape;
+    sim->escape_radius = dynamics->escape_radius;
+    sim->far = dynamics->far;
+
+    e->count = bodies->size;
+    e->start = e->end = 0;
+    e->rows = rows;
+    size_t row_bytes = e->count * (sizeof(Vector2) + sizeof(float)) + sizeof(size_t) +
+                       sizeof(FarField);
+    if(e->rows > EPHEMERIS_MAX_BYTES / row_bytes) e->rows = EPHEMERIS_MAX_BYTES / row_bytes;
+
+    // Previous content doesn't need to be preserved
+    size_t needed = e->rows * e->count;
+    if(e->capacity < needed) {
+        if(e->positions) ext_free(e->positions, sizeof(Vector2) * e->capacity);
+        if(e->masses) ext_free(e->masses, sizeof(float) * e->capacity);
+        e->positions = ext_alloc(sizeof(Vector2) * needed);
+        e->masses = ext_alloc(sizeof(float) * needed);
+        e->capacity = needed;
+    }
+    if(e->rows_capacity < e->rows) {
+        if(e->sizes) ext_free(e->sizes, sizeof(size_t) * e->rows_capacity);
+        if(e->far) ext_free(e->far, sizeof(FarField) * e->rows_capacity);
+        e->sizes = ext_alloc(sizeof(size_t) * e->rows);
+        e->far = ext_alloc(sizeof(FarField) * e->rows);
+        e->rows_capacity = e->rows;
+    }
+}
+
+void ephemeris_extend(Ephemeris* e, size_t steps, float dt) {
+    const CelestialBodies* b = &e->sim.bodies;
+    for(size_t i = 0; i < steps && e->end - e->start < e->rows; i++) {
+        simulation_step(&e->sim, dt);
+        // Bodies only ever get merged or removed, so they still fit the row
+        size_t row = e->end % e->rows;
+        e->sizes[row] = b->size;
+        e->far[row] = e->sim.far;
+        if(b->size) {
+            memcpy(&e->positions[row * e->count], b->position, sizeof(Vector2) * b->size);
+            memcpy(&e->masses[row * e->count], b->mass, sizeof(float) * b->size);
+        }
+        e->end++;
+    }
+}
+
+void ephemeris_discard(Ephemeris* e, size_t step) {
+    if(step > e->end) step = e->end;
+    if(step > e->start) e->start = step;
+}
+
+const Vector2* ephemeris_positions(const Ephemeris* e, size_t step, size_t* size) {
+    EXT_ASSERT(step >= e->start && step < e->end, "substep not in the ephemeris");
+    *size = e->sizes[step % e->rows];
+    return &e->positions[(step % e->rows) * e->count];
+}
+
+Vector2 ephemeris_force(const Ephemeris* e, size_t step, Vector2 pos, float m) {
+    size_t size;
+    const Vector2* positions = ephemeris_positions(e, step, &size);
+    const float* masses = &e->masses[(step % e->rows) * e->count];
+    Vector2 force = apply_forces(positions, masses, size, pos, m, SIZE_MAX, NULL);
+    // The aggregate pulls as it does in the force pass of the simulation
+    const FarField* far = &e->far[step % e->rows];
+    if(far->mass > 0) force = Vector2Add(force, far_field_force(far, pos, m, NULL));
+    return force;
+}
+
+void ephemeris_destroy(Ephemeris* e) {
+    if(e->positions) ext_free(e->positions, sizeof(Vector2) * e->capacity);
+    if(e->masses) ext_free(e->masses, sizeof(float) * e->capacity);
+    if(e->sizes) ext_free(e->sizes, sizeof(size_t) * e->rows_capacity);
+    if(e->far) ext_free(e->far, sizeof(FarField) * e->rows_capacity);
+    simulation_destroy(&e->sim);
+    *e = (Ephemeris){0};
+}
@@ -0,0 +1,77 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <stddef.h>
+
+#include "raylib.h"
+#include "simulation.h"
+
+// Future positions of the bodies, used to predict the trajectory of a body before spawning it.
+// The bodies are copied when a drag starts and advanced with the same dynamics as the simulation
+// (solver, block timesteps, merging and escapes), recording their positions and masses, and the
+// far-field aggregate, substep by substep. Rows after a merge or an escape hold fewer bodies, in
+// another order. Any number of candidate trajectories can then be integrated against the moving
+// bodies at O(N) per step, all reusing the same ephemeris.
+//
+// Substeps are identified by their absolute index since `ephemeris_begin`: positions for substeps
+// in [start, end) are available, stored in a ring of `rows` substeps so that the ephemeris can keep
+// running ahead of the simulation for as long as it's needed.
+
+// Upper bound for the memory used by the rows. Past it, predictions get shorter as N grows.
+#define EPHEMERIS_MAX_BYTES (256 << 20)
+
+// What the simulation advances the bodies with besides the bodies themselves, taken from the live
+// one with `ephemeris_dynamics`
+typedef struct {
+    Solver solver;
+    float theta;
+    // Substeps done, which set when block timesteps end and escapes are checked
+    size_t steps;
+    bool block_steps, blocks, merge;
+    EscapePolicy escape;
+    float escape_radius;
+    FarField far;
+} EphemerisDynamics;
+
+typedef struct {
+    // Number of bodies at `ephemeris_begin`, the most a row holds
+    size_t count;
+    // Range of substeps available
+    size_t start, end;
+    // Maximum number of substeps that can be kept at once
+    size_t rows;
+
+    // Private fields
+    // Rows of `count` positions and masses, of which the first `sizes[row]` are bodies, along with
+    // the far-field aggregate
+    Vector2* positions;
+    float* masses;
+    size_t* sizes;
+    FarField* far;
+    size_t capacity, rows_capacity;
+    // Copy of the bodies, advanced up to substep `end`
+    Simulation sim;
+} Ephemeris;
+
+// Initializes an empty ephemeris. The ephemeris must not be moved afterwards.
+void ephemeris_init(Ephemeris* e);
+// Dynamics `sim` currently advances its bodies with
+EphemerisDynamics ephemeris_dynamics(const Simulation* sim);
+// Discards the current ephemeris and starts a new one from `bodies`, advanced with `dynamics`,
+// keeping at most `rows` substeps at a time
+void ephemeris_begin(Ephemeris* e, const CelestialBodies* bodies,
+                     const EphemerisDynamics* dynamics, size_t rows);
+// Computes up to `steps` more substeps of `dt` seconds, as long as they fit in the ring
+void ephemeris_extend(Ephemeris* e, size_t steps, float dt);
+// Forgets all the substeps before `step`, making room for new ones
+void ephemeris_discard(Ephemeris* e, size_t step);
+// Positions of all bodies after `step + 1` substeps, storing their number into `size`. `step` must
+// be in [start, end).
+const Vector2* ephemeris_positions(const Ephemeris* e, size_t step, size_t* size);
+// Force exerted by all bodies and the far-field aggregate after `step + 1` substeps on a body of
+// mass `m` at `pos`
+Vector2 ephemeris_force(const Ephemeris* e, size_t step, Vector2 pos, float m);
+// Frees all memory associated with the ephemeris
+void ephemeris_destroy(Ephemeris* e);
+
+#endif
@@ -0,0 +1,102 @@
+#include "escape.h"
+
+#include <math.h>
+
+#include "raymath.h"
+
+const char* const escape_policy_names[ESCAPE_COUNT] = {
+    [ESCAPE_KEEP] = "Keep",
+    [ESCAPE_REMOVE] = "Remove",
+    [ESCAPE_AGGREGATE] = "Aggregate",
+};
+
+// Kinetic energy of the aggregate, plus its potential energy with `mass` at `center`
+static double far_field_energy(const FarField* far, Vector2 center, float mass) {
+    float u;
+    far_field_force(far, center, mass, &u);
+    return 0.5 * far->mass * Vector2LengthSqr(far->velocity) + u;
+}
+
+size_t escape_cull(CelestialBodies* b, EscapePolicy policy, float radius, FarField* far,
+                   double* energy) {
+    // Mass weighted sums over every body, in double as they are taken apart body by body below
+    double mass = 0, px = 0, py = 0, vx = 0, vy = 0;
+    for(size_t i = 0; i < b->size; i++) {
+        double m = b->mass[i];
+        mass += m;
+        px += m * b->position[i].x;
+        py += m * b->position[i].y;
+        vx += m * b->velocity[i].x;
+        vy += m * b->velocity[i].y;
+    }
+
+    // Going backwards, the body swapped into a removed one's place was already checked
+    size_t culled = 0;
+    for(size_t i = b->size; policy != ESCAPE_KEEP && i-- > 0;) {
+        double m = b->mass[i], others = mass - m;
+        if(others <= 0) continue;
+        Vector2 x = b->position[i], v = b->velocity[i];
+        // Relative to the center of mass of the others
+        Vector2 r = {x.x - (px - m * x.x) / others, x.y - (py - m * x.y) / others};
+        float d2 = Vector2LengthSqr(r);
+        if(d2 <= radius * radius) continue;
+        Vector2 u = {v.x - (vx - m * v.x) / others, v.y - (vy - m * v.y) / others};
+        float specific = 0.5f * Vector2LengthSqr(u) - G * (float)others / sqrtf(d2);
+        if(specific <= 0) continue;
+
+        // Energy of the body, with the others as a single point as above, and with the aggregate.
+        // Folding it in changes the energy of the aggregate instead.
+        Vector2 system = Vector2Subtract(x, r);
+        float far_u;
+        far_field_force(far, x, (float)m, &far_u);
+        double removed = 0.5 * m * Vector2LengthSqr(v) - G * m * others / sqrt(d2) + far_u;
+
+        if(policy == ESCAPE_AGGREGATE) {
+            removed += far_field_energy(far, system, (float)others);
+            float total = far->mass + (float)m;
+            Vector2 center = Vector2Lerp(far->position, x, (float)m / total);
+            // Parallel axis theorem, about the new center
+            far->spread = (far->mass * (far->spread + Vector2DistanceSqr(far->position, center)) +
+                           (float)m * Vector2DistanceSqr(x, center)) /
+                          total;
+            far->position = center;
+            far->velocity = Vector2Lerp(far->velocity, v, (float)m / total);
+            far->mass = total;
+            removed -= far_field_energy(far, system, (float)others);
+        }
+        if(energy) *energy += removed;
+        mass = others;
+        px -= m * x.x;
+        py -= m * x.y;
+        vx -= m * v.x;
+        vy -= m * v.y;
+        bodies_swap_remove(b, i);
+        culled++;
+    }
+
+    if(mass > 0) {
+        far->system_mass = mass;
+        far->system_position = (Vector2){px / mass, py / mass};
+        far->system_velocity = (Vector2){vx / mass, vy / mass};
+    }
+    return culled;
+}
+
+Vector2 far_field_force(const FarField* far, Vector2 pos, float m, float* potential) {
+    // Plummer potential U = -G * (m1 * m2 / sqrt(r^2 + a^2)), with a^2 the spread
+    Vector2 r = Vector2Subtract(far->position, pos);
+    float r2 = fmaxf(Vector2LengthSqr(r) + far->spread, 1e-6f);
+    if(potential) *potential = -G * (m * far->mass) / sqrtf(r2);
+    return Vector2Scale(r, G * (m * far->mass) / (r2 * sqrtf(r2)));
+}
+
+void far_field_step(FarField* far, float dt) {
+    if(far->mass <= 0) return;
+    far->system_position = Vector2Add(far->system_position, Vector2Scale(far->system_velocity, dt));
+    // Semi-implicit Euler, the aggregate is far enough for its orbit to be smooth
+    Vector2 r = Vector2Subtract(far->system_position, far->position);
+    float r2 = fmaxf(Vector2LengthSqr(r) + far->spread, 1e-6f);
+    Vector2 a = Vector2Scale(r, G * far->system_mass / (r2 * sqrtf(r2)));
+    far->velocity = Vector2Add(far->velocity, Vector2Scale(a, dt));
+    far->position = Vector2Add(far->position, Vector2Scale(far->velocity, dt));
+}
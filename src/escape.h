@@ -0,0 +1,56 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <stddef.h>
+
+#include "body.h"
+#include "raylib.h"
+
+// Culling of escaped bodies, so that bodies flung away don't keep costing force evaluations forever.
+// A body has escaped when it's farther than a given radius from the center of mass of the others
+// and its energy relative to them is positive, i.e. it's never coming back. Far enough, the others
+// pull on it as a single point of their total mass, so both are O(N) to check.
+
+// Default escape radius, about ten screens away
+#define ESCAPE_DEFAULT_RADIUS (20000.0f)
+
+typedef enum {
+    // Escaped bodies are simulated like any other
+    ESCAPE_KEEP,
+    // Escaped bodies are removed
+    ESCAPE_REMOVE,
+    // Escaped bodies are folded into the far-field aggregate (see `FarField`)
+    ESCAPE_AGGREGATE,
+    ESCAPE_COUNT,
+} EscapePolicy;
+
+extern const char* const escape_policy_names[ESCAPE_COUNT];
+
+// A single mass standing for all the bodies folded into it, which still pulls on the others. As
+// they may have escaped in any direction, it's spread as a Plummer sphere over their mean squared
+// distance from its center, so that bodies escaping on opposite sides don't leave a point mass in
+// the middle. In turn it's only pulled by the others as a whole, from their center of mass as of
+// the last `escape_cull`, moving with their mean velocity.
+typedef struct {
+    float mass;
+    Vector2 position, velocity;
+    float spread;
+    // Total mass, center of mass and its velocity of the bodies
+    float system_mass;
+    Vector2 system_position, system_velocity;
+} FarField;
+
+// Removes the bodies that escaped beyond `radius`, or folds them into `far`, depending on `policy`.
+// Bodies are removed with `bodies_swap_remove`, which reorders them. Also updates the center of mass
+// of the bodies `far` is pulled by, whatever the policy. All velocities must be up to date.
+// Unless `energy` is NULL, adds the energy taken out of the bodies and the aggregate to it, with
+// the others pulling on each culled body as a single point. Returns the number of bodies culled.
+size_t escape_cull(CelestialBodies* b, EscapePolicy policy, float radius, FarField* far,
+                   double* energy);
+// Force exerted by the aggregate on a body of mass `m` at `pos`. Unless `potential` is NULL, also
+// stores the potential energy of the pair into it.
+Vector2 far_field_force(const FarField* far, Vector2 pos, float m, float* potential);
+// Advances the aggregate, and the center of mass of the bodies with it, by `dt` seconds
+void far_field_step(FarField* far, float dt);
+
+#endif
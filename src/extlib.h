@@ -35,6 +35,8 @@
  *      SECTION: Allocators
  *      SECTION: Temporary allocator
  *      SECTION: Arena allocator
+ *      SECTION: Arena pool
+ *      SECTION: Virtual memory allocator
  *      SECTION: Dynamic array
  *      SECTION: Hashmap
  *      SECTION: String buffer
@@ -88,6 +90,27 @@
 #define EXT_POSIX
 #endif
 
+// SIMD instruction sets enabled at compile time (e.g. via `-march=native` or `/arch:AVX2`).
+// All the enabled sets are defined, so for example an AVX2 build also defines EXT_SSE2.
+#if defined(__AVX512F__)
+#define EXT_AVX512F
+#endif
+#if defined(__AVX2__)
+#define EXT_AVX2
+#endif
+#if defined(__FMA__)
+#define EXT_FMA
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EXT_SSE2
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define EXT_NEON
+#endif
+#if defined(__wasm_simd128__)
+#define EXT_WASM_SIMD
+#endif
+
 #ifndef EXTLIB_NO_STD
 #include <assert.h>
 #include <errno.h>
@@ -651,6 +674,167 @@ char *ext_arena_sprintf(Ext_Arena *a, const char *fmt, ...) EXT_PRINTF_FORMAT(2,
 char *ext_arena_vsprintf(Ext_Arena *a, const char *fmt, va_list ap);
 #endif
 
+// -----------------------------------------------------------------------------
+// SECTION: Arena pool
+//
+
+#ifndef __STDC_NO_ATOMICS__
+#include <stdatomic.h>
+
+// A slot of the pool, padded to its own cache lines so that threads allocating from neighboring
+// slots don't keep invalidating each other's
+typedef struct Ext_ArenaPoolSlot {
+    Ext_Arena arena;
+    atomic_flag lock;
+    // Allocations since the last reset, and times the lock was found taken since init
+    size_t allocations, contended;
+    // Most bytes the slot held before a reset
+    size_t peak;
+    char padding_[64];
+} Ext_ArenaPoolSlot;
+
+// A set of arenas for threads allocating scratch memory in parallel, such as the workers of a
+// thread pool, each allocating from a slot of its own.
+// Every slot is guarded by a spin lock, so any thread can allocate from any slot, but as long as
+// threads stick to their own slot the lock is never contended and allocating costs about as much
+// as from a plain `Arena`. The times a slot was found locked are counted, to spot threads sharing
+// slots.
+// Allocations stay valid until the pool is reset, whatever thread allocated them, so results can
+// be handed off to other threads, e.g. from a job to the thread that dispatched it. Resetting keeps
+// the pages of every slot: once they have grown to the peak demand, allocating never goes through
+// the page allocator anymore.
+// Pages come from `page_allocator`, which must be thread safe. By default it is
+// `ext_default_allocator` rather than the context allocator, as the context isn't thread local
+// unless built with `EXTLIB_THREADSAFE`.
+//
+// USAGE
+// ```c
+// ArenaPool pool = {0};
+// arena_pool_init(&pool, workers, NULL, 1 << 20);
+// // on worker `w`
+// float *scratch = arena_pool_alloc(&pool, w, sizeof(float) * n);
+// // once no thread is allocating anymore, e.g. at the end of the frame
+// arena_pool_log_stats(&pool, INFO, "scratch");
+// arena_pool_reset(&pool);
+//
+// arena_pool_destroy(&pool);
+// ```
+typedef struct Ext_ArenaPool {
+    // Allocator the pages and slots are allocated with
+    Ext_Allocator *page_allocator;
+    size_t count;
+
+    // Private fields
+    Ext_ArenaPoolSlot *slots;
+} Ext_ArenaPool;
+
+// Totals over every slot of a pool
+typedef struct {
+    // Allocations and bytes allocated since the last reset, and bytes held in pages
+    size_t allocations, allocated, reserved;
+    // Most bytes held by a single slot before a reset, and times a lock was found taken
+    size_t peak, contended;
+} Ext_ArenaPoolStats;
+
+// Initializes a pool of `count` slots, whose arenas allocate pages of at least `page_size` bytes
+// (`EXT_ARENA_PAGE_SZ` if 0) from `page_allocator` (`ext_default_allocator` if NULL). Allocations
+// larger than a page get a page of their own.
+void ext_arena_pool_init(Ext_ArenaPool *p, size_t count, Ext_Allocator *page_allocator,
+                         size_t page_size);
+// Allocates `size` bytes from slot `slot`. Thread safe.
+void *ext_arena_pool_alloc(Ext_ArenaPool *p, size_t slot, size_t size);
+// Locks slot `slot` and returns its arena, to use it as any allocator (e.g. for `arena_sprintf`,
+// or as the allocator of a dynamic array) until `arena_pool_release`. Thread safe.
+Ext_Arena *ext_arena_pool_acquire(Ext_ArenaPool *p, size_t slot);
+void ext_arena_pool_release(Ext_ArenaPool *p, size_t slot);
+// Frees every allocation of every slot at once, keeping their pages for reuse. No thread may be
+// allocating from the pool meanwhile.
+void ext_arena_pool_reset(Ext_ArenaPool *p);
+// Sums up the usage of the slots. Only exact while no thread is allocating from the pool.
+Ext_ArenaPoolStats ext_arena_pool_stats(const Ext_ArenaPool *p);
+// Logs the usage of the pool, prefixed by `name`
+void ext_arena_pool_log_stats(const Ext_ArenaPool *p, Ext_LogLevel lvl, const char *name);
+// Frees all memory associated with the pool
+void ext_arena_pool_destroy(Ext_ArenaPool *p);
+#endif  // __STDC_NO_ATOMICS__
+
+// -----------------------------------------------------------------------------
+// SECTION: Virtual memory allocator
+//
+
+#ifndef EXT_VM_DEFAULT_RESERVE
+#if SIZE_MAX > UINT32_MAX
+#define EXT_VM_DEFAULT_RESERVE ((size_t)1 << 30)  // 1 GiB
+#else
+#define EXT_VM_DEFAULT_RESERVE ((size_t)64 << 20)  // 64 MiB
+#endif
+#endif  // EXT_VM_DEFAULT_RESERVE
+
+// Header at the start of every region of the virtual memory allocator
+typedef struct Ext_VmRegion {
+    struct Ext_VmRegion *next;
+    size_t reserved, committed;
+} Ext_VmRegion;
+
+// Allocator for a few large and long lived allocations that keep growing, such as the arrays of a
+// structure-of-arrays container.
+// Every allocation reserves `reserve_size` bytes of address space of its own up front, but memory
+// is only committed as the allocation grows. `realloc` thus grows allocations in place without
+// ever copying, until they outgrow their reservation. Freed regions are decommitted, returning
+// their memory to the system, and kept on a free list to back later allocations.
+// On platforms without virtual memory it falls back to `malloc` and `realloc`.
+// `VmAllocator` conforms to the `Allocator` interface. It isn't thread safe.
+//
+// USAGE
+// ```c
+// VmAllocator vm = new_vm_allocator(.reserve_size = 1ULL << 32);
+// array.allocator = &vm.base;
+// // ... push at your heart's content, the array never moves
+// vm_log_usage(&vm, INFO, "array");
+// array_free(&array);
+// vm_destroy(&vm);
+// ```
+typedef struct Ext_VmAllocator {
+    Ext_Allocator base;
+    // Address space reserved by each allocation. `EXT_VM_DEFAULT_RESERVE` if 0.
+    size_t reserve_size;
+
+    // Memory usage, read only. `used` is the total size of the live allocations, `reserved` the
+    // address space held by the allocator and `committed` the memory actually backing it.
+    size_t allocations, used, reserved, committed, peak_committed;
+
+    // Private fields
+    Ext_VmRegion *free_list;
+} Ext_VmAllocator;
+
+// Creates a new virtual memory allocator. Defined as a macro so it can be used in a const context.
+// See `Ext_VmAllocator` struct for all available options
+#define ext_new_vm_allocator(...)                                                 \
+    (Ext_VmAllocator) {                                                           \
+        .base = {ext__vm_alloc_wrap_, ext__vm_realloc_wrap_, ext__vm_free_wrap_}, \
+        __VA_ARGS__                                                               \
+    }
+
+// Allocates `size` bytes in a region of its own
+void *ext_vm_alloc(Ext_VmAllocator *vm, size_t size);
+// Grows or shrinks the allocation in place, committing more memory as needed. Only moves it to a
+// new region, at least twice as large, if `new_size` exceeds its reservation.
+void *ext_vm_realloc(Ext_VmAllocator *vm, void *ptr, size_t old_size, size_t new_size);
+// Decommits the allocation and keeps its region for reuse
+void ext_vm_free(Ext_VmAllocator *vm, void *ptr, size_t size);
+// Logs the memory usage of the allocator, prefixed by `name`
+void ext_vm_log_usage(const Ext_VmAllocator *vm, Ext_LogLevel lvl, const char *name);
+// Releases the regions kept for reuse. All allocations must have been freed before.
+void ext_vm_destroy(Ext_VmAllocator *vm);
+#ifndef EXTLIB_NO_STD
+// Allocates `size` bytes initialized with the contents of the file at `path` starting at `offset`.
+// Where possible the file is memory mapped copy-on-write straight into the allocation, so it's only
+// read as pages are touched, and `offset` must then be a multiple of the page size. Otherwise the
+// file is read into it. The allocation can be grown and freed like any other. Returns NULL on
+// failure.
+void *ext_vm_map_file(Ext_VmAllocator *vm, const char *path, size_t offset, size_t size);
+#endif  // EXTLIB_NO_STD
+
 // -----------------------------------------------------------------------------
 // SECTION: Dynamic array
 //
@@ -1112,15 +1296,29 @@ int ext_cmd_write(const char *cmd, const void *data, size_t size);
 //   size / 2 + size / 4 = (3 * size) / 4
 #define EXT_HMAP_MAX_ENTRY_LOAD(size) (((size) >> 1) + ((size) >> 2))
 
+// Hash functions to choose from for the `_ex` versions of the functions below, all taking the key
+// by pointer:
+// - `ext_hmap_hash_bytes_`: the default one, hashing the bytes of the key. Keys of 4 or 8 bytes
+//   go through a Thomas Wang mix, all others through a SipHash variant, which is expensive on short
+//   keys.
+// - `ext_hmap_hash_wyhash_`: wyhash of the bytes of the key, much faster than SipHash on keys of
+//   any other size
+// - `ext_hmap_hash_wyhash_ss_`: wyhash of the bytes of a string slice
+// - `ext_hmap_hash_int_`: a multiply-xorshift mix of keys of up to 8 bytes, such as integers or
+//   packed coordinates, the cheapest of all for maps looked up in hot loops. Larger keys fall back
+//   to wyhash.
+// - `ext_hmap_hash_cstr_`, `ext_hmap_hash_ss_`: the default ones for C strings and string slices
+// Hashes only have to be deterministic, none of these are meant to resist hash flooding.
+
 // Puts an entry into the hashmap.
 // `hash_fn` is expected to be a function (or function-like macro)
 // that takes a key by pointer and returns an hash of it. `cmp_fn` is also expected to be a
 // function (or function-like macro) that takes two keys by pointer and compares them, returning
 // 0 if they're euqal, -1 if a is less than b, 1 if a is greater than b.
 //
-// You probably want to use the non-ex version of this function (ext_hmap_put, ext_hmap_put_cstr
-// or ext_hmap_put_ss) unless you specifically need to customize the way entries are hashed or
-// compared.
+// You probably want to use the non-ex version of this function (ext_hmap_put, ext_hmap_put_cstr,
+// ext_hmap_put_ss or ext_hmap_put_int) unless you specifically need to customize the way entries
+// are hashed or compared.
 #define ext_hmap_put_ex(hmap, entry_key, entry_val, hash_fn, cmp_fn)                             \
     do {                                                                                         \
         if((hmap)->size >= EXT_HMAP_MAX_ENTRY_LOAD((hmap)->capacity + 1)) {                      \
@@ -1263,10 +1461,39 @@ int ext_cmd_write(const char *cmd, const void *data, size_t size);
 #define ext_hmap_delete_ss(hmap, entry_key) \
     ext_hmap_delete_ex(hmap, entry_key, ext_hmap_hash_ss_, ext_hmap_sscmp_)
 
-// Clears the hashmap
+// Puts an entry into the hashmap. keys of up to 8 bytes are hashed with `ext_hmap_hash_int_` and
+// compared with `memcmp`.
+#define ext_hmap_put_int(hmap, entry_key, entry_val) \
+    ext_hmap_put_ex(hmap, entry_key, entry_val, ext_hmap_hash_int_, ext_hmap_memcmp_)
+// Gets an entry from the hashmap. keys of up to 8 bytes are hashed with `ext_hmap_hash_int_` and
+// compared with `memcmp`.
+#define ext_hmap_get_int(hmap, entry_key, out) \
+    ext_hmap_get_ex(hmap, entry_key, out, ext_hmap_hash_int_, ext_hmap_memcmp_)
+// Gets an entry from the hashmap, creating a new one if not found. keys of up to 8 bytes are
+// hashed with `ext_hmap_hash_int_` and compared with `memcmp`.
+#define ext_hmap_get_default_int(hmap, entry_key, entry_val, out) \
+    ext_hmap_get_default_ex(hmap, entry_key, entry_val, out, ext_hmap_hash_int_, ext_hmap_memcmp_)
+// Deletes an entry from the hashmap. keys of up to 8 bytes are hashed with `ext_hmap_hash_int_`
+// and compared with `memcmp`.
+#define ext_hmap_delete_int(hmap, entry_key) \
+    ext_hmap_delete_ex(hmap, entry_key, ext_hmap_hash_int_, ext_hmap_memcmp_)
+
+// Grows the hashmap so that `n` entries fit without growing again, rehashing its entries at most
+// once. To be called before inserting many entries at once, instead of growing through every
+// power of two on the way there. Never shrinks the hashmap.
+#define ext_hmap_reserve(hmap, n)                                                           \
+    do {                                                                                    \
+        if((size_t)(n) > EXT_HMAP_MAX_ENTRY_LOAD((hmap)->capacity + 1)) {                   \
+            ext_hmap_reserve_((void **)&(hmap)->entries, sizeof(*(hmap)->entries),          \
+                              &(hmap)->hashes, &(hmap)->capacity, &(hmap)->allocator, (n)); \
+            ext_hmap_tombs_(hmap) = (hmap)->size;                                           \
+        }                                                                                   \
+    } while(0)
+
+// Clears the hashmap. Buckets are 1 to capacity + 1, after the tombstone count.
 #define ext_hmap_clear(hmap)                                                         \
     do {                                                                             \
-        memset((hmap)->hashes, 0, sizeof(*(hmap)->hashes) * ((hmap)->capacity + 1)); \
+        memset((hmap)->hashes, 0, sizeof(*(hmap)->hashes) * ((hmap)->capacity + 2)); \
         (hmap)->size = 0;                                                            \
     } while(0)
 
@@ -1328,6 +1555,8 @@ EXT_STATIC_ASSERT(((EXT_HMAP_INIT_CAPACITY) & (EXT_HMAP_INIT_CAPACITY - 1)) == 0
 
 void ext_hmap_grow_(void **entries, size_t entries_sz, size_t **hashes, size_t *cap,
                     Ext_Allocator **a);
+void ext_hmap_reserve_(void **entries, size_t entries_sz, size_t **hashes, size_t *cap,
+                       Ext_Allocator **a, size_t n);
 
 #define ext_hmap_tmp_(map)   ((map)->entries[EXT_HMAP_TMP_SLOT])
 #define ext_hmap_tombs_(map) ((map)->hashes[EXT_HMAP_TMP_SLOT])
@@ -1359,6 +1588,11 @@ void ext_hmap_grow_(void **entries, size_t entries_sz, size_t **hashes, size_t *
 #define ext_hmap_hash_bytes_(k)  ext_hash_bytes_((k), sizeof(*(k)))
 #define ext_hmap_hash_cstr_(k)   ext_hash_cstr_(*(k))
 #define ext_hmap_hash_ss_(k)     ext_hash_bytes_((k)->data, (k)->size)
+#define ext_hmap_hash_wyhash_(k) \
+    ((size_t)ext_hash_wyhash_((k), sizeof(*(k)), EXT_HMAP_WYHASH_SEED))
+#define ext_hmap_hash_wyhash_ss_(k) \
+    ((size_t)ext_hash_wyhash_((k)->data, (k)->size, EXT_HMAP_WYHASH_SEED))
+#define ext_hmap_hash_int_(k) ((size_t)ext_hash_int_((k), sizeof(*(k))))
 #define ext_hmap_memcmp_(k1, k2) memcmp((k1), (k2), sizeof(*(k1)))
 #define ext_hmap_strcmp_(k1, k2) strcmp(*(k1), *(k2))
 #define ext_hmap_sscmp_(k1, k2)  ext_ss_cmp(*(k1), *(k2))
@@ -1493,8 +1727,8 @@ static size_t ext_siphash_bytes_(const void *p, size_t len, size_t seed) {
     } while(0)
 
     for(i = 0; i + sizeof(size_t) <= len; i += sizeof(size_t), d += sizeof(size_t)) {
-        data = d[0] | (d[1] << 8) | (d[2] << 16) | (d[3] << 24);
-        data |= (size_t)(d[4] | (d[5] << 8) | (d[6] << 16) | (d[7] << 24))
+        data = d[0] | (d[1] << 8) | (d[2] << 16) | ((size_t)d[3] << 24);
+        data |= (size_t)(d[4] | (d[5] << 8) | (d[6] << 16) | ((unsigned)d[7] << 24))
                 << 16 << 16;  // discarded if size_t == 4
 
         v3 ^= data;
@@ -1510,7 +1744,7 @@ static size_t ext_siphash_bytes_(const void *p, size_t len, size_t seed) {
     case 5:
         data |= ((size_t)d[4] << 16) << 16;  // fall through
     case 4:
-        data |= (d[3] << 24);  // fall through
+        data |= ((size_t)d[3] << 24);  // fall through
     case 3:
         data |= (d[2] << 16);  // fall through
     case 2:
@@ -1543,7 +1777,7 @@ static inline size_t ext_hash_bytes_(const void *p, size_t len) {
     unsigned char *d = (unsigned char *)p;
 
     if(len == 4) {
-        unsigned int hash = d[0] | (d[1] << 8) | (d[2] << 16) | (d[3] << 24);
+        unsigned int hash = d[0] | (d[1] << 8) | (d[2] << 16) | ((unsigned)d[3] << 24);
         // HASH32-BB  Bob Jenkin's presumably-accidental version of Thomas Wang hash
         // with rotates turned into shifts. Note that converting these back to
         // rotates makes it run a lot slower, presumably due to collisions, so I'm
@@ -1557,8 +1791,8 @@ static inline size_t ext_hash_bytes_(const void *p, size_t len) {
         hash = hash ^ (hash >> 15);
         return (((size_t)hash << 16 << 16) | hash) ^ seed;
     } else if(len == 8 && sizeof(size_t) == 8) {
-        size_t hash = d[0] | (d[1] << 8) | (d[2] << 16) | (d[3] << 24);
-        hash |= (size_t)(d[4] | (d[5] << 8) | (d[6] << 16) | (d[7] << 24))
+        size_t hash = d[0] | (d[1] << 8) | (d[2] << 16) | ((size_t)d[3] << 24);
+        hash |= (size_t)(d[4] | (d[5] << 8) | (d[6] << 16) | ((unsigned)d[7] << 24))
                 << 16 << 16;  // avoid warning if size_t == 4
         hash ^= seed;
         hash = (~hash) + (hash << 21);
@@ -1585,6 +1819,122 @@ static inline size_t ext_hash_bytes_(const void *p, size_t len) {
         // End of stbds.h
         // -----------------------------------------------------------------------------
 
+// -----------------------------------------------------------------------------
+// wyhash (final version 4) by Wang Yi, released into the public domain
+// https://github.com/wangyi-fudan/wyhash
+//
+// Words are read in native byte order, so hashes differ between little and big endian machines.
+
+#ifndef EXT_HMAP_WYHASH_SEED
+#define EXT_HMAP_WYHASH_SEED 0x9e3779b97f4a7c15ull
+#endif  // EXT_HMAP_WYHASH_SEED
+
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__SIZEOF_INT128__)
+#include <intrin.h>
+#pragma intrinsic(_umul128)
+#endif
+
+// Full 128 bit product of `a` and `b`, low half into `a` and high half into `b`
+static inline void ext__wymum_(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t ext__wymix_(uint64_t a, uint64_t b) {
+    ext__wymum_(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t ext__wyr8_(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t ext__wyr4_(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 1 to 3 bytes
+static inline uint64_t ext__wyr3_(const unsigned char *p, size_t k) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+static inline uint64_t ext_hash_wyhash_(const void *key, size_t len, uint64_t seed) {
+    static const uint64_t secret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                       0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+    const unsigned char *p = (const unsigned char *)key;
+    seed ^= ext__wymix_(seed ^ secret[0], secret[1]);
+    uint64_t a, b;
+    if(len <= 16) {
+        if(len >= 4) {
+            a = (ext__wyr4_(p) << 32) | ext__wyr4_(p + ((len >> 3) << 2));
+            b = (ext__wyr4_(p + len - 4) << 32) | ext__wyr4_(p + len - 4 - ((len >> 3) << 2));
+        } else if(len > 0) {
+            a = ext__wyr3_(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if(i >= 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = ext__wymix_(ext__wyr8_(p) ^ secret[1], ext__wyr8_(p + 8) ^ seed);
+                see1 = ext__wymix_(ext__wyr8_(p + 16) ^ secret[2], ext__wyr8_(p + 24) ^ see1);
+                see2 = ext__wymix_(ext__wyr8_(p + 32) ^ secret[3], ext__wyr8_(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while(i >= 48);
+            seed ^= see1 ^ see2;
+        }
+        while(i > 16) {
+            seed = ext__wymix_(ext__wyr8_(p) ^ secret[1], ext__wyr8_(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = ext__wyr8_(p + i - 16);
+        b = ext__wyr8_(p + i - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    ext__wymum_(&a, &b);
+    return ext__wymix_(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+// Hashes keys of up to 8 bytes, read as a single integer, with two rounds of multiply-xorshift.
+// The final xorshift folds the high half of the product, which depends on every bit of the key,
+// into the low bits the hashmap indexes with. `len` is expected to be a constant, so that only one
+// branch is left.
+static inline uint64_t ext_hash_int_(const void *key, size_t len) {
+    if(len > sizeof(uint64_t)) return ext_hash_wyhash_(key, len, EXT_HMAP_WYHASH_SEED);
+    uint64_t x = 0;
+    memcpy(&x, key, len);
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ull;
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ull;
+    x ^= x >> 32;
+    return x;
+}
+
 #ifdef EXTLIB_IMPL
 // -----------------------------------------------------------------------------
 // SECTION: Logging
@@ -2128,6 +2478,399 @@ char *ext_arena_vsprintf(Ext_Arena *a, const char *fmt, va_list ap) {
 }
 #endif  // EXTLIB_NO_STD
 
+// -----------------------------------------------------------------------------
+// SECTION: Arena pool
+//
+#ifndef __STDC_NO_ATOMICS__
+static Ext_ArenaPoolSlot *ext__arena_pool_lock(Ext_ArenaPool *p, size_t slot) {
+    EXT_ASSERT(slot < p->count, "slot out of bounds");
+    Ext_ArenaPoolSlot *s = &p->slots[slot];
+    if(atomic_flag_test_and_set_explicit(&s->lock, memory_order_acquire)) {
+        while(atomic_flag_test_and_set_explicit(&s->lock, memory_order_acquire)) {
+        }
+        s->contended++;
+    }
+    return s;
+}
+
+void ext_arena_pool_init(Ext_ArenaPool *p, size_t count, Ext_Allocator *page_allocator,
+                         size_t page_size) {
+    EXT_ASSERT(count > 0, "pool must have at least a slot");
+    if(!page_allocator) page_allocator = &ext_default_allocator.base;
+    p->page_allocator = page_allocator;
+    p->count = count;
+    p->slots = page_allocator->alloc(page_allocator, sizeof(*p->slots) * count);
+    for(size_t i = 0; i < count; i++) {
+        Ext_ArenaPoolSlot *s = &p->slots[i];
+        s->arena = ext_new_arena(.page_allocator = page_allocator, .page_size = page_size,
+                                 .flags = EXT_ARENA_FLEXIBLE_PAGE);
+        atomic_flag_clear(&s->lock);
+        s->allocations = 0;
+        s->contended = 0;
+        s->peak = 0;
+    }
+}
+
+void *ext_arena_pool_alloc(Ext_ArenaPool *p, size_t slot, size_t size) {
+    Ext_ArenaPoolSlot *s = ext__arena_pool_lock(p, slot);
+    void *mem = ext_arena_alloc(&s->arena, size);
+    s->allocations++;
+    atomic_flag_clear_explicit(&s->lock, memory_order_release);
+    return mem;
+}
+
+Ext_Arena *ext_arena_pool_acquire(Ext_ArenaPool *p, size_t slot) {
+    Ext_ArenaPoolSlot *s = ext__arena_pool_lock(p, slot);
+    s->allocations++;
+    return &s->arena;
+}
+
+void ext_arena_pool_release(Ext_ArenaPool *p, size_t slot) {
+    EXT_ASSERT(slot < p->count, "slot out of bounds");
+    atomic_flag_clear_explicit(&p->slots[slot].lock, memory_order_release);
+}
+
+void ext_arena_pool_reset(Ext_ArenaPool *p) {
+    for(size_t i = 0; i < p->count; i++) {
+        Ext_ArenaPoolSlot *s = &p->slots[i];
+        if(s->arena.allocated > s->peak) s->peak = s->arena.allocated;
+        s->allocations = 0;
+        ext_arena_reset(&s->arena);
+    }
+}
+
+Ext_ArenaPoolStats ext_arena_pool_stats(const Ext_ArenaPool *p) {
+    Ext_ArenaPoolStats stats = {0};
+    for(size_t i = 0; i < p->count; i++) {
+        const Ext_ArenaPoolSlot *s = &p->slots[i];
+        stats.allocations += s->allocations;
+        stats.allocated += s->arena.allocated;
+        stats.contended += s->contended;
+        size_t peak = s->arena.allocated > s->peak ? s->arena.allocated : s->peak;
+        if(peak > stats.peak) stats.peak = peak;
+        for(const Ext_ArenaPage *page = s->arena.first_page; page; page = page->next) {
+            stats.reserved += page->end - (const char *)page;
+        }
+    }
+    return stats;
+}
+
+void ext_arena_pool_log_stats(const Ext_ArenaPool *p, Ext_LogLevel lvl, const char *name) {
+    const double mib = 1024.0 * 1024.0;
+    Ext_ArenaPoolStats s = ext_arena_pool_stats(p);
+    ext_log(lvl,
+            "%s: %zu slots, %zu allocations, %.2f MiB allocated (peak %.2f MiB per slot), %.2f MiB "
+            "reserved, %zu contended locks",
+            name, p->count, s.allocations, s.allocated / mib, s.peak / mib, s.reserved / mib,
+            s.contended);
+}
+
+void ext_arena_pool_destroy(Ext_ArenaPool *p) {
+    if(!p->slots) return;
+    for(size_t i = 0; i < p->count; i++) {
+        ext_arena_destroy(&p->slots[i].arena);
+    }
+    p->page_allocator->free(p->page_allocator, p->slots, sizeof(*p->slots) * p->count);
+    p->slots = NULL;
+    p->count = 0;
+}
+#endif  // __STDC_NO_ATOMICS__
+
+// -----------------------------------------------------------------------------
+// SECTION: Virtual memory allocator
+//
+#ifndef EXTLIB_NO_STD
+#ifdef EXT_WINDOWS
+#define _WINUSER_
+#define _WINGDI_
+#define _IMM_
+#define _WINCON_
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define EXT__VM_NATIVE
+#elif defined(EXT_POSIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+// Anonymous mappings aren't available in strict ISO C modes
+#ifdef MAP_ANONYMOUS
+#define EXT__VM_NATIVE
+#endif
+#endif  // EXT_WINDOWS
+#endif  // EXTLIB_NO_STD
+
+#ifdef EXT__VM_NATIVE
+
+static size_t ext__vm_page_size(void) {
+    static size_t page_size;
+    if(!page_size) {
+#ifdef EXT_WINDOWS
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        page_size = info.dwPageSize;
+#else
+        page_size = sysconf(_SC_PAGESIZE);
+#endif
+    }
+    return page_size;
+}
+
+static void *ext__vm_reserve(size_t size) {
+#ifdef EXT_WINDOWS
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void *p = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+#endif
+}
+
+static bool ext__vm_commit(void *p, size_t size) {
+#ifdef EXT_WINDOWS
+    return VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(p, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void ext__vm_decommit(void *p, size_t size) {
+#ifdef EXT_WINDOWS
+    VirtualFree(p, size, MEM_DECOMMIT);
+#else
+    // Mapping fresh pages over the range gives the memory back to the system, and also drops any
+    // file mapped there
+    mmap(p, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+#endif
+}
+
+static void ext__vm_release(void *p, size_t size) {
+#ifdef EXT_WINDOWS
+    (void)size;
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, size);
+#endif
+}
+
+// The region header takes the first page, so that allocations stay page aligned
+#define EXT__VM_DATA(r)   ((char *)(r) + ext__vm_page_size())
+#define EXT__VM_REGION(p) ((Ext_VmRegion *)((char *)(p) - ext__vm_page_size()))
+
+// Commits or decommits memory at the end of the region so that it fits `size` bytes of data
+static void ext__vm_resize(Ext_VmAllocator *vm, Ext_VmRegion *r, size_t size) {
+    size_t page = ext__vm_page_size();
+    size_t committed = size + page;
+    committed += EXT_ALIGN(committed, page);
+    if(committed > r->committed) {
+        bool ok = ext__vm_commit((char *)r + r->committed, committed - r->committed);
+        EXT_ASSERT(ok, "out of memory");
+        vm->committed += committed - r->committed;
+    } else if(committed < r->committed) {
+        ext__vm_decommit((char *)r + committed, r->committed - committed);
+        vm->committed -= r->committed - committed;
+    }
+    r->committed = committed;
+    if(vm->committed > vm->peak_committed) vm->peak_committed = vm->committed;
+}
+
+// Gets a region of at least `reserve` bytes for `size` bytes of data, reusing a free one if the
+// default reservation is enough
+static Ext_VmRegion *ext__vm_new_region(Ext_VmAllocator *vm, size_t size, size_t reserve) {
+    size_t page = ext__vm_page_size();
+    size_t default_reserve = vm->reserve_size ? vm->reserve_size : EXT_VM_DEFAULT_RESERVE;
+    default_reserve += EXT_ALIGN(default_reserve, page);
+    size_t need = size + page;
+    if(reserve < need) reserve = need;
+    reserve += EXT_ALIGN(reserve, page);
+
+    Ext_VmRegion *r;
+    if(reserve <= default_reserve && vm->free_list) {
+        r = vm->free_list;
+        vm->free_list = r->next;
+    } else {
+        if(reserve < default_reserve) reserve = default_reserve;
+        r = ext__vm_reserve(reserve);
+        EXT_ASSERT(r, "out of address space");
+        bool ok = ext__vm_commit(r, page);
+        EXT_ASSERT(ok, "out of memory");
+        r->reserved = reserve;
+        r->committed = page;
+        vm->reserved += reserve;
+        vm->committed += page;
+    }
+    r->next = NULL;
+    ext__vm_resize(vm, r, size);
+    return r;
+}
+#endif  // EXT__VM_NATIVE
+
+void *ext__vm_alloc_wrap_(Ext_Allocator *a, size_t size) {
+    return ext_vm_alloc((Ext_VmAllocator *)a, size);
+}
+
+void *ext__vm_realloc_wrap_(Ext_Allocator *a, void *ptr, size_t old_size, size_t new_size) {
+    return ext_vm_realloc((Ext_VmAllocator *)a, ptr, old_size, new_size);
+}
+
+void ext__vm_free_wrap_(Ext_Allocator *a, void *ptr, size_t size) {
+    ext_vm_free((Ext_VmAllocator *)a, ptr, size);
+}
+
+void *ext_vm_alloc(Ext_VmAllocator *vm, size_t size) {
+    vm->allocations++;
+    vm->used += size;
+#ifdef EXT__VM_NATIVE
+    return EXT__VM_DATA(ext__vm_new_region(vm, size, 0));
+#else
+    vm->committed += size;
+    if(vm->committed > vm->peak_committed) vm->peak_committed = vm->committed;
+    return ext_default_allocator.base.alloc(&ext_default_allocator.base, size);
+#endif
+}
+
+void *ext_vm_realloc(Ext_VmAllocator *vm, void *ptr, size_t old_size, size_t new_size) {
+    if(!ptr) return ext_vm_alloc(vm, new_size);
+    vm->used += new_size - old_size;
+#ifdef EXT__VM_NATIVE
+    Ext_VmRegion *r = EXT__VM_REGION(ptr);
+    if(new_size + ext__vm_page_size() <= r->reserved) {
+        ext__vm_resize(vm, r, new_size);
+        return ptr;
+    }
+    // Outgrew the reservation, move to one at least twice as large
+    Ext_VmRegion *nr = ext__vm_new_region(vm, new_size, 2 * r->reserved);
+    memcpy(EXT__VM_DATA(nr), ptr, old_size);
+    vm->allocations++;
+    vm->used += old_size;
+    ext_vm_free(vm, ptr, old_size);
+    return EXT__VM_DATA(nr);
+#else
+    vm->committed += new_size - old_size;
+    if(vm->committed > vm->peak_committed) vm->peak_committed = vm->committed;
+    return ext_default_allocator.base.realloc(&ext_default_allocator.base, ptr, old_size,
+                                              new_size);
+#endif
+}
+
+void ext_vm_free(Ext_VmAllocator *vm, void *ptr, size_t size) {
+    if(!ptr) return;
+    vm->allocations--;
+    vm->used -= size;
+#ifdef EXT__VM_NATIVE
+    Ext_VmRegion *r = EXT__VM_REGION(ptr);
+    size_t page = ext__vm_page_size();
+    size_t default_reserve = vm->reserve_size ? vm->reserve_size : EXT_VM_DEFAULT_RESERVE;
+    default_reserve += EXT_ALIGN(default_reserve, page);
+    if(r->reserved == default_reserve) {
+        // Keep only the header committed
+        ext__vm_resize(vm, r, 0);
+        r->next = vm->free_list;
+        vm->free_list = r;
+    } else {
+        vm->reserved -= r->reserved;
+        vm->committed -= r->committed;
+        ext__vm_release(r, r->reserved);
+    }
+#else
+    vm->committed -= size;
+    ext_default_allocator.base.free(&ext_default_allocator.base, ptr, size);
+#endif
+}
+
+#ifndef EXTLIB_NO_STD
+void *ext_vm_map_file(Ext_VmAllocator *vm, const char *path, size_t offset, size_t size) {
+#if defined(EXT__VM_NATIVE) && defined(EXT_POSIX)
+    size_t page = ext__vm_page_size();
+    if(offset % page) {
+        ext_log(EXT_ERROR, "couldn't map file %s: offset %zu isn't page aligned", path, offset);
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) < 0) goto error;
+    if((size_t)st.st_size < offset + size) {
+        errno = EINVAL;
+        goto error;
+    }
+
+    vm->allocations++;
+    vm->used += size;
+    Ext_VmRegion *r = ext__vm_new_region(vm, 0, size + page);
+    if(size) {
+        // Rounded up to whole pages, still within the file besides the tail of its last page
+        size_t mapped = size + EXT_ALIGN(size, page);
+        void *p = mmap(EXT__VM_DATA(r), mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                       fd, offset);
+        if(p == MAP_FAILED) {
+            int saved_errno = errno;
+            ext_vm_free(vm, EXT__VM_DATA(r), size);
+            errno = saved_errno;
+            goto error;
+        }
+        r->committed += mapped;
+        vm->committed += mapped;
+        if(vm->committed > vm->peak_committed) vm->peak_committed = vm->committed;
+    }
+    close(fd);
+    return EXT__VM_DATA(r);
+error:
+    ext_log(EXT_ERROR, "couldn't map file %s: %s", path, strerror(errno));
+    if(fd >= 0) close(fd);
+    return NULL;
+#else
+    FILE *f = fopen(path, "rb");
+    if(!f) goto error;
+#ifdef EXT_WINDOWS
+    if(_fseeki64(f, offset, SEEK_SET) < 0) goto error;
+#else
+    if(fseek(f, offset, SEEK_SET) < 0) goto error;
+#endif  // EXT_WINDOWS
+    char *mem = ext_vm_alloc(vm, size);
+    if(fread(mem, 1, size, f) != size) {
+        if(!ferror(f)) errno = EINVAL;
+        int saved_errno = errno;
+        ext_vm_free(vm, mem, size);
+        errno = saved_errno;
+        goto error;
+    }
+    fclose(f);
+    return mem;
+error:
+    ext_log(EXT_ERROR, "couldn't read file %s: %s", path, strerror(errno));
+    if(f) fclose(f);
+    return NULL;
+#endif  // defined(EXT__VM_NATIVE) && defined(EXT_POSIX)
+}
+#endif  // EXTLIB_NO_STD
+
+void ext_vm_log_usage(const Ext_VmAllocator *vm, Ext_LogLevel lvl, const char *name) {
+    const double mib = 1024.0 * 1024.0;
+    ext_log(lvl,
+            "%s: %zu allocations, %.2f MiB used, %.2f MiB committed (peak %.2f MiB), %.2f MiB "
+            "reserved",
+            name, vm->allocations, vm->used / mib, vm->committed / mib, vm->peak_committed / mib,
+            vm->reserved / mib);
+}
+
+void ext_vm_destroy(Ext_VmAllocator *vm) {
+    EXT_ASSERT(vm->allocations == 0, "destroying an allocator with live allocations");
+#ifdef EXT__VM_NATIVE
+    while(vm->free_list) {
+        Ext_VmRegion *r = vm->free_list;
+        vm->free_list = r->next;
+        vm->reserved -= r->reserved;
+        vm->committed -= r->committed;
+        ext__vm_release(r, r->reserved);
+    }
+#endif
+}
+
 // -----------------------------------------------------------------------------
 // SECTION: String buffer
 //
@@ -2913,9 +3656,9 @@ error:
 // -----------------------------------------------------------------------------
 // SECTION: Hashmap
 //
-void ext_hmap_grow_(void **entries, size_t entries_sz, size_t **hashes, size_t *cap,
-                    Ext_Allocator **a) {
-    size_t newcap = *cap ? (*cap + 1) * 2 : EXT_HMAP_INIT_CAPACITY;
+// Rehashes the entries into a new table of `newcap` buckets, a power of two
+static void ext__hmap_resize_(void **entries, size_t entries_sz, size_t **hashes, size_t *cap,
+                              Ext_Allocator **a, size_t newcap) {
     size_t newsz = (newcap + 1) * entries_sz;
     size_t pad = EXT_ALIGN(newsz, sizeof(size_t));
     size_t totalsz = newsz + pad + sizeof(size_t) * (newcap + 1);
@@ -2949,11 +3692,28 @@ void ext_hmap_grow_(void **entries, size_t entries_sz, size_t **hashes, size_t *
     *hashes = newhashes;
     *cap = newcap - 1;
 }
+
+void ext_hmap_grow_(void **entries, size_t entries_sz, size_t **hashes, size_t *cap,
+                    Ext_Allocator **a) {
+    size_t newcap = *cap ? (*cap + 1) * 2 : EXT_HMAP_INIT_CAPACITY;
+    ext__hmap_resize_(entries, entries_sz, hashes, cap, a, newcap);
+}
+
+void ext_hmap_reserve_(void **entries, size_t entries_sz, size_t **hashes, size_t *cap,
+                       Ext_Allocator **a, size_t n) {
+    size_t newcap = *entries ? *cap + 1 : EXT_HMAP_INIT_CAPACITY;
+    // Until the n-th insertion finds the table below its maximum load
+    while(EXT_HMAP_MAX_ENTRY_LOAD(newcap) < n) newcap *= 2;
+    ext__hmap_resize_(entries, entries_sz, hashes, cap, a, newcap);
+}
 #endif  // EXTLIB_IMPL
 
 void *ext__arena_alloc_wrap_(Ext_Allocator *a, size_t size);
 void *ext__arena_realloc_wrap_(Ext_Allocator *a, void *ptr, size_t old_size, size_t new_size);
 void ext__arena_free_wrap_(Ext_Allocator *a, void *ptr, size_t size);
+void *ext__vm_alloc_wrap_(Ext_Allocator *a, size_t size);
+void *ext__vm_realloc_wrap_(Ext_Allocator *a, void *ptr, size_t old_size, size_t new_size);
+void ext__vm_free_wrap_(Ext_Allocator *a, void *ptr, size_t size);
 
 #if ((defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)) || defined(__GNUC__)) && \
     !defined(EXTLIB_NO_STD)
@@ -3167,6 +3927,32 @@ typedef Ext_ArenaCheckpoint ArenaCheckpoint;
 #define arena_vsprintf ext_arena_vsprintf
 #endif  // EXTLIB_NO_STD
 
+#ifndef __STDC_NO_ATOMICS__
+typedef Ext_ArenaPool ArenaPool;
+typedef Ext_ArenaPoolSlot ArenaPoolSlot;
+typedef Ext_ArenaPoolStats ArenaPoolStats;
+#define arena_pool_init      ext_arena_pool_init
+#define arena_pool_alloc     ext_arena_pool_alloc
+#define arena_pool_acquire   ext_arena_pool_acquire
+#define arena_pool_release   ext_arena_pool_release
+#define arena_pool_reset     ext_arena_pool_reset
+#define arena_pool_stats     ext_arena_pool_stats
+#define arena_pool_log_stats ext_arena_pool_log_stats
+#define arena_pool_destroy   ext_arena_pool_destroy
+#endif  // __STDC_NO_ATOMICS__
+
+typedef Ext_VmAllocator VmAllocator;
+typedef Ext_VmRegion VmRegion;
+#define new_vm_allocator ext_new_vm_allocator
+#define vm_alloc         ext_vm_alloc
+#define vm_realloc       ext_vm_realloc
+#define vm_free          ext_vm_free
+#define vm_log_usage     ext_vm_log_usage
+#define vm_destroy       ext_vm_destroy
+#ifndef EXTLIB_NO_STD
+#define vm_map_file ext_vm_map_file
+#endif  // EXTLIB_NO_STD
+
 #define array_foreach       ext_array_foreach
 #define array_reserve       ext_array_reserve
 #define array_reserve_exact ext_array_reserve_exact
@@ -3272,6 +4058,11 @@ typedef Ext_FileType FileType;
 #define hmap_get_ss           ext_hmap_get_ss
 #define hmap_get_default_ss   ext_hmap_get_default_ss
 #define hmap_delete_ss        ext_hmap_delete_ss
+#define hmap_put_int          ext_hmap_put_int
+#define hmap_get_int          ext_hmap_get_int
+#define hmap_get_default_int  ext_hmap_get_default_int
+#define hmap_delete_int       ext_hmap_delete_int
+#define hmap_reserve          ext_hmap_reserve
 #define hmap_clear            ext_hmap_clear
 #define hmap_free             ext_hmap_free
 #endif  // EXTLIB_NO_SHORTHANDS
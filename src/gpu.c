@@ -0,0 +1,313 @@
+#include "gpu.h"
+
+#include <stdint.h>
+
+#include "extlib.h"
+#include "raylib.h"
+#include "raymath.h"
+#include "rlgl.h"
+
+#define GPU_STR_(x) #x
+#define GPU_STR(x)  GPU_STR_(x)
+
+// Buffer layouts, shared by all shaders:
+//   binding 0, positions: vec4(position.xy, mass, radius)
+//   binding 1, states:    vec4(velocity.xy, force.xy)
+//   binding 2, previous:  vec2(prev_position.xy)
+//   binding 3, colors:    packed RGBA8
+#define GPU_BUFFERS                                                                       \
+    "layout(std430, binding = 0) buffer Positions { vec4 positions[]; };\n"               \
+    "layout(std430, binding = 1) buffer States { vec4 states[]; };\n"                     \
+    "layout(std430, binding = 2) buffer Previous { vec2 previous[]; };\n"                 \
+    "layout(std430, binding = 3) readonly buffer Colors { uint colors[]; };\n"
+#define POSITION_STRIDE (4 * sizeof(float))
+#define STATE_STRIDE    (4 * sizeof(float))
+#define PREVIOUS_STRIDE (2 * sizeof(float))
+#define COLOR_STRIDE    (sizeof(uint32_t))
+
+// First half kick and drift of velocity Verlet, same as the CPU solvers. Also saves the previous
+// positions to interpolate from.
+// local_size_x must match GPU_GROUP_SIZE.
+static const char* drift_shader =
+    "#version 430\n"
+    "layout(local_size_x = 256) in;\n" GPU_BUFFERS
+    "uniform int count;\n"
+    "uniform float dt;\n"
+    "void main() {\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    if(i >= uint(count)) return;\n"
+    "    vec4 p = positions[i];\n"
+    "    vec4 s = states[i];\n"
+    "    previous[i] = p.xy;\n"
+    "    s.xy += s.zw * (0.5 * dt / p.z);\n"
+    "    p.xy += s.xy * dt;\n"
+    "    positions[i] = p;\n"
+    "    states[i] = s;\n"
+    "}\n";
+
+// Direct summation tiled through shared memory: each work group loads GPU_GROUP_SIZE sources
+// at a time, with every invocation accumulating the force on its own target. Then applies the
+// second half kick of velocity Verlet.
+static const char* force_shader =
+    "#version 430\n"
+    "layout(local_size_x = 256) in;\n" GPU_BUFFERS
+    "const float G = float" GPU_STR(G) ";\n"
+    "uniform int count;\n"
+    "uniform float dt;\n"
+    "shared vec3 tile[256];\n"
+    "void main() {\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    uint l = gl_LocalInvocationID.x;\n"
+    "    vec2 p = i < uint(count) ? positions[i].xy : vec2(0.0);\n"
+    "    vec2 f = vec2(0.0);\n"
+    "    for(uint base = 0; base < uint(count); base += 256) {\n"
+    "        uint j = base + l;\n"
+    // Padding sources get zero mass, and the target itself has r = 0 so it contributes nothing
+    "        tile[l] = j < uint(count) ? positions[j].xyz : vec3(0.0);\n"
+    "        barrier();\n"
+    "        for(int k = 0; k < 256; k++) {\n"
+    "            vec2 d = tile[k].xy - p;\n"
+    "            float inv_r = inversesqrt(max(dot(d, d), 1e-6));\n"
+    "            f += d * (tile[k].z * inv_r * inv_r * inv_r);\n"
+    "        }\n"
+    "        barrier();\n"
+    "    }\n"
+    "    if(i >= uint(count)) return;\n"
+    "    float m = positions[i].z;\n"
+    "    f *= G * m;\n"
+    "    vec4 s = states[i];\n"
+    "    s.xy += f * (0.5 * dt / m);\n"
+    "    s.zw = f;\n"
+    "    states[i] = s;\n"
+    "}\n";
+
+// Bodies are drawn as quads (6 vertices each, no vertex buffer) shaded as antialiased circles
+static const char* draw_vertex_shader =
+    "#version 430\n" GPU_BUFFERS
+    "uniform mat4 mvp;\n"
+    "uniform float alpha;\n"
+    "out vec2 local;\n"
+    "out vec4 tint;\n"
+    "const vec2 corners[6] = vec2[](vec2(-1, -1), vec2(1, -1), vec2(1, 1),\n"
+    "                               vec2(-1, -1), vec2(1, 1), vec2(-1, 1));\n"
+    "void main() {\n"
+    "    int i = gl_VertexID / 6;\n"
+    "    vec2 corner = corners[gl_VertexID % 6];\n"
+    "    vec4 p = positions[i];\n"
+    "    vec2 center = mix(previous[i].xy, p.xy, alpha);\n"
+    "    local = corner;\n"
+    "    tint = unpackUnorm4x8(colors[i]);\n"
+    "    gl_Position = mvp * vec4(center + corner * p.w, 0.0, 1.0);\n"
+    "}\n";
+
+static const char* draw_fragment_shader =
+    "#version 430\n"
+    "in vec2 local;\n"
+    "in vec4 tint;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "    float d = length(local);\n"
+    "    float coverage = 1.0 - smoothstep(1.0 - fwidth(d), 1.0, d);\n"
+    "    if(coverage <= 0.0) discard;\n"
+    "    frag_color = vec4(tint.rgb, tint.a * coverage);\n"
+    "}\n";
+
+// rlgl doesn't expose glMemoryBarrier, which is needed between dispatches that read what the
+// previous one wrote. raylib's desktop platform bundles GLFW, so we can look it up through it.
+#ifdef EXT_WINDOWS
+#define GPU_APIENTRY __stdcall
+#else
+#define GPU_APIENTRY
+#endif
+#define GL_SHADER_STORAGE_BARRIER_BIT (0x00002000)
+typedef void (*GlProc)(void);
+typedef void(GPU_APIENTRY* GlMemoryBarrierFn)(unsigned int barriers);
+GlProc glfwGetProcAddress(const char* procname);
+static GlMemoryBarrierFn gl_memory_barrier;
+
+static uint32_t pack_color(Color c) {
+    return (uint32_t)c.r | (uint32_t)c.g << 8 | (uint32_t)c.b << 16 | (uint32_t)c.a << 24;
+}
+
+static unsigned int load_compute_program(const char* code) {
+    unsigned int shader = rlCompileShader(code, RL_COMPUTE_SHADER);
+    return shader ? rlLoadComputeShaderProgram(shader) : 0;
+}
+
+bool gpu_init(GpuSimulation* gpu) {
+    *gpu = (GpuSimulation){0};
+    if(rlGetVersion() != RL_OPENGL_43) {
+        ext_log(EXT_WARNING, "GPU: compute shaders need OpenGL 4.3, using the CPU solvers");
+        return false;
+    }
+
+    gl_memory_barrier = (GlMemoryBarrierFn)glfwGetProcAddress("glMemoryBarrier");
+    gpu->drift_program = load_compute_program(drift_shader);
+    gpu->force_program = load_compute_program(force_shader);
+    gpu->draw_program = rlLoadShaderCode(draw_vertex_shader, draw_fragment_shader);
+    gpu->vao = rlLoadVertexArray();
+    // On failure rlgl falls back to its default shader, which must not be unloaded
+    if(gpu->draw_program == rlGetShaderIdDefault()) gpu->draw_program = 0;
+    if(!gl_memory_barrier || !gpu->drift_program || !gpu->force_program || !gpu->draw_program ||
+       !gpu->vao) {
+        ext_log(EXT_WARNING, "GPU: couldn't set up compute shaders, using the CPU solvers");
+        gpu_destroy(gpu);
+        return false;
+    }
+
+    gpu->drift_count_loc = rlGetLocationUniform(gpu->drift_program, "count");
+    gpu->drift_dt_loc = rlGetLocationUniform(gpu->drift_program, "dt");
+    gpu->force_count_loc = rlGetLocationUniform(gpu->force_program, "count");
+    gpu->force_dt_loc = rlGetLocationUniform(gpu->force_program, "dt");
+    gpu->draw_mvp_loc = rlGetLocationUniform(gpu->draw_program, "mvp");
+    gpu->draw_alpha_loc = rlGetLocationUniform(gpu->draw_program, "alpha");
+    gpu->available = true;
+    return true;
+}
+
+static void unload_buffers(GpuSimulation* gpu) {
+    if(gpu->positions) rlUnloadShaderBuffer(gpu->positions);
+    if(gpu->states) rlUnloadShaderBuffer(gpu->states);
+    if(gpu->previous) rlUnloadShaderBuffer(gpu->previous);
+    if(gpu->colors) rlUnloadShaderBuffer(gpu->colors);
+    gpu->positions = gpu->states = gpu->previous = gpu->colors = 0;
+}
+
+static unsigned int grow_buffer(unsigned int old, size_t stride, size_t size, size_t capacity) {
+    unsigned int buf = rlLoadShaderBuffer(stride * capacity, NULL, RL_DYNAMIC_COPY);
+    if(old) {
+        if(size) rlCopyShaderBuffer(buf, old, 0, 0, stride * size);
+        rlUnloadShaderBuffer(old);
+    }
+    return buf;
+}
+
+// Grows the buffers to hold at least `capacity` bodies, preserving their content
+static void gpu_reserve(GpuSimulation* gpu, size_t capacity) {
+    if(capacity <= gpu->capacity) return;
+    size_t newcap = gpu->capacity ? gpu->capacity : 1024;
+    while(newcap < capacity) newcap *= 2;
+    gpu->positions = grow_buffer(gpu->positions, POSITION_STRIDE, gpu->size, newcap);
+    gpu->states = grow_buffer(gpu->states, STATE_STRIDE, gpu->size, newcap);
+    gpu->previous = grow_buffer(gpu->previous, PREVIOUS_STRIDE, gpu->size, newcap);
+    gpu->colors = grow_buffer(gpu->colors, COLOR_STRIDE, gpu->size, newcap);
+    gpu->capacity = newcap;
+}
+
+// Converts `n` bodies starting at `start` to the buffer layouts and uploads them at body `dst`
+static void upload_bodies(GpuSimulation* gpu, const CelestialBodies* b, size_t start, size_t n,
+                          size_t dst) {
+    size_t sz = n * (POSITION_STRIDE + STATE_STRIDE + PREVIOUS_STRIDE + COLOR_STRIDE);
+    float* positions = ext_alloc(sz);
+    float* states = positions + 4 * n;
+    float* previous = states + 4 * n;
+    uint32_t* colors = (uint32_t*)(previous + 2 * n);
+
+    for(size_t k = 0; k < n; k++) {
+        size_t i = start + k;
+        float* p = &positions[4 * k];
+        float* s = &states[4 * k];
+        float* q = &previous[2 * k];
+        p[0] = b->position[i].x, p[1] = b->position[i].y, p[2] = b->mass[i], p[3] = b->radius[i];
+        s[0] = b->velocity[i].x, s[1] = b->velocity[i].y, s[2] = b->force[i].x, s[3] = b->force[i].y;
+        // The CPU doesn't keep the previous positions, start interpolating from the current ones
+        q[0] = b->position[i].x, q[1] = b->position[i].y;
+        colors[k] = pack_color(b->color[i]);
+    }
+
+    rlUpdateShaderBuffer(gpu->positions, positions, n * POSITION_STRIDE, dst * POSITION_STRIDE);
+    rlUpdateShaderBuffer(gpu->states, states, n * STATE_STRIDE, dst * STATE_STRIDE);
+    rlUpdateShaderBuffer(gpu->previous, previous, n * PREVIOUS_STRIDE, dst * PREVIOUS_STRIDE);
+    rlUpdateShaderBuffer(gpu->colors, colors, n * COLOR_STRIDE, dst * COLOR_STRIDE);
+    ext_free(positions, sz);
+}
+
+void gpu_upload(GpuSimulation* gpu, const CelestialBodies* bodies) {
+    EXT_ASSERT(gpu->available, "GPU simulation not available");
+    gpu->size = 0;
+    gpu_reserve(gpu, bodies->size);
+    if(bodies->size) upload_bodies(gpu, bodies, 0, bodies->size, 0);
+    gpu->size = bodies->size;
+}
+
+void gpu_push(GpuSimulation* gpu, const CelestialBodies* bodies, size_t i) {
+    EXT_ASSERT(gpu->available, "GPU simulation not available");
+    gpu_reserve(gpu, gpu->size + 1);
+    upload_bodies(gpu, bodies, i, 1, gpu->size);
+    gpu->size++;
+}
+
+void gpu_download(const GpuSimulation* gpu, CelestialBodies* b) {
+    EXT_ASSERT(gpu->available, "GPU simulation not available");
+    EXT_ASSERT(b->size == gpu->size, "bodies out of sync with the GPU state");
+    size_t n = gpu->size;
+    if(!n) return;
+
+    size_t sz = n * (POSITION_STRIDE + STATE_STRIDE);
+    float* positions = ext_alloc(sz);
+    float* states = positions + 4 * n;
+    rlReadShaderBuffer(gpu->positions, positions, n * POSITION_STRIDE, 0);
+    rlReadShaderBuffer(gpu->states, states, n * STATE_STRIDE, 0);
+
+    for(size_t i = 0; i < n; i++) {
+        const float* p = &positions[4 * i];
+        const float* s = &states[4 * i];
+        b->position[i] = (Vector2){p[0], p[1]};
+        b->velocity[i] = (Vector2){s[0], s[1]};
+        b->force[i] = (Vector2){s[2], s[3]};
+    }
+    ext_free(positions, sz);
+}
+
+static void bind_buffers(const GpuSimulation* gpu) {
+    rlBindShaderBuffer(gpu->positions, 0);
+    rlBindShaderBuffer(gpu->states, 1);
+    rlBindShaderBuffer(gpu->previous, 2);
+    rlBindShaderBuffer(gpu->colors, 3);
+}
+
+static void dispatch(const GpuSimulation* gpu, unsigned int program, int count_loc, int dt_loc,
+                     float dt) {
+    int count = (int)gpu->size;
+    rlEnableShader(program);
+    rlSetUniform(count_loc, &count, RL_SHADER_UNIFORM_INT, 1);
+    rlSetUniform(dt_loc, &dt, RL_SHADER_UNIFORM_FLOAT, 1);
+    bind_buffers(gpu);
+    rlComputeShaderDispatch((gpu->size + GPU_GROUP_SIZE - 1) / GPU_GROUP_SIZE, 1, 1);
+    gl_memory_barrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    rlDisableShader();
+}
+
+void gpu_step(GpuSimulation* gpu, float dt) {
+    EXT_ASSERT(gpu->available, "GPU simulation not available");
+    if(!gpu->size) return;
+    dispatch(gpu, gpu->drift_program, gpu->drift_count_loc, gpu->drift_dt_loc, dt);
+    dispatch(gpu, gpu->force_program, gpu->force_count_loc, gpu->force_dt_loc, dt);
+}
+
+void gpu_draw(const GpuSimulation* gpu, float alpha) {
+    EXT_ASSERT(gpu->available, "GPU simulation not available");
+    if(!gpu->size) return;
+
+    // Flush what raylib batched so far, so that bodies are drawn in order
+    rlDrawRenderBatchActive();
+
+    rlEnableShader(gpu->draw_program);
+    rlSetUniformMatrix(gpu->draw_mvp_loc,
+                       MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection()));
+    rlSetUniform(gpu->draw_alpha_loc, &alpha, RL_SHADER_UNIFORM_FLOAT, 1);
+    bind_buffers(gpu);
+    rlEnableVertexArray(gpu->vao);
+    rlDrawVertexArray(0, (int)(gpu->size * 6));
+    rlDisableVertexArray();
+    rlDisableShader();
+}
+
+void gpu_destroy(GpuSimulation* gpu) {
+    unload_buffers(gpu);
+    if(gpu->vao) rlUnloadVertexArray(gpu->vao);
+    if(gpu->drift_program) rlUnloadShaderProgram(gpu->drift_program);
+    if(gpu->force_program) rlUnloadShaderProgram(gpu->force_program);
+    if(gpu->draw_program) rlUnloadShaderProgram(gpu->draw_program);
+    *gpu = (GpuSimulation){0};
+}
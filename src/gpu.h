@@ -0,0 +1,50 @@
+#ifndef GPU_H
+#define GPU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "body.h"
+
+// N-body simulation running entirely on the GPU through OpenGL 4.3 compute shaders.
+// Body state lives in shader storage buffers: every substep is a drift dispatch followed by a
+// tiled force + kick dispatch, and bodies are drawn straight from the same buffers, so nothing
+// goes back to the CPU unless `gpu_download` is called explicitly.
+// Requires raylib to be built with GRAPHICS_API_OPENGL_43. When compute shaders are not
+// available `gpu_init` returns false and the CPU solvers should be used instead.
+
+// Work group size of the compute shaders, also the number of bodies per shared-memory tile
+#define GPU_GROUP_SIZE (256)
+
+typedef struct {
+    bool available;
+    // Number of bodies in the buffers
+    size_t size, capacity;
+
+    // Private fields
+    unsigned int drift_program, force_program, draw_program, vao;
+    // Shader storage buffers, see the layouts in gpu.c
+    unsigned int positions, states, previous, colors;
+    int drift_count_loc, drift_dt_loc;
+    int force_count_loc, force_dt_loc;
+    int draw_mvp_loc, draw_alpha_loc;
+} GpuSimulation;
+
+// Compiles the shaders. Must be called after the window (and thus the OpenGL context) is
+// created. Returns false, leaving `available` unset, if compute shaders are not supported.
+bool gpu_init(GpuSimulation* gpu);
+// Replaces the GPU state with `bodies`
+void gpu_upload(GpuSimulation* gpu, const CelestialBodies* bodies);
+// Appends body `i` of `bodies` to the GPU state, leaving the others untouched
+void gpu_push(GpuSimulation* gpu, const CelestialBodies* bodies, size_t i);
+// Reads the GPU state back into `bodies`, which must hold the same bodies that were uploaded
+void gpu_download(const GpuSimulation* gpu, CelestialBodies* bodies);
+// Advances the simulation by `dt` seconds
+void gpu_step(GpuSimulation* gpu, float dt);
+// Draws all bodies interpolating between the last two substeps by `alpha`. To be called between
+// `BeginDrawing` and `EndDrawing`.
+void gpu_draw(const GpuSimulation* gpu, float alpha);
+// Frees all GPU resources
+void gpu_destroy(GpuSimulation* gpu);
+
+#endif
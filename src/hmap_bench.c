@@ -0,0 +1,254 @@
+// Micro-benchmark of the extlib hashmap: times insertions and lookups of the kinds of keys the
+// simulation uses (cell coordinates, body identifiers) and of longer byte keys, under each hash
+// policy, with and without reserving the map up front.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EXTLIB_IMPL
+#include "extlib.h"
+
+typedef struct {
+    size_t keys, rounds;
+    unsigned seed;
+    bool csv;
+} Options;
+
+typedef struct {
+    // Best of all rounds, in nanoseconds per operation
+    double insert_ns, hit_ns, miss_ns;
+    // Mean probe length of a hit, i.e. distance to the bucket the key hashes to, plus one
+    double probes;
+} Timing;
+
+// Cell coordinates of the collision broadphase
+typedef struct {
+    int32_t x, y;
+} Cell;
+
+// Longer keys hashed as bytes, like names or file paths
+typedef struct {
+    char bytes[32];
+} Name;
+
+#define ENTRY_TYPES(K, name)      \
+    typedef struct {              \
+        K key;                    \
+        uint32_t value;           \
+    } name##Entry;                \
+    typedef struct {              \
+        name##Entry* entries;     \
+        size_t* hashes;           \
+        size_t size, capacity;    \
+        Ext_Allocator* allocator; \
+    } name##Map;
+
+ENTRY_TYPES(Cell, Cell)
+ENTRY_TYPES(uint32_t, Id)
+ENTRY_TYPES(Name, Name)
+
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// SplitMix64
+static uint64_t rng_next(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Keeps the compiler from optimizing the lookups away
+static volatile uint32_t sink;
+
+// Times `rounds` fills of a map with `keys`, and lookups of every key and of as many absent ones
+// in `misses`, with the given hash function. `hash_fn` is a macro argument of the hashmap, so
+// every pairing of key and hash gets its own function.
+#define BENCH(fn, name, hash_fn)                                                                  \
+    static Timing fn(const name##Entry* keys, const name##Entry* misses, size_t n, bool reserve, \
+                     size_t rounds) {                                                             \
+        Timing t = {1e30, 1e30, 1e30, 0};                                                         \
+        for(size_t r = 0; r < rounds; r++) {                                                      \
+            name##Map map = {0};                                                                  \
+            double start = now();                                                                 \
+            if(reserve) ext_hmap_reserve(&map, n);                                                \
+            for(size_t i = 0; i < n; i++) {                                                       \
+                ext_hmap_put_ex(&map, keys[i].key, keys[i].value, hash_fn, ext_hmap_memcmp_);     \
+            }                                                                                     \
+            double inserted = now();                                                              \
+            uint32_t sum = 0;                                                                     \
+            for(size_t i = 0; i < n; i++) {                                                       \
+                name##Entry* e;                                                                   \
+                ext_hmap_get_ex(&map, keys[i].key, &e, hash_fn, ext_hmap_memcmp_);                \
+                sum += e->value;                                                                  \
+            }                                                                                     \
+            double hit = now();                                                                   \
+            for(size_t i = 0; i < n; i++) {                                                       \
+                name##Entry* e;                                                                   \
+                ext_hmap_get_ex(&map, misses[i].key, &e, hash_fn, ext_hmap_memcmp_);              \
+                sum += e != NULL;                                                                 \
+            }                                                                                     \
+            double miss = now();                                                                  \
+            sink += sum;                                                                          \
+            if(inserted - start < t.insert_ns) t.insert_ns = inserted - start;                    \
+            if(hit - inserted < t.hit_ns) t.hit_ns = hit - inserted;                              \
+            if(miss - hit < t.miss_ns) t.miss_ns = miss - hit;                                    \
+            size_t probes = 0;                                                                    \
+            ext_hmap_foreach(name##Entry, it, &map) {                                             \
+                size_t slot = it - map.entries - 1;                                               \
+                size_t home = map.hashes[slot + 1] & map.capacity;                                \
+                probes += ((slot - home) & map.capacity) + 1;                                     \
+            }                                                                                     \
+            t.probes = (double)probes / map.size;                                                \
+            ext_hmap_free(&map);                                                                  \
+        }                                                                                         \
+        t.insert_ns *= 1e9 / n;                                                                   \
+        t.hit_ns *= 1e9 / n;                                                                      \
+        t.miss_ns *= 1e9 / n;                                                                     \
+        return t;                                                                                 \
+    }
+
+BENCH(bench_cell_bytes, Cell, ext_hmap_hash_bytes_)
+BENCH(bench_cell_wyhash, Cell, ext_hmap_hash_wyhash_)
+BENCH(bench_cell_int, Cell, ext_hmap_hash_int_)
+BENCH(bench_id_bytes, Id, ext_hmap_hash_bytes_)
+BENCH(bench_id_wyhash, Id, ext_hmap_hash_wyhash_)
+BENCH(bench_id_int, Id, ext_hmap_hash_int_)
+BENCH(bench_name_bytes, Name, ext_hmap_hash_bytes_)
+BENCH(bench_name_wyhash, Name, ext_hmap_hash_wyhash_)
+
+static void report(const Options* opt, const char* keys, const char* hash, bool reserve, Timing t) {
+    if(opt->csv) {
+        printf("%s,%s,%d,%zu,%.2f,%.2f,%.2f,%.3f\n", keys, hash, reserve, opt->keys, t.insert_ns,
+               t.hit_ns, t.miss_ns, t.probes);
+    } else {
+        printf("%-6s %-8s %-8s %10.2f %10.2f %10.2f %8.3f\n", keys, hash, reserve ? "yes" : "no",
+               t.insert_ns, t.hit_ns, t.miss_ns, t.probes);
+    }
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -n KEYS       keys inserted into each map (default 1048576)\n"
+            "  -r ROUNDS     rounds of each benchmark, keeping the best (default 5)\n"
+            "  --seed SEED   seed of the generated keys (default 1)\n"
+            "  --csv         print results as CSV\n",
+            prog);
+}
+
+static bool parse_size(const char* s, size_t* out) {
+    if(!s) return false;
+    char* end;
+    unsigned long long v = strtoull(s, &end, 10);
+    if(end == s || *end) return false;
+    *out = (size_t)v;
+    return true;
+}
+
+static bool parse_args(int argc, char** argv, Options* opt) {
+    for(int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if(strcmp(arg, "-n") == 0) {
+            if(!parse_size(argv[++i], &opt->keys) || !opt->keys) return false;
+        } else if(strcmp(arg, "-r") == 0) {
+            if(!parse_size(argv[++i], &opt->rounds) || !opt->rounds) return false;
+        } else if(strcmp(arg, "--seed") == 0) {
+            size_t seed;
+            if(!parse_size(argv[++i], &seed)) return false;
+            opt->seed = (unsigned)seed;
+        } else if(strcmp(arg, "--csv") == 0) {
+            opt->csv = true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options opt = {.keys = 1 << 20, .rounds = 5, .seed = 1};
+    if(!parse_args(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+    size_t n = opt.keys;
+    uint64_t rng = opt.seed;
+
+    // Cells of bodies scattered over a square about as many cells wide as there are bodies along
+    // a side, as the broadphase sees a uniform field. Duplicates only overwrite their value.
+    // Misses are the cells on the far side of the origin.
+    CellEntry* cells = ext_alloc(sizeof(CellEntry) * n);
+    CellEntry* cell_misses = ext_alloc(sizeof(CellEntry) * n);
+    uint32_t side = 1;
+    while((size_t)side * side < n) side *= 2;
+    for(size_t i = 0; i < n; i++) {
+        uint64_t r = rng_next(&rng);
+        cells[i] = (CellEntry){{(int32_t)(r % side), (int32_t)((r >> 32) % side)}, (uint32_t)i};
+        cell_misses[i] = (CellEntry){{-1 - cells[i].key.x, cells[i].key.y}, 0};
+    }
+
+    // Body identifiers, handed out consecutively and looked up in random order. Misses are
+    // identifiers not handed out yet.
+    IdEntry* ids = ext_alloc(sizeof(IdEntry) * n);
+    IdEntry* id_misses = ext_alloc(sizeof(IdEntry) * n);
+    for(size_t i = 0; i < n; i++) ids[i] = (IdEntry){(uint32_t)i, (uint32_t)i};
+    for(size_t i = n - 1; i > 0; i--) {
+        size_t j = rng_next(&rng) % (i + 1);
+        IdEntry tmp = ids[i];
+        ids[i] = ids[j];
+        ids[j] = tmp;
+    }
+    for(size_t i = 0; i < n; i++) id_misses[i] = (IdEntry){(uint32_t)(n + i), 0};
+
+    // Zero padded names sharing a prefix, unique by their trailing number
+    NameEntry* names = ext_alloc(sizeof(NameEntry) * n);
+    NameEntry* name_misses = ext_alloc(sizeof(NameEntry) * n);
+    for(size_t i = 0; i < n; i++) {
+        names[i] = (NameEntry){{{0}}, (uint32_t)i};
+        name_misses[i] = (NameEntry){{{0}}, 0};
+        snprintf(names[i].key.bytes, sizeof(names[i].key.bytes), "scene-body-%zu", i);
+        snprintf(name_misses[i].key.bytes, sizeof(name_misses[i].key.bytes), "scene-miss-%zu", i);
+    }
+
+    if(opt.csv) {
+        printf("keys,hash,reserve,n,insert_ns,hit_ns,miss_ns,probes\n");
+    } else {
+        printf("%zu keys, best of %zu rounds, nanoseconds per operation\n", n, opt.rounds);
+        printf("%-6s %-8s %-8s %10s %10s %10s %8s\n", "keys", "hash", "reserve", "insert", "hit",
+               "miss", "probes");
+    }
+    for(int reserve = 0; reserve <= 1; reserve++) {
+        report(&opt, "cell", "bytes", reserve,
+               bench_cell_bytes(cells, cell_misses, n, reserve, opt.rounds));
+        report(&opt, "cell", "wyhash", reserve,
+               bench_cell_wyhash(cells, cell_misses, n, reserve, opt.rounds));
+        report(&opt, "cell", "int", reserve,
+               bench_cell_int(cells, cell_misses, n, reserve, opt.rounds));
+        report(&opt, "id", "bytes", reserve,
+               bench_id_bytes(ids, id_misses, n, reserve, opt.rounds));
+        report(&opt, "id", "wyhash", reserve,
+               bench_id_wyhash(ids, id_misses, n, reserve, opt.rounds));
+        report(&opt, "id", "int", reserve, bench_id_int(ids, id_misses, n, reserve, opt.rounds));
+        report(&opt, "name", "bytes", reserve,
+               bench_name_bytes(names, name_misses, n, reserve, opt.rounds));
+        report(&opt, "name", "wyhash", reserve,
+               bench_name_wyhash(names, name_misses, n, reserve, opt.rounds));
+    }
+
+    ext_free(cells, sizeof(CellEntry) * n);
+    ext_free(cell_misses, sizeof(CellEntry) * n);
+    ext_free(ids, sizeof(IdEntry) * n);
+    ext_free(id_misses, sizeof(IdEntry) * n);
+    ext_free(names, sizeof(NameEntry) * n);
+    ext_free(name_misses, sizeof(NameEntry) * n);
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include "jobs.h"
+
+#include <string.h>
+
+#include "extlib.h"
+
+static THREAD_LOCAL size_t worker_index = 0;
+
+static void deque_init(JobDeque* d) {
+    mutex_init(&d->lock);
+    d->items = NULL;
+    d->top = d->bottom = d->capacity = 0;
+}
+
+static void deque_destroy(JobDeque* d) {
+    if(d->items) ext_free(d->items, sizeof(Job) * d->capacity);
+    mutex_destroy(&d->lock);
+}
+
+// Grows the deque so that it can hold at least `requested_cap` jobs
+static void deque_reserve(JobDeque* d, size_t requested_cap) {
+    mutex_lock(&d->lock);
+    if(d->capacity < requested_cap) {
+        size_t newcap = d->capacity ? d->capacity * 2 : 16;
+        while(newcap < requested_cap) newcap *= 2;
+        Job* items = ext_alloc(sizeof(Job) * newcap);
+        size_t size = d->bottom - d->top;
+        for(size_t i = 0; i < size; i++) {
+            items[i] = d->items[(d->top + i) & (d->capacity - 1)];
+        }
+        if(d->items) ext_free(d->items, sizeof(Job) * d->capacity);
+        d->items = items;
+        d->top = 0;
+        d->bottom = size;
+        d->capacity = newcap;
+    }
+    mutex_unlock(&d->lock);
+}
+
+static void deque_push(JobDeque* d, Job job) {
+    mutex_lock(&d->lock);
+    EXT_ASSERT(d->bottom - d->top < d->capacity, "job deque is full");
+    d->items[d->bottom++ & (d->capacity - 1)] = job;
+    mutex_unlock(&d->lock);
+}
+
+// Owner side: most recently pushed job first
+static bool deque_pop(JobDeque* d, Job* out) {
+    mutex_lock(&d->lock);
+    bool found = d->bottom != d->top;
+    if(found) *out = d->items[--d->bottom & (d->capacity - 1)];
+    mutex_unlock(&d->lock);
+    return found;
+}
+
+// Thief side: oldest job first
+static bool deque_steal(JobDeque* d, Job* out) {
+    mutex_lock(&d->lock);
+    bool found = d->bottom != d->top;
+    if(found) *out = d->items[d->top++ & (d->capacity - 1)];
+    mutex_unlock(&d->lock);
+    return found;
+}
+
+static bool take_job(JobPool* pool, size_t self, Job* out) {
+    if(atomic_load_explicit(&pool->queued, memory_order_relaxed) == 0) return false;
+
+    bool found = deque_pop(&pool->deques[self], out);
+    for(size_t i = 1; !found && i < pool->workers; i++) {
+        found = deque_steal(&pool->deques[(self + i) % pool->workers], out);
+    }
+    if(found) atomic_fetch_sub(&pool->queued, 1);
+    return found;
+}
+
+static void run_job(JobPool* pool, const Job* job) {
+    job->fn(job->ctx, job->start, job->end);
+    atomic_fetch_sub_explicit(&pool->pending, 1, memory_order_release);
+}
+
+static void worker_main(void* arg) {
+    JobWorker* w = arg;
+    JobPool* pool = w->pool;
+    worker_index = w->index;
+
+    for(;;) {
+        Job job;
+        bool found = false;
+        for(int spin = 0; !found && spin < JOBS_SPIN_COUNT; spin++) {
+            found = take_job(pool, w->index, &job);
+            if(!found) thread_yield();
+        }
+
+        if(found) {
+            run_job(pool, &job);
+            continue;
+        }
+
+        mutex_lock(&pool->lock);
+        while(!pool->shutdown && atomic_load(&pool->queued) == 0) {
+            cond_wait(&pool->wake, &pool->lock);
+        }
+        bool shutdown = pool->shutdown;
+        mutex_unlock(&pool->lock);
+        if(shutdown) return;
+    }
+}
+
+void jobs_init(JobPool* pool, size_t workers) {
+    if(!workers) workers = thread_hardware_concurrency();
+    if(workers > JOBS_MAX_WORKERS) workers = JOBS_MAX_WORKERS;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->workers = workers;
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->pending, 0);
+    mutex_init(&pool->lock);
+    cond_init(&pool->wake);
+    ext_arena_pool_init(&pool->scratch, workers, NULL, JOBS_SCRATCH_PAGE);
+
+    for(size_t i = 0; i < workers; i++) {
+        deque_init(&pool->deques[i]);
+    }
+
+    for(size_t i = 1; i < workers; i++) {
+        JobWorker* w = &pool->threads[i];
+        w->pool = pool;
+        w->index = i;
+        if(!thread_create(&w->thread, worker_main, w)) {
+            ext_log(EXT_WARNING, "job pool: running with %zu workers instead of %zu", i, workers);
+            pool->workers = i;
+            break;
+        }
+    }
+}
+
+void jobs_parallel_for(JobPool* pool, size_t count, size_t chunk, JobFn fn, void* ctx) {
+    if(!count) return;
+    if(!chunk) chunk = 1;
+    size_t chunks = (count + chunk - 1) / chunk;
+
+    // Not worth waking anyone up
+    if(pool->workers == 1 || chunks == 1) {
+        for(size_t start = 0; start < count; start += chunk) {
+            fn(ctx, start, start + chunk < count ? start + chunk : count);
+        }
+        return;
+    }
+
+    size_t per_worker = (chunks + pool->workers - 1) / pool->workers;
+    for(size_t i = 0; i < pool->workers; i++) {
+        deque_reserve(&pool->deques[i], per_worker);
+    }
+
+    // Deal the chunks in contiguous runs, so that each worker starts on neighbouring bodies
+    atomic_store(&pool->pending, chunks);
+    for(size_t c = 0; c < chunks; c++) {
+        size_t start = c * chunk, end = start + chunk < count ? start + chunk : count;
+        deque_push(&pool->deques[c / per_worker], (Job){fn, ctx, start, end});
+    }
+
+    mutex_lock(&pool->lock);
+    atomic_fetch_add(&pool->queued, chunks);
+    cond_broadcast(&pool->wake);
+    mutex_unlock(&pool->lock);
+
+    // Take part in the batch until every chunk is done
+    size_t self = jobs_worker_index();
+    while(atomic_load_explicit(&pool->pending, memory_order_acquire) > 0) {
+        Job job;
+        if(take_job(pool, self, &job)) run_job(pool, &job);
+        else thread_yield();
+    }
+}
+
+void jobs_destroy(JobPool* pool) {
+    mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    cond_broadcast(&pool->wake);
+    mutex_unlock(&pool->lock);
+
+    for(size_t i = 1; i < pool->workers; i++) {
+        thread_join(&pool->threads[i].thread);
+    }
+    for(size_t i = 0; i < pool->workers; i++) {
+        deque_destroy(&pool->deques[i]);
+    }
+    cond_destroy(&pool->wake);
+    mutex_destroy(&pool->lock);
+    ext_arena_pool_destroy(&pool->scratch);
+}
+
+void* jobs_scratch(JobPool* pool, size_t size) {
+    // Threads of other pools may have a larger index, they'd only contend with a worker of this one
+    return ext_arena_pool_alloc(&pool->scratch, worker_index % pool->scratch.count, size);
+}
+
+void jobs_reset_scratch(JobPool* pool) {
+    ext_arena_pool_reset(&pool->scratch);
+}
+
+size_t jobs_worker_index(void) {
+    return worker_index;
+}
@@ -0,0 +1,98 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "extlib.h"
+#include "thread.h"
+
+// A small job system built on a persistent pool of worker threads.
+// Every worker, including the thread calling `jobs_parallel_for`, owns a deque of jobs: it pops
+// work from the bottom of its own deque and, when that runs dry, steals from the top of the
+// others'. Jobs are ranges of indices, so a pass over the bodies is dispatched as a batch of
+// chunks, each processed entirely by a single thread.
+//
+// USAGE
+// ```c
+// static void job(void* ctx, size_t start, size_t end) {
+//     for(size_t i = start; i < end; i++) {
+//         // ...
+//     }
+// }
+//
+// JobPool pool;
+// jobs_init(&pool, 0);                          // one worker per hardware thread
+// jobs_parallel_for(&pool, n, 1024, job, NULL); // blocks until all chunks are done
+// jobs_destroy(&pool);
+// ```
+//
+// Jobs needing temporary memory allocate it with `jobs_scratch`, from an arena of their worker, so
+// that they neither contend on a lock nor go through the global allocator once the arenas have
+// grown to their peak usage. Scratch memory stays valid on every thread until
+// `jobs_reset_scratch`, e.g. to hand results over to the next batch.
+
+#define JOBS_MAX_WORKERS (64)
+// Number of failed attempts at finding work before a worker goes to sleep
+#define JOBS_SPIN_COUNT (64)
+// Pages of the scratch arenas, larger allocations get pages of their own
+#define JOBS_SCRATCH_PAGE (1 << 20)
+
+typedef void (*JobFn)(void* ctx, size_t start, size_t end);
+
+typedef struct {
+    JobFn fn;
+    void* ctx;
+    size_t start, end;
+} Job;
+
+typedef struct {
+    Mutex lock;
+    // Ring buffer of `capacity` (a power of 2) jobs. Live jobs are in [top, bottom).
+    Job* items;
+    size_t top, bottom, capacity;
+} JobDeque;
+
+typedef struct {
+    struct JobPool* pool;
+    size_t index;
+    Thread thread;
+} JobWorker;
+
+// The pool must not be moved after `jobs_init`, as its workers keep a pointer to it.
+typedef struct JobPool {
+    // Number of threads taking part in a batch, including the one calling `jobs_parallel_for`
+    size_t workers;
+    // Scratch arenas, one per worker. Read only, e.g. for its stats.
+    Ext_ArenaPool scratch;
+
+    // Private fields
+    JobWorker threads[JOBS_MAX_WORKERS];
+    JobDeque deques[JOBS_MAX_WORKERS];
+    // Jobs currently sitting in the deques
+    atomic_size_t queued;
+    // Jobs of the current batch not yet completed
+    atomic_size_t pending;
+    Mutex lock;
+    CondVar wake;
+    bool shutdown;
+} JobPool;
+
+// Initializes the pool and starts `workers - 1` threads. The thread calling `jobs_parallel_for`
+// acts as worker 0. If `workers` is 0, one worker per hardware thread is used.
+void jobs_init(JobPool* pool, size_t workers);
+// Splits [0, count) into chunks of at most `chunk` indices and runs `fn(ctx, start, end)` on each
+// chunk across the pool, blocking until all of them are done.
+// Only one thread at a time should dispatch on a given pool, and jobs must not dispatch again.
+void jobs_parallel_for(JobPool* pool, size_t count, size_t chunk, JobFn fn, void* ctx);
+// Stops all workers and frees the pool's resources
+void jobs_destroy(JobPool* pool);
+// Allocates `size` bytes from the scratch arena of the calling worker. Thread safe.
+void* jobs_scratch(JobPool* pool, size_t size);
+// Frees all scratch memory at once, keeping it for reuse. Must not be called during a batch.
+void jobs_reset_scratch(JobPool* pool);
+// Index of the calling thread in [0, workers). Threads not belonging to a pool get 0.
+size_t jobs_worker_index(void);
+
+#endif
@@ -0,0 +1,220 @@
+#include "kernel.h"
+
+#include <math.h>
+
+#include "extlib.h"
+
+// Index of the `k`-th target
+#define TARGET(targets, k) ((targets) ? (size_t)(targets)[k] : (k))
+
+#if defined(EXT_AVX512F)
+#include <immintrin.h>
+#define KERNEL_ISA   "AVX-512"
+#define KERNEL_WIDTH 16
+typedef __m512 vfloat;
+#define vset1(x)        _mm512_set1_ps(x)
+#define vload(p)        _mm512_loadu_ps(p)
+#define vstore(p, v)    _mm512_storeu_ps(p, v)
+#define vadd(a, b)      _mm512_add_ps(a, b)
+#define vsub(a, b)      _mm512_sub_ps(a, b)
+#define vmul(a, b)      _mm512_mul_ps(a, b)
+#define vmax(a, b)      _mm512_max_ps(a, b)
+#define vfmadd(a, b, c) _mm512_fmadd_ps(a, b, c)
+#define vrsqrt_est(x)   _mm512_rsqrt14_ps(x)
+#elif defined(EXT_AVX2)
+#include <immintrin.h>
+#define KERNEL_ISA   "AVX2"
+#define KERNEL_WIDTH 8
+typedef __m256 vfloat;
+#define vset1(x)     _mm256_set1_ps(x)
+#define vload(p)     _mm256_loadu_ps(p)
+#define vstore(p, v) _mm256_storeu_ps(p, v)
+#define vadd(a, b)   _mm256_add_ps(a, b)
+#define vsub(a, b)   _mm256_sub_ps(a, b)
+#define vmul(a, b)   _mm256_mul_ps(a, b)
+#define vmax(a, b)   _mm256_max_ps(a, b)
+#ifdef EXT_FMA
+#define vfmadd(a, b, c) _mm256_fmadd_ps(a, b, c)
+#else
+#define vfmadd(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+#endif  // EXT_FMA
+#define vrsqrt_est(x) _mm256_rsqrt_ps(x)
+#elif defined(EXT_SSE2)
+#include <emmintrin.h>
+#define KERNEL_ISA   "SSE2"
+#define KERNEL_WIDTH 4
+typedef __m128 vfloat;
+#define vset1(x)        _mm_set1_ps(x)
+#define vload(p)        _mm_loadu_ps(p)
+#define vstore(p, v)    _mm_storeu_ps(p, v)
+#define vadd(a, b)      _mm_add_ps(a, b)
+#define vsub(a, b)      _mm_sub_ps(a, b)
+#define vmul(a, b)      _mm_mul_ps(a, b)
+#define vmax(a, b)      _mm_max_ps(a, b)
+#define vfmadd(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#define vrsqrt_est(x)   _mm_rsqrt_ps(x)
+#elif defined(EXT_NEON)
+#include <arm_neon.h>
+#define KERNEL_ISA   "NEON"
+#define KERNEL_WIDTH 4
+typedef float32x4_t vfloat;
+#define vset1(x)     vdupq_n_f32(x)
+#define vload(p)     vld1q_f32(p)
+#define vstore(p, v) vst1q_f32(p, v)
+#define vadd(a, b)   vaddq_f32(a, b)
+#define vsub(a, b)   vsubq_f32(a, b)
+#define vmul(a, b)   vmulq_f32(a, b)
+#define vmax(a, b)   vmaxq_f32(a, b)
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define vfmadd(a, b, c) vfmaq_f32(c, a, b)
+#else
+#define vfmadd(a, b, c) vmlaq_f32(c, a, b)
+#endif
+// The NEON estimate is only good to ~8 bits, refine it once here so that the common Newton step
+// below brings it to full precision like on the other instruction sets
+static inline vfloat vrsqrt_est(vfloat x) {
+    vfloat y = vrsqrteq_f32(x);
+    return vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x, y), y));
+}
+#elif defined(EXT_WASM_SIMD)
+#include <wasm_simd128.h>
+#define KERNEL_ISA   "WASM SIMD"
+#define KERNEL_WIDTH 4
+typedef v128_t vfloat;
+#define vset1(x)     wasm_f32x4_splat(x)
+#define vload(p)     wasm_v128_load(p)
+#define vstore(p, v) wasm_v128_store(p, v)
+#define vadd(a, b)   wasm_f32x4_add(a, b)
+#define vsub(a, b)   wasm_f32x4_sub(a, b)
+#define vmul(a, b)   wasm_f32x4_mul(a, b)
+// Pseudo-maximum, a single instruction on every host unlike wasm_f32x4_max, which has to handle
+// NaNs and signed zeros. Distances are never NaN.
+#define vmax(a, b) wasm_f32x4_pmax(a, b)
+#ifdef __wasm_relaxed_simd__
+#define vfmadd(a, b, c) wasm_f32x4_relaxed_madd(a, b, c)
+#else
+#define vfmadd(a, b, c) wasm_f32x4_add(wasm_f32x4_mul(a, b), c)
+#endif  // __wasm_relaxed_simd__
+// There's no reciprocal square root estimate to refine, so 1 / sqrt(x) is computed exactly
+#define vrsqrt(x) wasm_f32x4_div(wasm_f32x4_splat(1.0f), wasm_f32x4_sqrt(x))
+#endif
+
+#ifdef KERNEL_WIDTH
+const char* const kernel_isa = KERNEL_ISA;
+const size_t kernel_width = KERNEL_WIDTH;
+
+#ifndef vrsqrt
+static inline vfloat vrsqrt(vfloat x) {
+    // One Newton-Raphson step on the estimate: y' = y * (1.5 - 0.5 * x * y^2)
+    vfloat y = vrsqrt_est(x);
+    return vmul(y, vsub(vset1(1.5f), vmul(vmul(vset1(0.5f), x), vmul(y, y))));
+}
+#endif  // vrsqrt
+
+void kernel_forces_indexed(const CelestialBodies* b, const uint32_t* targets, size_t start,
+                           size_t end, Vector2* out, float* potential) {
+    const Vector2* pos = b->position;
+    const float* mass = b->mass;
+    const vfloat eps = vset1(1e-6f);
+
+    for(size_t i = start; i < end; i += KERNEL_WIDTH) {
+        size_t lanes = end - i < KERNEL_WIDTH ? end - i : KERNEL_WIDTH;
+
+        // Gather the targets. Unused lanes get zero mass, so they end up with zero force.
+        size_t idx[KERNEL_WIDTH];
+        float tx[KERNEL_WIDTH], ty[KERNEL_WIDTH], tm[KERNEL_WIDTH];
+        for(size_t l = 0; l < KERNEL_WIDTH; l++) {
+            idx[l] = l < lanes ? TARGET(targets, i + l) : 0;
+            tx[l] = l < lanes ? pos[idx[l]].x : 0;
+            ty[l] = l < lanes ? pos[idx[l]].y : 0;
+            tm[l] = l < lanes ? mass[idx[l]] : 0;
+        }
+
+        vfloat x = vload(tx), y = vload(ty);
+        vfloat fx = vset1(0), fy = vset1(0), u = vset1(0);
+        for(size_t j = 0; j < b->size; j++) {
+            // The target itself has r = 0 and thus contributes nothing, no need to skip it
+            vfloat dx = vsub(vset1(pos[j].x), x);
+            vfloat dy = vsub(vset1(pos[j].y), y);
+            vfloat d2 = vfmadd(dx, dx, vmul(dy, dy));
+            vfloat inv_r = vrsqrt(vmax(d2, eps));
+            vfloat s = vmul(vset1(mass[j]), vmul(inv_r, vmul(inv_r, inv_r)));
+            fx = vfmadd(dx, s, fx);
+            fy = vfmadd(dy, s, fy);
+            // m2 / |r| = s * r^2, which is exactly zero for the target itself. The condition is
+            // loop invariant, so the compiler unswitches it out of the loop.
+            if(potential) u = vfmadd(s, d2, u);
+        }
+
+        // F = G * m1 * sum(m2 * r / |r|^3), U = -G * m1 * sum(m2 / |r|)
+        vfloat gm = vmul(vset1(G), vload(tm));
+        vstore(tx, vmul(fx, gm));
+        vstore(ty, vmul(fy, gm));
+        for(size_t l = 0; l < lanes; l++) {
+            out[idx[l]] = (Vector2){tx[l], ty[l]};
+        }
+        if(potential) {
+            vstore(tx, vmul(u, gm));
+            for(size_t l = 0; l < lanes; l++) {
+                potential[idx[l]] = -tx[l];
+            }
+        }
+    }
+}
+#else
+const char* const kernel_isa = "scalar";
+const size_t kernel_width = 1;
+
+void kernel_forces_indexed(const CelestialBodies* b, const uint32_t* targets, size_t start,
+                           size_t end, Vector2* out, float* potential) {
+    kernel_forces_scalar(b, targets, start, end, out, potential);
+}
+#endif  // KERNEL_WIDTH
+
+void kernel_forces(const CelestialBodies* b, size_t start, size_t end, Vector2* out,
+                   float* potential) {
+    kernel_forces_indexed(b, NULL, start, end, out, potential);
+}
+
+void kernel_forces_scalar(const CelestialBodies* b, const uint32_t* targets, size_t start,
+                          size_t end, Vector2* out, float* potential) {
+    const Vector2* pos = b->position;
+    const float* mass = b->mass;
+
+    for(size_t k = start; k < end; k++) {
+        size_t i = TARGET(targets, k);
+        float fx = 0, fy = 0, u = 0;
+        for(size_t j = 0; j < b->size; j++) {
+            float dx = pos[j].x - pos[i].x;
+            float dy = pos[j].y - pos[i].y;
+            float d2 = dx * dx + dy * dy;
+            float inv_r = 1.0f / sqrtf(fmaxf(d2, 1e-6f));
+            float s = mass[j] * inv_r * inv_r * inv_r;
+            fx += dx * s;
+            fy += dy * s;
+            u += s * d2;
+        }
+        out[i] = (Vector2){G * mass[i] * fx, G * mass[i] * fy};
+        if(potential) potential[i] = -G * mass[i] * u;
+    }
+}
+
+float kernel_max_error(const CelestialBodies* b) {
+    Vector2* simd = ext_alloc(sizeof(Vector2) * b->size);
+    Vector2* scalar = ext_alloc(sizeof(Vector2) * b->size);
+
+    kernel_forces(b, 0, b->size, simd, NULL);
+    kernel_forces_scalar(b, NULL, 0, b->size, scalar, NULL);
+
+    float max_err = 0, max_force = 0;
+    for(size_t i = 0; i < b->size; i++) {
+        float ex = simd[i].x - scalar[i].x, ey = simd[i].y - scalar[i].y;
+        float fx = scalar[i].x, fy = scalar[i].y;
+        max_err = fmaxf(max_err, sqrtf(ex * ex + ey * ey));
+        max_force = fmaxf(max_force, sqrtf(fx * fx + fy * fy));
+    }
+
+    ext_free(simd, sizeof(Vector2) * b->size);
+    ext_free(scalar, sizeof(Vector2) * b->size);
+    return max_force > 0 ? max_err / max_force : 0;
+}
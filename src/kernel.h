@@ -0,0 +1,39 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "body.h"
+#include "raylib.h"
+
+// Vectorized direct-summation force kernel.
+// Target bodies are laid out across the lanes of a SIMD register, while source bodies are
+// broadcast one at a time. 1/r is computed with a reciprocal square root estimate refined by a
+// Newton-Raphson step, so no divisions or square roots are left in the inner loop, except with WASM
+// SIMD (`-msimd128`) which has no such estimate.
+// The instruction set is picked at compile time from the `EXT_*` macros in extlib.h, falling back
+// to `kernel_forces_scalar` when none is available.
+
+// Name of the instruction set the kernel was compiled for
+extern const char* const kernel_isa;
+// Number of target bodies processed per instruction
+extern const size_t kernel_width;
+
+// Computes the force exerted by all bodies on the targets in [start, end), storing into
+// `out[start..end)`. Unless `potential` is NULL, also stores the potential energy of each target
+// into `potential[start..end)`.
+void kernel_forces(const CelestialBodies* bodies, size_t start, size_t end, Vector2* out,
+                   float* potential);
+// Same as `kernel_forces`, for the targets `targets[start..end)` instead. Results are still stored
+// at the index of each target. `targets` can be NULL to process [start, end) directly.
+void kernel_forces_indexed(const CelestialBodies* bodies, const uint32_t* targets, size_t start,
+                           size_t end, Vector2* out, float* potential);
+// Scalar reference implementation of `kernel_forces_indexed`, using an exact 1 / sqrt(r^2)
+void kernel_forces_scalar(const CelestialBodies* bodies, const uint32_t* targets, size_t start,
+                          size_t end, Vector2* out, float* potential);
+// Returns the maximum error of `kernel_forces` against `kernel_forces_scalar` over all bodies,
+// relative to the largest force magnitude.
+float kernel_max_error(const CelestialBodies* bodies);
+
+#endif
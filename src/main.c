@@ -1,46 +1,107 @@
 #include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define EXTLIB_IMPL
+#include "body.h"
 #include "extlib.h"
+#include "gpu.h"
+#include "kernel.h"
+#include "path.h"
+#include "preview.h"
+#include "profiler.h"
 #include "raylib.h"
 #include "raymath.h"
-
-#define G                (30)
-#define SIMULATION_STEPS (120)
-#define PATH_POINTS      (10000)
+#include "render.h"
+#include "replay.h"
+#include "rlgl.h"
+#include "runner.h"
+#include "scenario.h"
+#include "scene.h"
+#include "simulation.h"
+#include "tuner.h"
+
+#ifdef EXT_EMSCRIPTEN
+#include <emscripten.h>
+#endif
+
+#define PATH_POINTS (10000)
+// Width of the spawn path and how much it can deviate from the exact one once simplified, in pixels
+#define PATH_WIDTH     (4)
+#define PATH_TOLERANCE (0.5f)
+// Zoom factor per notch of the mouse wheel, and its bounds
+#define ZOOM_STEP (1.1f)
+#define ZOOM_MIN  (1e-3f)
+#define ZOOM_MAX  (1e2f)
+// Substeps between energy samples, 10 per simulated second
+#define ENERGY_INTERVAL (SIMULATION_STEPS >= 10 ? SIMULATION_STEPS / 10 : 1)
+// Saved with F5 and loaded with F9
+#define SCENE_PATH "scene.grav"
+// Recorded with R, at 30 frames per simulated second
+#define RECORDING_PATH     "trajectory.grec"
+#define RECORDING_INTERVAL (SIMULATION_STEPS >= 30 ? SIMULATION_STEPS / 30 : 1)
+// Written with F2
+#define PROFILE_PATH "profile.csv"
+// Size of the canvas on the web, where pages can't start in fullscreen
+#define WEB_WIDTH  (1280)
+#define WEB_HEIGHT (720)
 
 static const float sub_dt = 1. / SIMULATION_STEPS;
 
-typedef struct CelestialBody {
-    Vector2 position, prev_position;
-    Vector2 force, prev_force;
-    Vector2 velocity;
-    float radius;
-    float inv_mass;
-    Color color;
-} CelestialBody;
-
-typedef struct {
-    CelestialBody* items;
-    size_t size, capacity;
-    Allocator* allocator;
-} CelestialBodies;
-
-static CelestialBodies bodies;
+// Stepped by `runner` on its own thread, only to be touched between `runner_lock` and
+// `runner_unlock`. The fields only ever written here (workers, block steps) can still be read
+// directly, while the solver and theta, which the tuner also changes, are read from snapshots.
+static Simulation sim;
+static Runner runner;
+// Backs the arrays of `sim.bodies`, which then grow in place however many bodies are spawned
+static VmAllocator body_memory;
+static SceneWriter scene_writer;
+static Recorder recorder;
+// Picks the solver unless it was given on the command line or picked by hand (see tuner.h)
+static Tuner tuner;
+// Inputs, logged when started with `--log` so that the session can be replayed by the benchmark
+static InputLog input_log;
+// The two latest snapshots of the bodies, and how far between them to draw this frame
+static const Snapshot *snapshot_prev, *snapshot;
+static float snapshot_alpha;
+// When enabled the runner is paused, the bodies are simulated and drawn by `gpu` on this thread,
+// and `sim.bodies` is only brought up to date when needed (see `gpu_download`)
+static GpuSimulation gpu;
+static bool use_gpu = false;
+static size_t gpu_steps = 0;
+// Real time the GPU simulation is behind by, in seconds
+static float gpu_lag = 0;
+static BodyRenderer renderer;
+static bool use_instancing = true;
+// Frame time and time spent drawing the bodies, smoothed over the last frames
+static double frame_time = 0, bodies_draw_time = 0;
+#ifdef PROFILER
+static bool show_profile = false;
+#endif
+// Panned with the right mouse button, zoomed with the wheel around the cursor
+static Camera2D camera = {.zoom = 1};
+
+// Where the drag started, in world coordinates
 static Vector2 mouse_pressed_pos;
 static CelestialBody spawned_body;
 static Vector2 spawn_path[PATH_POINTS];
+// Simplified spawn path, as a triangle strip
+static Vector2 spawn_strip[2 * PATH_POINTS];
+static size_t spawn_strip_len = 0;
 static bool show_spawn_path = false;
+// Predicts the spawn path in the background. `drag_start` is the substep the drag started at, the
+// body would start moving after as many substeps as the simulation ran since.
+static Preview preview;
+static size_t drag_start = 0;
 
 static CelestialBody create_body(Vector2 position, Vector2 velocity, float density, float radius,
                                  Color color) {
     return (CelestialBody){
         .position = position,
-        .prev_position = position,
         .velocity = velocity,
         .radius = radius,
         .color = color,
@@ -48,71 +109,206 @@ static CelestialBody create_body(Vector2 position, Vector2 velocity, float densi
     };
 }
 
-static void integrate_pos(CelestialBody* b, float dt) {
-    // Position Verlet
-    //   a = F / m
-    //   x(t + dt) = x(t) + v(t) * dt + 0.5 * a(t) * dt^2
-    b->position = Vector2Add(Vector2Add(b->position, Vector2Scale(b->velocity, dt)),
-                             Vector2Scale(b->prev_force, dt * dt * b->inv_mass * 0.5));
+static float GetRandomUniform() {
+    return (float)GetRandomValue(0, RAND_MAX) / (float)RAND_MAX;
 }
 
-static void integrate_vel(CelestialBody* b, float dt) {
-    // Velocity Verlet
-    //   a = F / m
-    //   v(t + dt) = v(t) + 0.5 * (a(t) + a(t + dt)) * dt
-    b->velocity = Vector2Add(b->velocity, Vector2Scale(Vector2Add(b->prev_force, b->force),
-                                                       dt * 0.5 * b->inv_mass));
+// The energy drift is measured again from the next sample whenever the energy or the forces change
+static void reset_energy(Simulation* s) {
+#ifdef SIMULATION_ENERGY
+    simulation_reset_energy(s);
+#endif
 }
 
-static Vector2 compute_gravitational_force(const CelestialBody* b1, const CelestialBody* b2) {
-    // F = G * (m1 * m2 / r^2)
-    Vector2 r = Vector2Subtract(b2->position, b1->position);
-    float r2 = fmaxf(Vector2LengthSqr(r), 1e-6f);
-    r = Vector2Scale(r, 1 / sqrt(r2));
-    float m1 = 1.0f / b1->inv_mass;
-    float m2 = 1.0f / b2->inv_mass;
-    return Vector2Scale(r, G * (m1 * m2) / r2);
+// Loads the scene at `path` into the simulation, which must be locked
+static bool load_scene(Simulation* s, const char* path) {
+    InputEvent load = {.kind = INPUT_LOAD, .path = path};
+    if(!input_log_apply(&input_log, s, load, &body_memory)) return false;
+    if(use_gpu) {
+        gpu_upload(&gpu, &s->bodies);
+        gpu_steps = s->steps;
+    }
+    ext_log(INFO, "Loaded %zu bodies from %s", s->bodies.size, path);
+    return true;
 }
 
-static void apply_forces(CelestialBody* b, float dt) {
-    array_foreach(CelestialBody, o, &bodies) {
-        if(b != o) {
-            Vector2 f = compute_gravitational_force(b, o);
-            b->force = Vector2Add(b->force, f);
-        }
-    }
+// Substeps simulated so far, by whichever of the CPU or GPU is running
+static size_t current_step() {
+    return use_gpu ? gpu_steps : snapshot->step;
 }
 
-static void update(float dt) {
-    // Reset forces
-    array_foreach(CelestialBody, b, &bodies) {
-        b->prev_position = b->position;
-        b->prev_force = b->force;
-        b->force = (Vector2){0};
-    }
+// Stops the tuner from overriding a solver or theta picked by hand, which must be done with the
+// runner locked
+static void stop_tuner() {
+    if(!runner.tuner) return;
+    runner.tuner = NULL;
+    ext_log(INFO, "Tuner: off, solver picked by hand");
+}
 
-    array_foreach(CelestialBody, b, &bodies) {
-        integrate_pos(b, dt);
+static void handle_input() {
+    if(IsKeyPressed(KEY_A)) {
+        if(input_log.file) {
+            ext_log(EXT_WARNING, "Tuned solvers can't be replayed, disabled while logging");
+        } else if(runner.tuner) {
+            runner_lock(&runner);
+            stop_tuner();
+            runner_unlock(&runner);
+        } else {
+            runner_lock(&runner);
+            // Fresh trials on the next substep
+            tuner.trials = 0;
+            runner.tuner = &tuner;
+            runner_unlock(&runner);
+        }
     }
-
-    array_foreach(CelestialBody, b, &bodies) {
-        apply_forces(b, dt);
+    if(IsKeyPressed(KEY_TAB)) {
+        Simulation* s = runner_lock(&runner);
+        stop_tuner();
+        s->solver = (s->solver + 1) % SOLVER_COUNT;
+        reset_energy(s);
+        input_log_settings(&input_log, s);
+#ifndef NDEBUG
+        // Checked on a copy, so that the O(N^2) check doesn't hold up the simulation thread
+        CelestialBodies check = {0};
+        if(s->solver == SOLVER_DIRECT_SIMD) bodies_copy(&check, &s->bodies);
+#endif  // NDEBUG
+        runner_unlock(&runner);
+#ifndef NDEBUG
+        if(check.size) {
+            ext_log(INFO, "%s kernel max relative error against scalar: %g", kernel_isa,
+                    kernel_max_error(&check));
+        }
+        bodies_free(&check);
+#endif  // NDEBUG
+    }
+    if(IsKeyPressed(KEY_LEFT_BRACKET) || IsKeyPressed(KEY_RIGHT_BRACKET)) {
+        Simulation* s = runner_lock(&runner);
+        stop_tuner();
+        float delta = IsKeyPressed(KEY_LEFT_BRACKET) ? -0.1f : 0.1f;
+        s->tree.theta = Clamp(s->tree.theta + delta, 0.0f, 1.5f);
+        reset_energy(s);
+        input_log_settings(&input_log, s);
+        runner_unlock(&runner);
+    }
+    if(IsKeyPressed(KEY_G)) {
+        if(!gpu.available) {
+            ext_log(EXT_WARNING, "GPU compute solver not available");
+        } else if(input_log.file) {
+            ext_log(EXT_WARNING, "GPU compute solver can't be replayed, disabled while logging");
+        } else if(use_gpu) {
+            Simulation* s = runner_lock(&runner);
+            gpu_download(&gpu, &s->bodies);
+            reset_energy(s);
+            runner_unlock(&runner);
+            runner_pause(&runner, false);
+            use_gpu = false;
+        } else {
+            runner_pause(&runner, true);
+            Simulation* s = runner_lock(&runner);
+            gpu_upload(&gpu, &s->bodies);
+            gpu_steps = s->steps;
+            runner_unlock(&runner);
+            use_gpu = true;
+        }
+    }
+#ifdef PROFILER
+    if(IsKeyPressed(KEY_P)) {
+        show_profile = !show_profile;
+    }
+    if(IsKeyPressed(KEY_F2) && profiler_write_csv(PROFILE_PATH)) {
+        ext_log(INFO, "Saved the profile of the last %d frames to %s", PROFILE_HISTORY,
+                PROFILE_PATH);
+    }
+#endif
+    if(IsKeyPressed(KEY_I)) {
+        use_instancing = !use_instancing;
     }
+    if(IsKeyPressed(KEY_B)) {
+        Simulation* s = runner_lock(&runner);
+        s->block_steps = !s->block_steps;
+        reset_energy(s);
+        input_log_settings(&input_log, s);
+        runner_unlock(&runner);
+    }
+    if(IsKeyPressed(KEY_C)) {
+        Simulation* s = runner_lock(&runner);
+        s->merge = !s->merge;
+        input_log_settings(&input_log, s);
+        runner_unlock(&runner);
+    }
+    if(IsKeyPressed(KEY_E)) {
+        Simulation* s = runner_lock(&runner);
+        s->escape = (s->escape + 1) % ESCAPE_COUNT;
+        input_log_settings(&input_log, s);
+        runner_unlock(&runner);
+    }
+    if(IsKeyPressed(KEY_F5)) {
+        Simulation* s = runner_lock(&runner);
+        if(use_gpu) gpu_download(&gpu, &s->bodies);
+        bool started = scene_writer_save(&scene_writer, SCENE_PATH, &s->bodies, s->steps);
+        runner_unlock(&runner);
+        if(!started) ext_log(EXT_WARNING, "Still saving the previous scene");
+    }
+    if(IsKeyPressed(KEY_F9)) {
+        Simulation* s = runner_lock(&runner);
+        load_scene(s, SCENE_PATH);
+        runner_unlock(&runner);
+    }
+    if(IsKeyPressed(KEY_R)) {
+        if(recorder.active) {
+            runner_lock(&runner);
+            runner.recorder = NULL;
+            runner_unlock(&runner);
+            recorder_stop(&recorder);
+            ext_log(INFO, "Recorded %zu frames (%zu dropped) to %s", atomic_load(&recorder.frames),
+                    atomic_load(&recorder.dropped), RECORDING_PATH);
+        } else if(recorder_start(&recorder, RECORDING_PATH, RECORDING_INTERVAL, RECORDER_DELTA)) {
+            runner_lock(&runner);
+            runner.recorder = &recorder;
+            runner_unlock(&runner);
+        }
+    }
+    bool saved;
+    if(scene_writer_poll(&scene_writer, &saved) && saved) {
+        ext_log(INFO, "Saved scene to %s", SCENE_PATH);
+    }
+    if(IsKeyPressed(KEY_MINUS) && sim.pool.workers > 1) {
+        Simulation* s = runner_lock(&runner);
+        simulation_set_workers(s, s->pool.workers - 1);
+        runner_unlock(&runner);
+    }
+    if(IsKeyPressed(KEY_EQUAL) && sim.pool.workers < JOBS_MAX_WORKERS) {
+        Simulation* s = runner_lock(&runner);
+        simulation_set_workers(s, s->pool.workers + 1);
+        runner_unlock(&runner);
+    }
+}
 
-    array_foreach(CelestialBody, b, &bodies) {
-        integrate_vel(b, dt);
+static void move_camera() {
+    if(IsKeyPressed(KEY_HOME)) camera = (Camera2D){.zoom = 1};
+    if(IsMouseButtonDown(MOUSE_BUTTON_RIGHT)) {
+        camera.target = Vector2Subtract(camera.target,
+                                        Vector2Scale(GetMouseDelta(), 1 / camera.zoom));
+    }
+    float wheel = GetMouseWheelMove();
+    if(wheel != 0) {
+        // Keep the point under the cursor in place
+        Vector2 mouse = GetMousePosition();
+        camera.target = GetScreenToWorld2D(mouse, camera);
+        camera.offset = mouse;
+        camera.zoom = Clamp(camera.zoom * powf(ZOOM_STEP, wheel), ZOOM_MIN, ZOOM_MAX);
     }
 }
 
-static float GetRandomUniform() {
-    return (float)GetRandomValue(0, RAND_MAX) / (float)RAND_MAX;
+static Vector2 mouse_world() {
+    return GetScreenToWorld2D(GetMousePosition(), camera);
 }
 
 static void spawn_body() {
     if(IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
         show_spawn_path = true;
-        mouse_pressed_pos = GetMousePosition();
-        Vector2 vel = Vector2Subtract(GetMousePosition(), mouse_pressed_pos);
+        mouse_pressed_pos = mouse_world();
+        Vector2 vel = {0};
         Color col = {
             .r = GetRandomValue(0, 255),
             .g = GetRandomValue(0, 255),
@@ -122,104 +318,354 @@ static void spawn_body() {
         float density = fmax(GetRandomUniform() * 20, 1);
         float radius = fmax(GetRandomUniform() * 60, 20);
         spawned_body = create_body(mouse_pressed_pos, vel, density, radius, col);
+
+        Simulation* s = runner_lock(&runner);
+        // The path prediction runs on the CPU
+        if(use_gpu) gpu_download(&gpu, &s->bodies);
+        preview_begin(&preview, s);
+        drag_start = use_gpu ? gpu_steps : s->steps;
+        runner_unlock(&runner);
+        spawn_strip_len = 0;
     }
 
     if(IsMouseButtonReleased(MOUSE_BUTTON_LEFT)) {
         show_spawn_path = false;
-        spawned_body.velocity = Vector2Subtract(GetMousePosition(), mouse_pressed_pos);
-        array_push(&bodies, spawned_body);
+        preview_end(&preview);
+        spawned_body.velocity = Vector2Subtract(mouse_world(), mouse_pressed_pos);
+        Simulation* s = runner_lock(&runner);
+        InputEvent spawn = {.kind = INPUT_SPAWN, .body = spawned_body};
+        input_log_apply(&input_log, s, spawn, &body_memory);
+        if(use_gpu) gpu_push(&gpu, &s->bodies, s->bodies.size - 1);
+        runner_unlock(&runner);
     }
 
-    // Compute the path of the spawned body
-    if(IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
+    // Ask for the path of the spawned body, and show whatever part of it is ready. The path is
+    // only simplified when it changes.
+    if(IsMouseButtonDown(MOUSE_BUTTON_LEFT)) PROFILE(PROFILE_SPAWN_PATH) {
         CelestialBody b = spawned_body;
-        b.velocity = Vector2Subtract(GetMousePosition(), mouse_pressed_pos);
-
-        for(size_t step = 0; step < PATH_POINTS; step++) {
-            b.prev_force = b.force;
-            b.force = (Vector2){0};
-            integrate_pos(&b, sub_dt);
-            apply_forces(&b, sub_dt);
-            integrate_vel(&b, sub_dt);
-            spawn_path[step] = b.position;
+        b.velocity = Vector2Subtract(mouse_world(), mouse_pressed_pos);
+        // The latest snapshot can be older than the state the preview started from
+        size_t step = current_step();
+        preview_request(&preview, b, step > drag_start ? step - drag_start : 0);
+
+        size_t len;
+        if(preview_path(&preview, spawn_path, PATH_POINTS, &len)) {
+            // The path is in world coordinates, drawn at a constant width on screen
+            len = path_simplify(spawn_path, len, PATH_TOLERANCE / camera.zoom);
+            spawn_strip_len = path_strip(spawn_path, len, PATH_WIDTH / camera.zoom, spawn_strip);
         }
     }
 }
 
+// The energy is sampled by the simulation during its force pass, see `EnergyStats`
 static void print_energy() {
-    float ke = 0.0f;
-    array_foreach(CelestialBody, b, &bodies) {
-        float v2 = Vector2LengthSqr(b->velocity);
-        ke += (0.5f / b->inv_mass) * v2;
-    }
-
-    float pe = 0.0f;
-    for (size_t i = 0; i < bodies.size; i++) {
-        for (size_t j = i + 1; j < bodies.size; j++) {
-            Vector2 r = Vector2Subtract(bodies.items[j].position, bodies.items[i].position);
-            float r_len = Vector2Length(r);
-            float m1 = 1.0f / bodies.items[i].inv_mass;
-            float m2 = 1.0f / bodies.items[j].inv_mass;
-            pe -= G * (m1 * m2) / r_len;
-        }
+#ifdef SIMULATION_ENERGY
+    const EnergyStats* e = &snapshot->energy;
+    DrawText(TextFormat("Total Energy: %f (drift %+.2e, max %.2e)", e->total, e->drift,
+                        e->max_drift),
+             0, 30, 30, BLACK);
+    DrawText(TextFormat("Kinetic Energy: %f", e->kinetic), 0, 60, 30, BLACK);
+    DrawText(TextFormat("Potential Energy: %f", e->potential), 0, 90, 30, BLACK);
+#endif
+}
+
+static void print_solver() {
+    Solver solver = snapshot->solver;
+    const char* tuned = runner.tuner ? ", tuned" : "";
+    if(use_gpu) {
+        DrawText("Solver: GPU compute", 0, 120, 30, BLACK);
+    } else if(solver == SOLVER_BARNES_HUT) {
+        DrawText(TextFormat("Solver: %s (theta = %.1f%s)", solver_names[solver], snapshot->theta,
+                            tuned),
+                 0, 120, 30, BLACK);
+    } else if(solver == SOLVER_DIRECT_SIMD) {
+        DrawText(TextFormat("Solver: %s (%s%s)", solver_names[solver], kernel_isa, tuned), 0, 120,
+                 30, BLACK);
+    } else if(solver == SOLVER_PARTICLE_MESH || solver == SOLVER_P3M) {
+        DrawText(TextFormat("Solver: %s (%zux%zu grid%s)", solver_names[solver], sim.mesh.size,
+                            sim.mesh.size, tuned),
+                 0, 120, 30, BLACK);
+    } else {
+        DrawText(TextFormat("Solver: %s%s", solver_names[solver], runner.tuner ? " (tuned)" : ""),
+                 0, 120, 30, BLACK);
+    }
+    if(!use_gpu && INTEGRATOR == INTEGRATOR_VERLET && sim.block_steps) {
+        float active = snapshot->size ? 100.0f * snapshot->active / snapshot->size : 0;
+        DrawText(TextFormat("Threads: %zu, block steps (%.0f%% active)", sim.pool.workers, active),
+                 0, 150, 30, BLACK);
+    } else if(!use_gpu) {
+        DrawText(TextFormat("Threads: %zu, %s integrator", sim.pool.workers, integrator_name), 0,
+                 150, 30, BLACK);
+    } else {
+        DrawText(TextFormat("Threads: %zu", sim.pool.workers), 0, 150, 30, BLACK);
+    }
+}
+
+static void print_bodies() {
+    if(use_gpu) return;
+    DrawText(TextFormat("Bodies: %zu (%zu merged, %zu escaped, %s)", snapshot->size,
+                        snapshot->merged, snapshot->culled, escape_policy_names[sim.escape]),
+             0, 210, 30, BLACK);
+}
+
+static void print_frame_times() {
+    const char* path = use_gpu                                 ? "GPU buffers"
+                       : use_instancing && renderer.available ? "instanced"
+                                                               : "DrawCircleV";
+    if(use_gpu) {
+        DrawText(TextFormat("Frame: %.2f ms, bodies: %.2f ms (%s)", frame_time * 1000,
+                            bodies_draw_time * 1000, path),
+                 0, 180, 30, BLACK);
+    } else {
+        DrawText(TextFormat("Frame: %.2f ms, bodies: %.2f ms (%s, %zu drawn, %zu splats)",
+                            frame_time * 1000, bodies_draw_time * 1000, path, renderer.drawn,
+                            renderer.splats),
+                 0, 180, 30, BLACK);
     }
+    if(!use_gpu && snapshot->speed < 0.99f) {
+        DrawText(TextFormat("Simulation behind, running at %.0f%% speed", snapshot->speed * 100),
+                 0, 240, 30, RED);
+    }
+    if(recorder.active) {
+        DrawText(TextFormat("Recording: %zu frames, %zu dropped, %.1f MiB",
+                            atomic_load(&recorder.frames), atomic_load(&recorder.dropped),
+                            atomic_load(&recorder.bytes) / (1024.0 * 1024.0)),
+                 0, 270, 30, RED);
+    }
+}
 
-    DrawText(TextFormat("Total Energy: %f", ke + pe), 0, 30, 30, BLACK);
-    DrawText(TextFormat("Kinetic Energy: %f", ke), 0, 60, 30, BLACK);
-    DrawText(TextFormat("Potential Energy: %f", pe), 0, 90, 30, BLACK);
+#ifdef PROFILER
+// Milliseconds per frame spent in each phase, over the last frames
+static void print_profile() {
+    if(!show_profile) return;
+    int x = GetScreenWidth() - 720;
+    DrawText(TextFormat("%-14s %7s %7s %7s %7s", "ms", "last", "min", "avg", "p99"), x, 0, 30,
+             BLACK);
+    for(int p = 0; p < PROFILE_PHASE_COUNT; p++) {
+        ProfileStats s = profiler_stats(p);
+        DrawText(TextFormat("%-14s %7.2f %7.2f %7.2f %7.2f", profile_phase_names[p], s.last, s.min,
+                            s.avg, s.p99),
+                 x, 30 * (p + 1), 30, BLACK);
+    }
 }
+#endif
 
+// `alpha` is only used by the GPU, the CPU simulation is drawn from the snapshots
 static void draw(float alpha) {
     BeginDrawing();
 
     ClearBackground(RAYWHITE);
     DrawText(TextFormat("FPS: %d\n", GetFPS()), 0, 0, 30, BLACK);
 
-    array_foreach(CelestialBody, b, &bodies) {
-        DrawCircleV(Vector2Lerp(b->prev_position, b->position, alpha), b->radius, b->color);
+    BeginMode2D(camera);
+    double start = GetTime();
+    PROFILE(PROFILE_DRAW_BODIES) {
+        if(use_gpu) {
+            gpu_draw(&gpu, alpha);
+        } else {
+            RenderView view = render_view(camera, GetScreenWidth(), GetScreenHeight());
+            renderer_draw(&renderer, snapshot_prev, snapshot, snapshot_alpha, view,
+                          use_instancing);
+        }
     }
+    bodies_draw_time = Lerp(bodies_draw_time, GetTime() - start, 0.05f);
+    frame_time = Lerp(frame_time, GetFrameTime(), 0.05f);
 
     if(show_spawn_path) {
-        for(size_t i = 0; i < PATH_POINTS - 1; i++) {
-            DrawLineEx(spawn_path[i], spawn_path[i + 1], 4, BLUE);
+        DrawTriangleStrip(spawn_strip, spawn_strip_len, BLUE);
+    }
+    EndMode2D();
+
+    // The CPU copy of the bodies is stale while simulating on the GPU
+    PROFILE(PROFILE_PRINT_ENERGY) {
+        if(!use_gpu) print_energy();
+    }
+    print_solver();
+    print_bodies();
+    print_frame_times();
+#ifdef PROFILER
+    print_profile();
+#endif
+
+    PROFILE(PROFILE_END_DRAWING) {
+        EndDrawing();
+    }
+#ifdef PROFILER
+    profiler_frame();
+#endif
+}
+
+static void frame() {
+    snapshot_alpha = runner_snapshots(&runner, &snapshot_prev, &snapshot);
+
+    // The GPU is stepped here, with the same lag policy as the runner
+    float alpha = 0;
+    if(use_gpu) {
+        gpu_lag = fminf(gpu_lag + GetFrameTime(), RUNNER_MAX_LAG);
+        while(gpu_lag >= sub_dt) {
+            gpu_step(&gpu, sub_dt);
+            gpu_steps++;
+            gpu_lag -= sub_dt;
         }
+        alpha = gpu_lag / sub_dt;
     }
 
-    print_energy();
+    handle_input();
+    move_camera();
+    spawn_body();
+    draw(alpha);
+}
+
+static int usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [options] [SCENE]\n"
+            "  --scenario NAME  start from a generated scenario instead of SCENE: plummer, disk,\n"
+            "                   collision or uniform\n"
+            "  -n N             number of bodies of the scenario (default: 10000)\n"
+            "  --solver NAME    force solver: direct, simd, barnes-hut, pm, p3m, or auto to pick\n"
+            "                   the fastest one within the error budget (default: auto,\n"
+            "                   barnes-hut when logging)\n"
+            "  -t THREADS       worker threads, 0 for one per hardware thread (default: 0)\n"
+            "  --log PATH       log the inputs to PATH, to replay them with raylib-gravity-bench\n"
+            "  --seed SEED      seed for the scenario and the random bodies spawned\n"
+            "                   (default: random, 1 when logging or generating a scenario)\n",
+            prog);
+    return 1;
+}
+
+static bool parse_size(const char* s, size_t* out) {
+    char* end;
+    unsigned long long v = strtoull(s, &end, 10);
+    if(*s == '\0' || *end != '\0') return false;
+    *out = v;
+    return true;
+}
 
-    EndDrawing();
+// Index of `name` in `names`, or -1 if it isn't there
+static int find_name(const char* name, const char* const* names, int count) {
+    for(int i = 0; i < count; i++) {
+        if(strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
 }
 
-int main(void) {
+int main(int argc, char** argv) {
+    const char *scene_path = NULL, *log_path = NULL;
+    bool seeded = false;
+    unsigned seed = 1;
+    size_t bodies = 10000, threads = 0;
+    // -1 for the tuner's pick
+    int scenario = -1, solver = -1;
+    for(int i = 1; i < argc; i++) {
+        bool has_next = i + 1 < argc;
+        size_t value;
+        if(strcmp(argv[i], "--log") == 0 && has_next) {
+            log_path = argv[++i];
+        } else if(strcmp(argv[i], "--seed") == 0 && has_next) {
+            if(!parse_size(argv[++i], &value)) return usage(argv[0]);
+            seed = (unsigned)value;
+            seeded = true;
+        } else if(strcmp(argv[i], "--scenario") == 0 && has_next) {
+            scenario = find_name(argv[++i], scenario_names, SCENARIO_COUNT);
+            if(scenario < 0) return usage(argv[0]);
+        } else if(strcmp(argv[i], "-n") == 0 && has_next) {
+            if(!parse_size(argv[++i], &bodies)) return usage(argv[0]);
+        } else if(strcmp(argv[i], "--solver") == 0 && has_next) {
+            const char* name = argv[++i];
+            solver = find_name(name, solver_keys, SOLVER_COUNT);
+            if(solver < 0 && strcmp(name, "auto") != 0) return usage(argv[0]);
+        } else if(strcmp(argv[i], "-t") == 0 && has_next) {
+            if(!parse_size(argv[++i], &threads)) return usage(argv[0]);
+        } else if(argv[i][0] != '-' && !scene_path) {
+            scene_path = argv[i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+#ifdef EXT_EMSCRIPTEN
+    // Frames are paced by the browser
+    InitWindow(WEB_WIDTH, WEB_HEIGHT, "raylib-gravity");
+#else
     SetConfigFlags(FLAG_VSYNC_HINT | FLAG_FULLSCREEN_MODE);
     InitWindow(0, 0, "raylib [core] example - basic window");
     SetTargetFPS(GetMonitorRefreshRate(GetCurrentMonitor()));
+#endif
 
     const int width = GetScreenWidth(), height = GetScreenHeight();
 
-    bodies.allocator = &temp_allocator.base;
-    array_push(&bodies, create_body((Vector2){width / 2., height / 2.}, (Vector2){0}, 100, 100, ORANGE));
-    array_push(&bodies, create_body((Vector2){width / 2. + 500, height / 2.}, (Vector2){0, 3 * 60}, 1, 30, BLUE));
-    array_push(&bodies, create_body((Vector2){width / 2. - 500, height / 2.}, (Vector2){0, -3 * 60}, 2, 30, RED));
-    array_push(&bodies, create_body((Vector2){width / 2., height / 2. + 900}, (Vector2){3 * 60, 0}, 10, 50, GREEN));
-
-    float acc = 0;
-    while(!WindowShouldClose()) {
-        float dt = GetFrameTime();
-        acc += dt;
-
-        float alpha = 0;
-        if(dt != 0) {
-            while(acc >= sub_dt) {
-                update(sub_dt);
-                acc -= sub_dt;
-            }
-            alpha = acc / sub_dt;
+    simulation_init(&sim, threads);
+    sim.solver = solver >= 0 ? solver : SOLVER_BARNES_HUT;
+#ifdef SIMULATION_ENERGY
+    sim.energy_interval = ENERGY_INTERVAL;
+#endif
+    gpu_init(&gpu);
+    renderer_init(&renderer);
+    preview_init(&preview, PATH_POINTS, sub_dt);
+    body_memory = new_vm_allocator();
+    sim.bodies.allocator = &body_memory.base;
+    // Logged from the start, so that a replay begins with the same bodies
+    if(log_path) {
+        seeded = true;
+        if(!input_log_open(&input_log, log_path, seed, sub_dt, &sim)) return 1;
+    }
+    if(seeded) SetRandomSeed(seed);
+    // Starts from the scene given on the command line, if any, or else the scenario
+    bool loaded = scene_path && load_scene(&sim, scene_path);
+    if(!loaded && scenario >= 0) {
+        InputEvent generate = {
+            .kind = INPUT_SCENARIO,
+            .scenario = {
+                .kind = scenario,
+                .bodies = bodies,
+                .seed = seed,
+                .center = {width / 2., height / 2.},
+            },
+        };
+        input_log_apply(&input_log, &sim, generate, &body_memory);
+    } else if(!loaded) {
+        const CelestialBody initial[] = {
+            create_body((Vector2){width / 2., height / 2.}, (Vector2){0}, 100, 100, ORANGE),
+            create_body((Vector2){width / 2. + 500, height / 2.}, (Vector2){0, 3 * 60}, 1, 30, BLUE),
+            create_body((Vector2){width / 2. - 500, height / 2.}, (Vector2){0, -3 * 60}, 2, 30, RED),
+            create_body((Vector2){width / 2., height / 2. + 900}, (Vector2){3 * 60, 0}, 10, 50, GREEN),
+        };
+        for(size_t i = 0; i < EXT_ARR_SIZE(initial); i++) {
+            InputEvent spawn = {.kind = INPUT_SPAWN, .body = initial[i]};
+            input_log_apply(&input_log, &sim, spawn, &body_memory);
         }
+    }
 
-        spawn_body();
-        draw(alpha);
+    runner_init(&runner, &sim, sub_dt);
+    tuner = tuner_new();
+    if(solver < 0 && input_log.file) {
+        ext_log(INFO, "Tuned solvers can't be replayed, using %s while logging",
+                solver_names[sim.solver]);
+    } else if(solver < 0) {
+        runner_lock(&runner);
+        runner.tuner = &tuner;
+        runner_unlock(&runner);
     }
 
+#ifdef EXT_EMSCRIPTEN
+    // Browsers only present a frame once the page returns to its event loop, so frames are called
+    // back from there instead. This never returns, the simulation lasts as long as the page.
+    emscripten_set_main_loop(frame, 0, true);
+#else
+    while(!WindowShouldClose()) frame();
+#endif
+
+    runner_destroy(&runner);
+    tuner_destroy(&tuner);
+    input_log_close(&input_log, &sim);
+    recorder_stop(&recorder);
+    scene_writer_destroy(&scene_writer);
+    preview_destroy(&preview);
+    renderer_destroy(&renderer);
+    gpu_destroy(&gpu);
+    vm_log_usage(&body_memory, INFO, "Body storage");
+    arena_pool_log_stats(&sim.pool.scratch, INFO, "Job scratch");
+    simulation_destroy(&sim);
+    vm_destroy(&body_memory);
     CloseWindow();
 }
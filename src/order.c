@@ -0,0 +1,160 @@
+#include "order.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "extlib.h"
+#include "raymath.h"
+
+// Resolution of the Morton grid, in bits per axis
+#define ORDER_BITS (16)
+
+// Any element of the arrays of the bodies, to size the gather buffer
+typedef union {
+#define X(T, name) T name;
+    CELESTIAL_BODIES_FIELDS(X)
+#undef X
+} BodyField;
+
+// Moves the low ORDER_BITS bits of `x` to the even bits
+static uint32_t interleave(uint32_t x) {
+    x = (x | (x << 8)) & 0x00ff00ffu;
+    x = (x | (x << 4)) & 0x0f0f0f0fu;
+    x = (x | (x << 2)) & 0x33333333u;
+    x = (x | (x << 1)) & 0x55555555u;
+    return x;
+}
+
+// Previous content doesn't need to be preserved
+static void reserve(SpatialOrder* o, size_t n) {
+    if(o->capacity >= n) return;
+    size_t newcap = o->capacity ? o->capacity : 256;
+    while(newcap < n) newcap *= 2;
+    spatial_order_destroy(o);
+    o->codes = ext_alloc(sizeof(uint32_t) * newcap);
+    o->indices = ext_alloc(sizeof(uint32_t) * newcap);
+    o->codes_tmp = ext_alloc(sizeof(uint32_t) * newcap);
+    o->indices_tmp = ext_alloc(sizeof(uint32_t) * newcap);
+    o->gather = ext_alloc(sizeof(BodyField) * newcap);
+    o->capacity = newcap;
+}
+
+// Codes of the bodies on a grid over those within the clipping square, the others being clamped to
+// its edges
+static void morton_codes(SpatialOrder* o, const CelestialBodies* b) {
+    size_t n = b->size;
+    double mx = 0, my = 0, r2 = 0;
+    for(size_t i = 0; i < n; i++) {
+        mx += b->position[i].x;
+        my += b->position[i].y;
+    }
+    mx /= n;
+    my /= n;
+    for(size_t i = 0; i < n; i++) {
+        double dx = b->position[i].x - mx, dy = b->position[i].y - my;
+        r2 += dx * dx + dy * dy;
+    }
+    float clip = ORDER_CLIP * (float)sqrt(r2 / n);
+    Vector2 min = {(float)mx - clip, (float)my - clip}, max = {(float)mx + clip, (float)my + clip};
+
+    Vector2 lo = max, hi = min;
+    for(size_t i = 0; i < n; i++) {
+        Vector2 p = {Clamp(b->position[i].x, min.x, max.x), Clamp(b->position[i].y, min.y, max.y)};
+        lo = (Vector2){fminf(lo.x, p.x), fminf(lo.y, p.y)};
+        hi = (Vector2){fmaxf(hi.x, p.x), fmaxf(hi.y, p.y)};
+    }
+    float side = fmaxf(hi.x - lo.x, hi.y - lo.y);
+    float scale = side > 0 ? ((1u << ORDER_BITS) - 1) / side : 0;
+    for(size_t i = 0; i < n; i++) {
+        Vector2 p = b->position[i];
+        uint32_t x = (uint32_t)Clamp((p.x - lo.x) * scale, 0, (1u << ORDER_BITS) - 1);
+        uint32_t y = (uint32_t)Clamp((p.y - lo.y) * scale, 0, (1u << ORDER_BITS) - 1);
+        o->codes[i] = interleave(x) | interleave(y) << 1;
+        o->indices[i] = i;
+    }
+}
+
+// Least significant digit first radix sort of the codes along with the indices, a byte at a time,
+// skipping the bytes all codes share
+static void radix_sort(SpatialOrder* o, size_t n) {
+    for(int shift = 0; shift < 2 * ORDER_BITS; shift += 8) {
+        size_t offsets[256] = {0};
+        for(size_t i = 0; i < n; i++) offsets[(o->codes[i] >> shift) & 0xff]++;
+        if(offsets[(o->codes[0] >> shift) & 0xff] == n) continue;
+
+        for(size_t d = 0, sum = 0; d < 256; d++) {
+            size_t count = offsets[d];
+            offsets[d] = sum;
+            sum += count;
+        }
+        for(size_t i = 0; i < n; i++) {
+            size_t k = offsets[(o->codes[i] >> shift) & 0xff]++;
+            o->codes_tmp[k] = o->codes[i];
+            o->indices_tmp[k] = o->indices[i];
+        }
+
+        uint32_t* t = o->codes;
+        o->codes = o->codes_tmp;
+        o->codes_tmp = t;
+        t = o->indices;
+        o->indices = o->indices_tmp;
+        o->indices_tmp = t;
+    }
+}
+
+float bodies_spread(const CelestialBodies* b) {
+    if(b->size < 2) return 0;
+    double sum = 0;
+    for(size_t i = 1; i < b->size; i++) {
+        sum += Vector2Distance(b->position[i - 1], b->position[i]);
+    }
+    return (float)(sum / (b->size - 1));
+}
+
+bool spatial_order_update(SpatialOrder* o, CelestialBodies* b, size_t step) {
+    if(b->size < 2 || step % ORDER_CHECK_INTERVAL) return false;
+    bool due = step - o->sorted_step >= ORDER_MAX_INTERVAL ||
+               bodies_spread(b) > ORDER_DEGRADATION * o->sorted_spread;
+    return due && spatial_order_sort(o, b, step);
+}
+
+bool spatial_order_sort(SpatialOrder* o, CelestialBodies* b, size_t step) {
+    size_t n = b->size;
+    o->sorted_step = step;
+    o->sorted_spread = 0;
+    if(n < 2) return false;
+
+    reserve(o, n);
+    morton_codes(o, b);
+    radix_sort(o, n);
+
+    size_t first = 0;
+    while(first < n && o->indices[first] == first) first++;
+    if(first < n) {
+        // Bodies before `first` are already in place
+#define X(T, name)                                                                \
+    {                                                                             \
+        T* sorted = o->gather;                                                    \
+        for(size_t i = first; i < n; i++) sorted[i] = b->name[o->indices[i]];     \
+        memcpy(b->name + first, sorted + first, sizeof(T) * (n - first));         \
+    }
+        CELESTIAL_BODIES_FIELDS(X)
+#undef X
+        o->sorts++;
+    }
+    o->sorted_spread = bodies_spread(b);
+    return first < n;
+}
+
+void spatial_order_destroy(SpatialOrder* o) {
+    if(o->capacity) {
+        ext_free(o->codes, sizeof(uint32_t) * o->capacity);
+        ext_free(o->indices, sizeof(uint32_t) * o->capacity);
+        ext_free(o->codes_tmp, sizeof(uint32_t) * o->capacity);
+        ext_free(o->indices_tmp, sizeof(uint32_t) * o->capacity);
+        ext_free(o->gather, sizeof(BodyField) * o->capacity);
+    }
+    o->codes = o->indices = o->codes_tmp = o->indices_tmp = NULL;
+    o->gather = NULL;
+    o->capacity = 0;
+}
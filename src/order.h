@@ -0,0 +1,64 @@
+#ifndef ORDER_H
+#define ORDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "body.h"
+
+// Spatial ordering of the bodies, so that bodies close to each other are also close in memory.
+// Spawned bodies are appended and bodies drift apart, so left alone their order soon has nothing to
+// do with where they are, and tree traversals, the collision broadphase and every chunked job end
+// up touching memory all over the place. Bodies are sorted along a Morton (Z-order) curve instead,
+// with a radix sort of their codes, whenever the mean distance between consecutive bodies grew by
+// ORDER_DEGRADATION since the last sort, or at least every ORDER_MAX_INTERVAL substeps.
+// Sorting moves bodies to other indices, so anything referring to a body across substeps should
+// hold on to its identifier (see `CelestialBodies.id`).
+//
+// USAGE
+// ```c
+// SpatialOrder order = {0};
+// // after every substep
+// if(spatial_order_update(&order, &bodies, step)) {
+//     // the bodies moved
+// }
+// spatial_order_destroy(&order);
+// ```
+
+// Substeps between checks of the order, and at most between sorts
+#define ORDER_CHECK_INTERVAL (16)
+#define ORDER_MAX_INTERVAL   (512)
+// Growth of the mean distance between consecutive bodies since the last sort triggering a new one
+#define ORDER_DEGRADATION (2.0f)
+// Extent of the Morton grid around the mean position of the bodies, in RMS distances from it, so
+// that a few bodies flung far away don't squeeze all the others into a handful of cells
+#define ORDER_CLIP (8.0f)
+
+typedef struct {
+    // Sorts done so far
+    size_t sorts;
+
+    // Private fields
+    // Substep of the last sort, and the mean distance between consecutive bodies right after it
+    size_t sorted_step;
+    float sorted_spread;
+    // Morton codes and body indices, and the radix sort's other half of both
+    uint32_t *codes, *indices, *codes_tmp, *indices_tmp;
+    // Where the arrays of the bodies are gathered in their new order
+    void* gather;
+    size_t capacity;
+} SpatialOrder;
+
+// Mean distance between consecutive bodies
+float bodies_spread(const CelestialBodies* b);
+// Sorts the bodies along a Morton curve if it's due at substep `step`. Returns whether any body
+// moved.
+bool spatial_order_update(SpatialOrder* o, CelestialBodies* b, size_t step);
+// Sorts the bodies along a Morton curve at substep `step`. Bodies with the same code keep their
+// relative order. Returns whether any body moved.
+bool spatial_order_sort(SpatialOrder* o, CelestialBodies* b, size_t step);
+// Frees all memory associated with the ordering
+void spatial_order_destroy(SpatialOrder* o);
+
+#endif
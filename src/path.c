@@ -0,0 +1,93 @@
+#include "path.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "extlib.h"
+#include "raymath.h"
+
+// Miters get clamped to this many times half the line width, so that sharp turns don't spike
+#define MITER_LIMIT (2.0f)
+
+// Squared distance of `p` from the segment [a, b]
+static float segment_distance_sqr(Vector2 p, Vector2 a, Vector2 b) {
+    Vector2 ab = Vector2Subtract(b, a);
+    float len2 = Vector2LengthSqr(ab);
+    float t = len2 > 0 ? Clamp(Vector2DotProduct(Vector2Subtract(p, a), ab) / len2, 0, 1) : 0;
+    return Vector2DistanceSqr(p, Vector2Add(a, Vector2Scale(ab, t)));
+}
+
+size_t path_simplify(Vector2* points, size_t count, float tolerance) {
+    if(count < 3) return count;
+
+    // Iterative version, with an explicit stack of ranges still to be simplified
+    typedef struct {
+        size_t first, last;
+    } Range;
+    bool* keep = ext_alloc(sizeof(bool) * count);
+    Range* stack = ext_alloc(sizeof(Range) * count);
+    for(size_t i = 0; i < count; i++) keep[i] = false;
+    keep[0] = keep[count - 1] = true;
+
+    const float tolerance2 = tolerance * tolerance;
+    size_t top = 0;
+    stack[top++] = (Range){0, count - 1};
+    while(top) {
+        Range r = stack[--top];
+        float max_dist = 0;
+        size_t farthest = r.first;
+        for(size_t i = r.first + 1; i < r.last; i++) {
+            float d = segment_distance_sqr(points[i], points[r.first], points[r.last]);
+            if(d > max_dist) {
+                max_dist = d;
+                farthest = i;
+            }
+        }
+        if(max_dist > tolerance2) {
+            keep[farthest] = true;
+            // Each range splits into two strictly smaller ones, so the stack never exceeds `count`
+            if(farthest - r.first > 1) stack[top++] = (Range){r.first, farthest};
+            if(r.last - farthest > 1) stack[top++] = (Range){farthest, r.last};
+        }
+    }
+
+    size_t kept = 0;
+    for(size_t i = 0; i < count; i++) {
+        if(keep[i]) points[kept++] = points[i];
+    }
+
+    ext_free(stack, sizeof(Range) * count);
+    ext_free(keep, sizeof(bool) * count);
+    return kept;
+}
+
+static Vector2 segment_normal(Vector2 a, Vector2 b) {
+    Vector2 d = Vector2Normalize(Vector2Subtract(b, a));
+    return (Vector2){d.y, -d.x};
+}
+
+size_t path_strip(const Vector2* points, size_t count, float width, Vector2* out) {
+    if(count < 2) return 0;
+
+    float half_width = width * 0.5f;
+    for(size_t i = 0; i < count; i++) {
+        Vector2 offset;
+        if(i == 0) {
+            offset = Vector2Scale(segment_normal(points[0], points[1]), half_width);
+        } else if(i == count - 1) {
+            offset = Vector2Scale(segment_normal(points[i - 1], points[i]), half_width);
+        } else {
+            // Miter: along the average normal, long enough to keep the width on both segments
+            Vector2 n0 = segment_normal(points[i - 1], points[i]);
+            Vector2 n1 = segment_normal(points[i], points[i + 1]);
+            Vector2 miter = Vector2Normalize(Vector2Add(n0, n1));
+            float cos_half = Vector2DotProduct(miter, n1);
+            float len = cos_half > 1 / MITER_LIMIT ? half_width / cos_half : half_width * MITER_LIMIT;
+            offset = Vector2Scale(miter, len);
+        }
+        // Left then right of the direction of travel, the winding raylib expects for strips
+        out[2 * i] = Vector2Add(points[i], offset);
+        out[2 * i + 1] = Vector2Subtract(points[i], offset);
+    }
+    return 2 * count;
+}
@@ -0,0 +1,18 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include <stddef.h>
+
+#include "raylib.h"
+
+// Polyline helpers for drawing long paths cheaply: simplification down to a given tolerance, and
+// conversion to a single triangle strip that can be submitted with one `DrawTriangleStrip`.
+
+// Simplifies the polyline in place with the Douglas-Peucker algorithm, so that no removed point is
+// farther than `tolerance` from the simplified line. Returns the new number of points.
+size_t path_simplify(Vector2* points, size_t count, float tolerance);
+// Builds a triangle strip of `2 * count` vertices into `out` covering the polyline with a line of
+// the given `width`, mitered at the joints
+size_t path_strip(const Vector2* points, size_t count, float width, Vector2* out);
+
+#endif
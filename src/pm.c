@@ -0,0 +1,481 @@
+#include "pm.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "extlib.h"
+#include "raymath.h"
+
+// Empty nodes kept around the bodies, so that the interpolation and the finite differences of the
+// gradient stay within the grid
+#define PM_MARGIN (3)
+// Rows or columns of the grid per FFT job
+#define PM_FFT_CHUNK (8)
+// Least bodies per deposit job. Otherwise bodies are split in one chunk per worker, each with a
+// grid of its own, so that there are never more grids to sum up than workers.
+#define PM_DEPOSIT_MIN_CHUNK (1024)
+// Masses are deposited in fixed point, in units of the total mass on the grid over 2^PM_MASS_BITS
+#define PM_MASS_BITS (62)
+
+typedef struct {
+    ParticleMesh* pm;
+    const CelestialBodies* bodies;
+    JobPool* pool;
+    size_t chunk;
+} DepositJob;
+
+// Also accumulates the potential energy into `u` if not NULL
+static Vector2 point_force(Vector2 p1, float m1, Vector2 p2, float m2, float* u) {
+    // F = G * (m1 * m2 / r^2), U = -G * (m1 * m2 / r)
+    Vector2 r = Vector2Subtract(p2, p1);
+    float r2 = fmaxf(Vector2LengthSqr(r), 1e-6f);
+    if(u) *u -= G * (m1 * m2) / sqrtf(r2);
+    return Vector2Scale(r, G * (m1 * m2) / (r2 * sqrtf(r2)));
+}
+
+// Long-range potential per unit mass at `r` cells from a unit mass, with cells of unit size
+static double long_range(double r) {
+    double rs = PM_SPLIT;
+    // The limit of erf(r / 2r_s) / r at 0
+    if(r == 0) return -G / (rs * sqrt(PI));
+    return -G * erf(r / (2 * rs)) / r;
+}
+
+// In-place radix-2 FFT of the `n` values of `a`, `n` being the size of the padded grid
+static void fft(PmComplex* a, size_t n, const PmComplex* twiddles, const uint32_t* reverse,
+                bool inverse) {
+    for(size_t i = 0; i < n; i++) {
+        size_t j = reverse[i];
+        if(i < j) {
+            PmComplex t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+    }
+    float sign = inverse ? -1 : 1;
+    for(size_t len = 2; len <= n; len *= 2) {
+        size_t half = len / 2, stride = n / len;
+        for(size_t start = 0; start < n; start += len) {
+            for(size_t k = 0; k < half; k++) {
+                PmComplex w = twiddles[k * stride];
+                w.im *= sign;
+                PmComplex* u = &a[start + k];
+                PmComplex* v = &a[start + k + half];
+                PmComplex t = {v->re * w.re - v->im * w.im, v->re * w.im + v->im * w.re};
+                *v = (PmComplex){u->re - t.re, u->im - t.im};
+                *u = (PmComplex){u->re + t.re, u->im + t.im};
+            }
+        }
+    }
+}
+
+// Transforms the whole padded grid `a`, rows then columns
+static void fft2(ParticleMesh* pm, PmComplex* a) {
+    size_t n = 2 * pm->size;
+    PmComplex column[2 * PM_MAX_SIZE];
+    for(size_t y = 0; y < n; y++) fft(a + y * n, n, pm->twiddles, pm->reverse, false);
+    for(size_t x = 0; x < n; x++) {
+        for(size_t y = 0; y < n; y++) column[y] = a[y * n + x];
+        fft(column, n, pm->twiddles, pm->reverse, false);
+        for(size_t y = 0; y < n; y++) a[y * n + x] = column[y];
+    }
+}
+
+// Cloud-in-cell weights of the window of a node, squared for deposit then interpolation
+static double cic_window(size_t k, size_t n) {
+    double x = PI * (double)k / n;
+    double s = k ? sin(x) / x : 1;
+    return s * s * s * s;
+}
+
+// Allocates the grids and computes the transform of the kernel, once
+static void init_grids(ParticleMesh* pm) {
+    size_t size = pm->size, n = 2 * size;
+    EXT_ASSERT(size >= 4 * PM_MARGIN && size <= PM_MAX_SIZE && (size & (size - 1)) == 0,
+               "particle mesh size must be a power of 2 up to PM_MAX_SIZE");
+    pm->work = ext_alloc(sizeof(PmComplex) * n * n);
+    pm->kernel = ext_alloc(sizeof(float) * n * n);
+    pm->twiddles = ext_alloc(sizeof(PmComplex) * n / 2);
+    pm->reverse = ext_alloc(sizeof(uint32_t) * n);
+    pm->potential = ext_alloc(sizeof(float) * size * size);
+    pm->accel = ext_alloc(sizeof(Vector2) * size * size);
+    pm->chain_cells = (size_t)ceilf(PM_CUTOFF * PM_SPLIT);
+    pm->chain_size = (size + pm->chain_cells - 1) / pm->chain_cells;
+    pm->chain_start = ext_alloc(sizeof(uint32_t) * (pm->chain_size * pm->chain_size + 1));
+
+    int bits = 0;
+    while(((size_t)1 << bits) < n) bits++;
+    for(size_t i = 0; i < n; i++) {
+        uint32_t r = 0;
+        for(int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+        pm->reverse[i] = r;
+    }
+    for(size_t k = 0; k < n / 2; k++) {
+        double angle = -2 * PI * (double)k / n;
+        pm->twiddles[k] = (PmComplex){(float)cos(angle), (float)sin(angle)};
+    }
+
+    // Kernel at unit cell size, wrapping around so that node (x, y) holds the potential at
+    // separation (x, y) or (x - n, y - n). Separations only go up to size - 1, so the other half of
+    // the padding is never used.
+    for(size_t y = 0; y < n; y++) {
+        for(size_t x = 0; x < n; x++) {
+            double dx = x < size ? (double)x : (double)x - n;
+            double dy = y < size ? (double)y : (double)y - n;
+            pm->work[y * n + x] = (PmComplex){(float)long_range(sqrt(dx * dx + dy * dy)), 0};
+        }
+    }
+    fft2(pm, pm->work);
+    // The kernel is even, so its transform is real. Deconvolving the smoothing of the deposit and
+    // the interpolation, and normalizing the inverse transform, are folded into it.
+    for(size_t y = 0; y < n; y++) {
+        for(size_t x = 0; x < n; x++) {
+            double w = cic_window(x < size ? x : n - x, n) * cic_window(y < size ? y : n - y, n);
+            pm->kernel[y * n + x] = (float)(pm->work[y * n + x].re / (w * n * n));
+        }
+    }
+
+    // The potential between two nodes as the mesh actually sees it is the inverse transform of the
+    // kernel, the same as its forward transform as the kernel is real and even
+    for(size_t i = 0; i < n * n; i++) pm->work[i] = (PmComplex){pm->kernel[i], 0};
+    fft2(pm, pm->work);
+    pm->self_kernel[0] = pm->work[0].re;
+    pm->self_kernel[1] = pm->work[1].re;
+    pm->self_kernel[2] = pm->work[n + 1].re;
+    // The padding rows stay zero from here on: the columns pass is the only one reading them, and
+    // it only writes back the rows of the unpadded grid
+    memset(pm->work, 0, sizeof(PmComplex) * n * n);
+}
+
+static void reserve_bodies(ParticleMesh* pm, size_t count) {
+    if(count <= pm->capacity) return;
+    size_t newcap = pm->capacity ? pm->capacity : 1024;
+    while(newcap < count) newcap *= 2;
+    if(pm->capacity) {
+        ext_free(pm->outside, sizeof(uint32_t) * pm->capacity);
+        ext_free(pm->chain_cell, sizeof(uint32_t) * pm->capacity);
+        ext_free(pm->sorted_index, sizeof(uint32_t) * pm->capacity);
+        ext_free(pm->sorted_position, sizeof(Vector2) * pm->capacity);
+        ext_free(pm->sorted_mass, sizeof(float) * pm->capacity);
+    }
+    pm->outside = ext_alloc(sizeof(uint32_t) * newcap);
+    pm->chain_cell = ext_alloc(sizeof(uint32_t) * newcap);
+    pm->sorted_index = ext_alloc(sizeof(uint32_t) * newcap);
+    pm->sorted_position = ext_alloc(sizeof(Vector2) * newcap);
+    pm->sorted_mass = ext_alloc(sizeof(float) * newcap);
+    pm->capacity = newcap;
+}
+
+static inline bool on_grid(const ParticleMesh* pm, Vector2 p) {
+    return p.x >= pm->lo.x && p.x <= pm->hi.x && p.y >= pm->lo.y && p.y <= pm->hi.y;
+}
+
+// Grid coordinates of a world position
+static inline Vector2 grid_coords(const ParticleMesh* pm, Vector2 p) {
+    return Vector2Scale(Vector2Subtract(p, pm->origin), 1 / pm->cell);
+}
+
+// Lower node of the cloud-in-cell stencil of `u`, clamped to the grid, and the weight of the upper
+static inline size_t cic_node(float u, size_t size, float* frac) {
+    float f = floorf(u);
+    f = Clamp(f, PM_MARGIN - 1, (float)(size - PM_MARGIN));
+    *frac = Clamp(u - f, 0, 1);
+    return (size_t)f;
+}
+
+// Deposits a chunk of bodies onto a grid of its own, left to `rows_forward_job` to sum up. Chunks
+// depend on the number of workers, but masses are summed in fixed point, so the sums don't.
+static void deposit_job(void* ctx, size_t start, size_t end) {
+    const DepositJob* job = ctx;
+    const ParticleMesh* pm = job->pm;
+    const CelestialBodies* b = job->bodies;
+    size_t size = pm->size;
+    double scale = pm->mass_unit > 0 ? 1 / pm->mass_unit : 0;
+    int64_t* grid = jobs_scratch(job->pool, sizeof(int64_t) * size * size);
+    memset(grid, 0, sizeof(int64_t) * size * size);
+    for(size_t i = start; i < end; i++) {
+        if(!on_grid(pm, b->position[i])) continue;
+        Vector2 u = grid_coords(pm, b->position[i]);
+        float fx, fy;
+        size_t x = cic_node(u.x, size, &fx), y = cic_node(u.y, size, &fy);
+        double m = b->mass[i] * scale;
+        grid[y * size + x] += llround(m * (1 - fx) * (1 - fy));
+        grid[y * size + x + 1] += llround(m * fx * (1 - fy));
+        grid[(y + 1) * size + x] += llround(m * (1 - fx) * fy);
+        grid[(y + 1) * size + x + 1] += llround(m * fx * fy);
+    }
+    pm->partial[start / job->chunk] = grid;
+}
+
+// Sum of the deposits and forward transform of the rows holding masses, the others being all zero
+static void rows_forward_job(void* ctx, size_t start, size_t end) {
+    ParticleMesh* pm = ctx;
+    size_t size = pm->size, n = 2 * size;
+    for(size_t y = start; y < end; y++) {
+        PmComplex* row = pm->work + y * n;
+        for(size_t x = 0; x < size; x++) {
+            int64_t m = 0;
+            for(size_t c = 0; c < pm->partials; c++) m += pm->partial[c][y * size + x];
+            row[x] = (PmComplex){(float)(m * pm->mass_unit), 0};
+        }
+        memset(row + size, 0, sizeof(PmComplex) * size);
+        fft(row, n, pm->twiddles, pm->reverse, false);
+    }
+}
+
+// Forward transform of each column, product with the kernel, and inverse transform, keeping only
+// the rows of the unpadded grid
+static void columns_job(void* ctx, size_t start, size_t end) {
+    ParticleMesh* pm = ctx;
+    size_t size = pm->size, n = 2 * size;
+    PmComplex column[2 * PM_MAX_SIZE];
+    for(size_t x = start; x < end; x++) {
+        for(size_t y = 0; y < n; y++) column[y] = pm->work[y * n + x];
+        fft(column, n, pm->twiddles, pm->reverse, false);
+        // The kernel is isotropic, so symmetric, and column x of it is also row x
+        const float* k = pm->kernel + x * n;
+        for(size_t y = 0; y < n; y++) {
+            column[y].re *= k[y];
+            column[y].im *= k[y];
+        }
+        fft(column, n, pm->twiddles, pm->reverse, true);
+        for(size_t y = 0; y < size; y++) pm->work[y * n + x] = column[y];
+    }
+}
+
+// Inverse transform of the rows of the unpadded grid, into the potential
+static void rows_inverse_job(void* ctx, size_t start, size_t end) {
+    ParticleMesh* pm = ctx;
+    size_t size = pm->size, n = 2 * size;
+    // The kernel was computed at unit cell size, and scales as 1 / r
+    float scale = 1 / pm->cell;
+    for(size_t y = start; y < end; y++) {
+        PmComplex* row = pm->work + y * n;
+        fft(row, n, pm->twiddles, pm->reverse, true);
+        for(size_t x = 0; x < size; x++) pm->potential[y * size + x] = row[x].re * scale;
+    }
+}
+
+// Acceleration at the nodes, by fourth order central differences of the potential
+static void gradient_job(void* ctx, size_t start, size_t end) {
+    ParticleMesh* pm = ctx;
+    size_t size = pm->size;
+    const float* phi = pm->potential;
+    float scale = -1 / (12 * pm->cell);
+    for(size_t y = start; y < end; y++) {
+        Vector2* row = pm->accel + y * size;
+        if(y < 2 || y + 2 >= size) {
+            memset(row, 0, sizeof(Vector2) * size);
+            continue;
+        }
+        row[0] = row[1] = row[size - 2] = row[size - 1] = (Vector2){0};
+        for(size_t x = 2; x + 2 < size; x++) {
+            size_t i = y * size + x;
+            float dx = 8 * (phi[i + 1] - phi[i - 1]) - (phi[i + 2] - phi[i - 2]);
+            float dy = 8 * (phi[i + size] - phi[i - size]) - (phi[i + 2 * size] - phi[i - 2 * size]);
+            row[x] = (Vector2){dx * scale, dy * scale};
+        }
+    }
+}
+
+// Counting sort of the bodies by chain cell
+static void sort_chain(ParticleMesh* pm, const CelestialBodies* b) {
+    size_t cells = pm->chain_size * pm->chain_size;
+    float width = pm->chain_cells * pm->cell;
+    memset(pm->chain_start, 0, sizeof(uint32_t) * (cells + 1));
+    for(size_t i = 0; i < b->size; i++) {
+        if(!on_grid(pm, b->position[i])) continue;
+        Vector2 p = Vector2Subtract(b->position[i], pm->origin);
+        size_t x = (size_t)Clamp(p.x / width, 0, pm->chain_size - 1);
+        size_t y = (size_t)Clamp(p.y / width, 0, pm->chain_size - 1);
+        pm->chain_cell[i] = y * pm->chain_size + x;
+        pm->chain_start[pm->chain_cell[i] + 1]++;
+    }
+    for(size_t c = 0; c < cells; c++) pm->chain_start[c + 1] += pm->chain_start[c];
+    // Filled from the back of each cell, which keeps the bodies in index order within cells
+    for(size_t i = b->size; i-- > 0;) {
+        if(!on_grid(pm, b->position[i])) continue;
+        uint32_t k = --pm->chain_start[pm->chain_cell[i] + 1];
+        pm->sorted_index[k] = i;
+        pm->sorted_position[k] = b->position[i];
+        pm->sorted_mass[k] = b->mass[i];
+    }
+    // Every end got moved back to its start, shift them back into place
+    memmove(pm->chain_start, pm->chain_start + 1, sizeof(uint32_t) * cells);
+    pm->chain_start[cells] = b->size - pm->outside_count;
+}
+
+void pm_build(ParticleMesh* pm, const CelestialBodies* bodies, JobPool* pool) {
+    if(!pm->work) init_grids(pm);
+    if(!bodies->size) return;
+
+    reserve_bodies(pm, bodies->size);
+
+    // Mean position and RMS distance from it
+    double mx = 0, my = 0, r2 = 0;
+    for(size_t i = 0; i < bodies->size; i++) {
+        mx += bodies->position[i].x;
+        my += bodies->position[i].y;
+    }
+    mx /= bodies->size;
+    my /= bodies->size;
+    for(size_t i = 0; i < bodies->size; i++) {
+        double dx = bodies->position[i].x - mx, dy = bodies->position[i].y - my;
+        r2 += dx * dx + dy * dy;
+    }
+    float clip = PM_CLIP * (float)sqrt(r2 / bodies->size);
+
+    // Bounds of the bodies within the clipping square, and the others
+    pm->lo = (Vector2){(float)mx - clip, (float)my - clip};
+    pm->hi = (Vector2){(float)mx + clip, (float)my + clip};
+    Vector2 lo = {FLT_MAX, FLT_MAX}, hi = {-FLT_MAX, -FLT_MAX};
+    double mass = 0;
+    pm->outside_count = 0;
+    for(size_t i = 0; i < bodies->size; i++) {
+        Vector2 p = bodies->position[i];
+        if(!on_grid(pm, p)) {
+            pm->outside[pm->outside_count++] = i;
+            continue;
+        }
+        lo = (Vector2){fminf(lo.x, p.x), fminf(lo.y, p.y)};
+        hi = (Vector2){fmaxf(hi.x, p.x), fmaxf(hi.y, p.y)};
+        mass += bodies->mass[i];
+    }
+    pm->lo = lo;
+    pm->hi = hi;
+    // Rounding adds at most 2 units per body to the total, far from overflowing
+    pm->mass_unit = ldexp(mass, -PM_MASS_BITS);
+    size_t size = pm->size;
+    float side = fmaxf(fmaxf(hi.x - lo.x, hi.y - lo.y), 1);
+    pm->cell = side / (size - 2 * PM_MARGIN - 1);
+    pm->origin = (Vector2){lo.x - PM_MARGIN * pm->cell, lo.y - PM_MARGIN * pm->cell};
+
+    DepositJob deposit = {pm, bodies, pool, (bodies->size + pool->workers - 1) / pool->workers};
+    if(deposit.chunk < PM_DEPOSIT_MIN_CHUNK) deposit.chunk = PM_DEPOSIT_MIN_CHUNK;
+    pm->partials = (bodies->size + deposit.chunk - 1) / deposit.chunk;
+    pm->partial = jobs_scratch(pool, sizeof(int64_t*) * pm->partials);
+    jobs_parallel_for(pool, bodies->size, deposit.chunk, deposit_job, &deposit);
+    jobs_parallel_for(pool, size, PM_FFT_CHUNK, rows_forward_job, pm);
+    jobs_parallel_for(pool, 2 * size, PM_FFT_CHUNK, columns_job, pm);
+    jobs_parallel_for(pool, size, PM_FFT_CHUNK, rows_inverse_job, pm);
+    jobs_parallel_for(pool, size, PM_FFT_CHUNK, gradient_job, pm);
+    if(pm->short_range) sort_chain(pm, bodies);
+}
+
+// Potential per unit mass squared, at unit cell size, of a body on its own cloud of weights `w`
+// over the nodes (0, 0), (1, 0), (0, 1) and (1, 1) of its stencil. The mesh can't tell the body's
+// own mass from the others, so this is what it adds to its potential, depending on where the body
+// sits within its cell.
+static double self_potential(const ParticleMesh* pm, const float w[4]) {
+    double u = 0;
+    for(int p = 0; p < 4; p++) {
+        for(int q = 0; q < 4; q++) {
+            // Nodes differing along both axes are a diagonal apart
+            int apart = ((p ^ q) & 1) + ((p ^ q) >> 1);
+            u += (double)w[p] * w[q] * pm->self_kernel[apart];
+        }
+    }
+    return u;
+}
+
+// Exact force minus that of the mesh, from the bodies of the chaining mesh around body `i`
+static Vector2 short_range_force(const ParticleMesh* pm, size_t i, Vector2 pos, float m,
+                                 float* u) {
+    float rs = PM_SPLIT * pm->cell, cutoff = PM_CUTOFF * rs;
+    size_t c = pm->chain_cell[i], cx = c % pm->chain_size, cy = c / pm->chain_size;
+    size_t x0 = cx ? cx - 1 : 0, x1 = cx + 1 < pm->chain_size ? cx + 1 : cx;
+    size_t y0 = cy ? cy - 1 : 0, y1 = cy + 1 < pm->chain_size ? cy + 1 : cy;
+
+    Vector2 force = {0};
+    for(size_t y = y0; y <= y1; y++) {
+        // Cells of a row are contiguous in the sorted bodies
+        uint32_t start = pm->chain_start[y * pm->chain_size + x0];
+        uint32_t end = pm->chain_start[y * pm->chain_size + x1 + 1];
+        for(uint32_t k = start; k < end; k++) {
+            Vector2 r = Vector2Subtract(pm->sorted_position[k], pos);
+            float r2 = fmaxf(Vector2LengthSqr(r), 1e-6f);
+            if(r2 >= cutoff * cutoff || pm->sorted_index[k] == i) continue;
+            // F = G * (m1 * m2 / r^2) * (erfc(x) + 2x / sqrt(pi) * exp(-x^2)) with x = r / 2r_s
+            float d = sqrtf(r2), x = d / (2 * rs), gm = G * m * pm->sorted_mass[k];
+            float shape = erfcf(x) + 2 * x / sqrtf(PI) * expf(-x * x);
+            force = Vector2Add(force, Vector2Scale(r, gm * shape / (r2 * d)));
+            if(u) *u -= gm * erfcf(x) / d;
+        }
+    }
+    return force;
+}
+
+Vector2 pm_force(const ParticleMesh* pm, const CelestialBodies* bodies, size_t i,
+                 float* potential) {
+    size_t size = pm->size;
+    Vector2 pos = bodies->position[i];
+    float m = bodies->mass[i];
+    float energy = 0;
+    if(!on_grid(pm, pos)) {
+        Vector2 force = {0};
+        for(size_t j = 0; j < bodies->size; j++) {
+            if(j == i) continue;
+            Vector2 f = point_force(pos, m, bodies->position[j], bodies->mass[j],
+                                    potential ? &energy : NULL);
+            force = Vector2Add(force, f);
+        }
+        if(potential) *potential = energy;
+        return force;
+    }
+
+    Vector2 u = grid_coords(pm, pos);
+    float fx, fy;
+    size_t x = cic_node(u.x, size, &fx), y = cic_node(u.y, size, &fy);
+    size_t n00 = y * size + x, n10 = n00 + 1, n01 = n00 + size, n11 = n01 + 1;
+    float w00 = (1 - fx) * (1 - fy), w10 = fx * (1 - fy), w01 = (1 - fx) * fy, w11 = fx * fy;
+
+    const Vector2* a = pm->accel;
+    Vector2 accel = {
+        w00 * a[n00].x + w10 * a[n10].x + w01 * a[n01].x + w11 * a[n11].x,
+        w00 * a[n00].y + w10 * a[n10].y + w01 * a[n01].y + w11 * a[n11].y,
+    };
+    Vector2 force = Vector2Scale(accel, m);
+    for(size_t k = 0; k < pm->outside_count; k++) {
+        size_t j = pm->outside[k];
+        Vector2 f = point_force(pos, m, bodies->position[j], bodies->mass[j],
+                                potential ? &energy : NULL);
+        force = Vector2Add(force, f);
+    }
+
+    if(potential) {
+        const float* phi = pm->potential;
+        double mesh = (double)w00 * phi[n00] + (double)w10 * phi[n10] + (double)w01 * phi[n01] +
+                      (double)w11 * phi[n11];
+        // The body's own mass is part of the grid, remove its contribution. In double, as it can
+        // dwarf that of all the others.
+        const float w[4] = {w00, w10, w01, w11};
+        energy += (float)(m * (mesh - m * self_potential(pm, w) / pm->cell));
+    }
+    if(pm->short_range) {
+        force = Vector2Add(force, short_range_force(pm, i, pos, m, potential ? &energy : NULL));
+    }
+    if(potential) *potential = energy;
+    return force;
+}
+
+void pm_destroy(ParticleMesh* pm) {
+    if(pm->work) {
+        size_t size = pm->size, n = 2 * size;
+        ext_free(pm->work, sizeof(PmComplex) * n * n);
+        ext_free(pm->kernel, sizeof(float) * n * n);
+        ext_free(pm->twiddles, sizeof(PmComplex) * n / 2);
+        ext_free(pm->reverse, sizeof(uint32_t) * n);
+        ext_free(pm->potential, sizeof(float) * size * size);
+        ext_free(pm->accel, sizeof(Vector2) * size * size);
+        ext_free(pm->chain_start, sizeof(uint32_t) * (pm->chain_size * pm->chain_size + 1));
+    }
+    if(pm->capacity) {
+        ext_free(pm->outside, sizeof(uint32_t) * pm->capacity);
+        ext_free(pm->chain_cell, sizeof(uint32_t) * pm->capacity);
+        ext_free(pm->sorted_index, sizeof(uint32_t) * pm->capacity);
+        ext_free(pm->sorted_position, sizeof(Vector2) * pm->capacity);
+        ext_free(pm->sorted_mass, sizeof(float) * pm->capacity);
+    }
+    *pm = (ParticleMesh){0};
+}
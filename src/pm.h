@@ -0,0 +1,122 @@
+#ifndef PM_H
+#define PM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "body.h"
+#include "jobs.h"
+#include "raylib.h"
+
+// Particle-mesh gravity. Every force pass deposits the masses onto a square grid spanning the
+// bodies with cloud-in-cell weights, convolves them with the potential of a point mass by FFT, and
+// interpolates the gradient of the potential back at each body with the same weights. That costs
+// O(N + M^2 log M) on an M x M grid, however the bodies are distributed.
+//
+// Gravity falls off as 1/r^2 here, as in 3D space, so the grid is convolved with the potential
+// -G / r itself rather than solving the 2D Poisson equation, whose Green's function is
+// logarithmic. The grid is zero padded to twice its size so that bodies don't feel periodic images
+// of each other (Hockney & Eastwood).
+//
+// The mesh only carries the long-range part of the potential, -G erf(r / 2r_s) / r with r_s of
+// PM_SPLIT cells, which is smooth enough for the grid to resolve. On its own, forces are thus
+// softened over a few cells. With `short_range` (P3M), the remaining -G erfc(r / 2r_s) / r is
+// summed directly over the bodies closer than PM_CUTOFF r_s, found with a chaining mesh, which
+// brings back exact forces up close. That costs O(N n) for n bodies per neighborhood: cheap for
+// uniform distributions, up to direct summation for very clustered ones.
+//
+// The grid spans the bodies within PM_CLIP times their RMS distance from their mean position, so
+// that a few bodies flung far away don't stretch the cells over the rest. The bodies beyond
+// interact with every other body by direct summation, costing O(N) each.
+//
+// USAGE
+// ```c
+// ParticleMesh pm = pm_new(.size = 512);
+// pm_build(&pm, &bodies, &pool);
+// Vector2 f = pm_force(&pm, &bodies, i, NULL);
+// pm_destroy(&pm);
+// ```
+
+// Cells per side of the grid by default, and at most
+#define PM_DEFAULT_SIZE (256)
+#define PM_MAX_SIZE     (1024)
+// Split between the mesh and the short-range pass, in cells, and the radius of the short-range
+// pass in units of the split. As in TreePM codes, forces from beyond the cutoff are left to the
+// mesh with relative errors around 1e-3.
+#define PM_SPLIT  (1.25f)
+#define PM_CUTOFF (4.5f)
+// Extent of the grid around the mean position of the bodies, in RMS distances from it
+#define PM_CLIP (8.0f)
+
+typedef struct {
+    float re, im;
+} PmComplex;
+
+typedef struct {
+    // Cells per side, a power of 2 up to PM_MAX_SIZE. Only to be set before the first build.
+    size_t size;
+    // Whether to add the short-range pass (P3M)
+    bool short_range;
+
+    // Private fields
+    // World position of node (0, 0), and distance between nodes
+    Vector2 origin;
+    float cell;
+    // Bounds of the bodies on the grid, and the bodies outside of them
+    Vector2 lo, hi;
+    uint32_t* outside;
+    size_t outside_count;
+    // Masses deposited by each chunk of bodies, in units of `mass_unit`, on grids of `size` nodes
+    // per side in the scratch memory of the job pool
+    int64_t** partial;
+    size_t partials;
+    double mass_unit;
+    // Padded grid of 2 * size nodes per side, and the transform of the potential kernel on it,
+    // along with the twiddle factors and bit reversal permutation of its FFTs
+    PmComplex* work;
+    float* kernel;
+    // Potential per unit mass the mesh carries between nodes 0, 1 and sqrt(2) cells apart, at unit
+    // cell size
+    float self_kernel[3];
+    PmComplex* twiddles;
+    uint32_t* reverse;
+    // Potential per unit mass and acceleration at the nodes of the grid
+    float* potential;
+    Vector2* accel;
+    // Chaining mesh of the short-range pass, of cells at least the cutoff wide: bodies on the grid
+    // sorted by chain cell, those of cell c being [chain_start[c], chain_start[c + 1])
+    size_t chain_size, chain_cells;
+    uint32_t* chain_start;
+    uint32_t* chain_cell;
+    uint32_t* sorted_index;
+    Vector2* sorted_position;
+    float* sorted_mass;
+    // Of `outside` and the chaining mesh
+    size_t capacity;
+} ParticleMesh;
+
+// Creates a new particle mesh with default parameters, overridable with designated initializers.
+// Grids are allocated by the first build and reused by every following one.
+#define pm_new(...)              \
+    (ParticleMesh) {             \
+        .size = PM_DEFAULT_SIZE, \
+        __VA_ARGS__              \
+    }
+
+// Computes the potential and its gradient on a grid over `bodies`, dispatching the deposit and the
+// FFTs on `pool`. Also sorts the bodies into the chaining mesh for `short_range`. Results don't
+// depend on the number of workers.
+// The deposit allocates its grids with `jobs_scratch`, which is up to the caller to reset.
+void pm_build(ParticleMesh* pm, const CelestialBodies* bodies, JobPool* pool);
+// Computes the gravitational force exerted on body `i` by the other bodies of the last build.
+// Unless `potential` is NULL, also stores the (equally approximate) potential energy of the body
+// into it. The mesh carries the body's own potential too, which is taken back out, but only as
+// precisely as a float grid holds it: a body far heavier than the others around it gets an error of
+// about FLT_EPSILON times its own potential on the mesh, m^2 G / r_s.
+Vector2 pm_force(const ParticleMesh* pm, const CelestialBodies* bodies, size_t i,
+                 float* potential);
+// Frees all memory associated with the mesh
+void pm_destroy(ParticleMesh* pm);
+
+#endif
@@ -0,0 +1,169 @@
+#include "preview.h"
+
+#include <string.h>
+
+#include "extlib.h"
+#include "profiler.h"
+
+// Makes the first `len` points of `work` the newest path. Points of the same request are appended
+// to what was already published.
+static void publish(Preview* p, size_t len, size_t gen, size_t begin_gen) {
+    mutex_lock(&p->lock);
+    size_t from = p->path_gen == gen && p->path_begin_gen == begin_gen ? p->path_len : 0;
+    memcpy(p->path + from, p->work + from, sizeof(Vector2) * (len - from));
+    p->path_len = len;
+    p->path_gen = gen;
+    p->path_begin_gen = begin_gen;
+    mutex_unlock(&p->lock);
+}
+
+static bool cancelled(Preview* p, size_t gen) {
+    return atomic_load_explicit(&p->request_gen, memory_order_relaxed) != gen;
+}
+
+// Integrates the trajectory of `b` from substep `start_step`, publishing it along the way
+static void predict(Preview* p, CelestialBody b, size_t start_step, size_t gen, size_t begin_gen) {
+    Ephemeris* e = &p->ephemeris;
+    float m = 1.0f / b.inv_mass;
+    size_t publish_at = PREVIEW_FIRST_PUBLISH;
+
+    size_t n = 0;
+    for(size_t step = start_step; n < p->max_points; step++) {
+        // Rows the simulation has already passed are of no use anymore
+        while(step >= e->end) {
+            ephemeris_discard(e, start_step);
+            if(e->end - e->start >= e->rows) break;
+            ephemeris_extend(e, PREVIEW_EPHEMERIS_BATCH, p->dt);
+        }
+        if(step >= e->end) break;
+
+        b.velocity = kick_vel(b.velocity, b.force, b.inv_mass, 0.5f * p->dt);
+        b.position = drift_pos(b.position, b.velocity, p->dt);
+        b.force = ephemeris_force(e, step, b.position, m);
+        b.velocity = kick_vel(b.velocity, b.force, b.inv_mass, 0.5f * p->dt);
+        p->work[n++] = b.position;
+
+        if(n % PREVIEW_CANCEL_CHECK == 0 && cancelled(p, gen)) return;
+        if(n == publish_at) {
+            publish(p, n, gen, begin_gen);
+            publish_at *= 2;
+        }
+    }
+
+    publish(p, n, gen, begin_gen);
+}
+
+static void worker_main(void* arg) {
+    Preview* p = arg;
+    size_t begin_gen = 0;
+
+    mutex_lock(&p->lock);
+    for(;;) {
+        while(!p->shutdown && !(p->active && p->pending)) {
+            cond_wait(&p->wake, &p->lock);
+        }
+        if(p->shutdown) break;
+
+        if(begin_gen != p->begin_gen) {
+            begin_gen = p->begin_gen;
+            ephemeris_begin(&p->ephemeris, &p->start_bodies, &p->dynamics, p->max_points);
+        }
+        CelestialBody body = p->body;
+        size_t start_step = p->start_step;
+        size_t gen = atomic_load(&p->request_gen);
+        p->pending = false;
+        mutex_unlock(&p->lock);
+
+        PROFILE(PROFILE_PREVIEW) {
+            predict(p, body, start_step, gen, begin_gen);
+        }
+
+        mutex_lock(&p->lock);
+    }
+    mutex_unlock(&p->lock);
+}
+
+void preview_init(Preview* p, size_t max_points, float dt) {
+    *p = (Preview){.max_points = max_points, .dt = dt};
+    atomic_init(&p->request_gen, 0);
+    p->path = ext_alloc(sizeof(Vector2) * max_points);
+    p->work = ext_alloc(sizeof(Vector2) * max_points);
+    ephemeris_init(&p->ephemeris);
+    mutex_init(&p->lock);
+    cond_init(&p->wake);
+    if(!thread_create(&p->thread, worker_main, p)) {
+        EXT_ASSERT(false, "couldn't start the preview worker");
+    }
+}
+
+void preview_begin(Preview* p, const Simulation* sim) {
+    mutex_lock(&p->lock);
+    bodies_copy(&p->start_bodies, &sim->bodies);
+    p->dynamics = ephemeris_dynamics(sim);
+    p->begin_gen++;
+    p->active = true;
+    p->pending = false;
+    p->has_request = false;
+    atomic_fetch_add(&p->request_gen, 1);
+    mutex_unlock(&p->lock);
+}
+
+void preview_request(Preview* p, CelestialBody body, size_t start_step) {
+    if(p->has_request && Vector2Equals(body.velocity, p->last_velocity) &&
+       start_step - p->last_start_step < PREVIEW_MAX_STALE_STEPS) {
+        return;
+    }
+    p->has_request = true;
+    p->last_velocity = body.velocity;
+    p->last_start_step = start_step;
+
+    mutex_lock(&p->lock);
+    p->body = body;
+    p->start_step = start_step;
+    p->pending = true;
+    atomic_fetch_add(&p->request_gen, 1);
+    cond_signal(&p->wake);
+    mutex_unlock(&p->lock);
+}
+
+bool preview_path(Preview* p, Vector2* out, size_t cap, size_t* len) {
+    mutex_lock(&p->lock);
+    // A path from a previous drag is no path at all
+    size_t path_len = p->path_begin_gen == p->begin_gen ? p->path_len : 0;
+    bool changed = path_len != p->read_len || p->path_gen != p->read_gen ||
+                   p->path_begin_gen != p->read_begin_gen;
+    if(changed) {
+        *len = path_len < cap ? path_len : cap;
+        memcpy(out, p->path, sizeof(Vector2) * *len);
+        p->read_len = path_len;
+        p->read_gen = p->path_gen;
+        p->read_begin_gen = p->path_begin_gen;
+    }
+    mutex_unlock(&p->lock);
+    return changed;
+}
+
+void preview_end(Preview* p) {
+    mutex_lock(&p->lock);
+    p->active = false;
+    p->pending = false;
+    // Abandon whatever the worker is doing
+    atomic_fetch_add(&p->request_gen, 1);
+    mutex_unlock(&p->lock);
+}
+
+void preview_destroy(Preview* p) {
+    mutex_lock(&p->lock);
+    p->shutdown = true;
+    atomic_fetch_add(&p->request_gen, 1);
+    cond_signal(&p->wake);
+    mutex_unlock(&p->lock);
+    thread_join(&p->thread);
+
+    cond_destroy(&p->wake);
+    mutex_destroy(&p->lock);
+    ephemeris_destroy(&p->ephemeris);
+    bodies_free(&p->start_bodies);
+    ext_free(p->path, sizeof(Vector2) * p->max_points);
+    ext_free(p->work, sizeof(Vector2) * p->max_points);
+}
@@ -0,0 +1,89 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "body.h"
+#include "ephemeris.h"
+#include "simulation.h"
+#include "thread.h"
+
+// Asynchronous spawn path prediction.
+// A background worker owns the `Ephemeris` and integrates the candidate trajectory against it,
+// publishing the path progressively: the first `PREVIEW_FIRST_PUBLISH` points as soon as they are
+// ready, then doubling. A new request abandons the one in progress, so the renderer always gets
+// the newest finished prefix without ever waiting on the worker.
+//
+// USAGE
+// ```c
+// preview_begin(&p, &sim);                         // drag started
+// preview_request(&p, body, substeps_since_begin); // every frame while dragging
+// if(preview_path(&p, path, PATH_POINTS, &len)) {
+//     // path changed
+// }
+// preview_end(&p);                                 // drag released
+// ```
+
+// Number of points published first, then doubled at every publish
+#define PREVIEW_FIRST_PUBLISH (500)
+// Points integrated between checks for a newer request
+#define PREVIEW_CANCEL_CHECK (64)
+// Substeps the ephemeris is extended by at a time
+#define PREVIEW_EPHEMERIS_BATCH (64)
+// While the drag vector doesn't change, the path is kept for up to this many substeps before
+// being recomputed from the new release point
+#define PREVIEW_MAX_STALE_STEPS (SIMULATION_STEPS / 4)
+
+typedef struct {
+    // Maximum number of points of a path, and timestep between points
+    size_t max_points;
+    float dt;
+
+    // Private fields, shared with the worker under `lock`
+    Thread thread;
+    Mutex lock;
+    CondVar wake;
+    bool active, shutdown;
+    // State to start the ephemeris from, renewed by every `preview_begin`
+    CelestialBodies start_bodies;
+    EphemerisDynamics dynamics;
+    size_t begin_gen;
+    // Latest request
+    CelestialBody body;
+    size_t start_step;
+    atomic_size_t request_gen;
+    bool pending;
+    // Latest published path, belonging to `path_begin_gen`
+    Vector2* path;
+    size_t path_len, path_gen, path_begin_gen;
+
+    // Private fields, only touched by the worker
+    Ephemeris ephemeris;
+    Vector2* work;
+
+    // Private fields, only touched by the caller
+    Vector2 last_velocity;
+    size_t last_start_step;
+    bool has_request;
+    // Version of the path last returned by `preview_path`
+    size_t read_len, read_gen, read_begin_gen;
+} Preview;
+
+// Starts the worker. The preview must not be moved afterwards.
+void preview_init(Preview* p, size_t max_points, float dt);
+// Starts predicting paths among the current bodies of `sim`
+void preview_begin(Preview* p, const Simulation* sim);
+// Asks for the path of `body` released `start_step` substeps after `preview_begin`. Does nothing
+// if the velocity is the same as the last request and the path isn't too stale.
+void preview_request(Preview* p, CelestialBody body, size_t start_step);
+// If a newer path was published since the last call, copies up to `cap` of its points into `out`,
+// stores their number in `len` and returns true. Otherwise leaves both untouched.
+bool preview_path(Preview* p, Vector2* out, size_t cap, size_t* len);
+// Stops predicting, abandoning any work in progress
+void preview_end(Preview* p);
+// Stops the worker and frees all memory associated with the preview
+void preview_destroy(Preview* p);
+
+#endif
@@ -0,0 +1,90 @@
+#include "profiler.h"
+
+#ifdef PROFILER
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char* const profile_phase_names[PROFILE_PHASE_COUNT] = {
+    [PROFILE_INTEGRATE_POS] = "integrate_pos",
+    [PROFILE_FORCES] = "forces",
+    [PROFILE_INTEGRATE_VEL] = "integrate_vel",
+    [PROFILE_PREVIEW] = "preview",
+    [PROFILE_SPAWN_PATH] = "spawn_path",
+    [PROFILE_PRINT_ENERGY] = "print_energy",
+    [PROFILE_DRAW_BODIES] = "draw_bodies",
+    [PROFILE_END_DRAWING] = "end_drawing",
+};
+
+// Nanoseconds spent in every phase during the frame in progress
+static atomic_uint_least64_t pending[PROFILE_PHASE_COUNT];
+// Milliseconds spent in every phase during the last frames, frame k at `k % PROFILE_HISTORY`
+static float history[PROFILE_HISTORY][PROFILE_PHASE_COUNT];
+static size_t frames;
+
+void profiler_add(ProfilePhase phase, double seconds) {
+    atomic_fetch_add_explicit(&pending[phase], (uint64_t)(seconds * 1e9), memory_order_relaxed);
+}
+
+void profiler_frame(void) {
+    float* row = history[frames++ % PROFILE_HISTORY];
+    for(int p = 0; p < PROFILE_PHASE_COUNT; p++) {
+        row[p] = atomic_exchange_explicit(&pending[p], 0, memory_order_relaxed) * 1e-6;
+    }
+}
+
+static int compare_floats(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+ProfileStats profiler_stats(ProfilePhase phase) {
+    size_t n = frames < PROFILE_HISTORY ? frames : PROFILE_HISTORY;
+    if(!n) return (ProfileStats){0};
+
+    float sorted[PROFILE_HISTORY];
+    double sum = 0;
+    for(size_t i = 0; i < n; i++) {
+        sorted[i] = history[i][phase];
+        sum += sorted[i];
+    }
+    qsort(sorted, n, sizeof(float), compare_floats);
+    return (ProfileStats){
+        .min = sorted[0],
+        .avg = sum / n,
+        // Nearest rank
+        .p99 = sorted[(n * 99 + 99) / 100 - 1],
+        .last = history[(frames - 1) % PROFILE_HISTORY][phase],
+    };
+}
+
+bool profiler_write_csv(const char* path) {
+    FILE* f = fopen(path, "w");
+    if(!f) {
+        ext_log(EXT_ERROR, "couldn't write profile %s: %s", path, strerror(errno));
+        return false;
+    }
+    fprintf(f, "frame");
+    for(int p = 0; p < PROFILE_PHASE_COUNT; p++) fprintf(f, ",%s", profile_phase_names[p]);
+    fprintf(f, "\n");
+
+    size_t first = frames > PROFILE_HISTORY ? frames - PROFILE_HISTORY : 0;
+    for(size_t k = first; k < frames; k++) {
+        fprintf(f, "%zu", k);
+        for(int p = 0; p < PROFILE_PHASE_COUNT; p++) {
+            fprintf(f, ",%.4f", history[k % PROFILE_HISTORY][p]);
+        }
+        fprintf(f, "\n");
+    }
+
+    bool ok = !ferror(f);
+    if(fclose(f) != 0) ok = false;
+    if(!ok) ext_log(EXT_ERROR, "couldn't write profile %s: %s", path, strerror(errno));
+    return ok;
+}
+
+#endif  // PROFILER
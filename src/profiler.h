@@ -0,0 +1,80 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "extlib.h"
+#include "thread.h"
+
+// Per-phase frame profiler. Code wrapped in `PROFILE` is timed and added to its phase, from any
+// thread, and `profiler_frame` closes the frame, moving the time spent in every phase since the
+// previous frame into a ring buffer of the last PROFILE_HISTORY frames. So phases of the
+// simulation thread report the total of all the substeps that ran during each frame.
+// Compiled in unless built with `-DFRAME_PROFILER=OFF`, otherwise `PROFILE` expands to nothing and
+// only the block it wraps is left.
+//
+// USAGE
+// ```c
+// PROFILE(PROFILE_DRAW_BODIES) {
+//     // ...
+// }
+// profiler_frame();  // once per frame
+// ProfileStats s = profiler_stats(PROFILE_DRAW_BODIES);
+// ```
+//
+// Leaving a `PROFILE` block with `break`, `goto` or `return` skips adding its time.
+
+typedef enum {
+    // Simulation substeps (see `simulation_step`). With Verlet, the kicks are done along with the
+    // drifts and the forces, leaving PROFILE_INTEGRATE_VEL to the last stage of the other
+    // integrators.
+    PROFILE_INTEGRATE_POS,
+    PROFILE_FORCES,
+    PROFILE_INTEGRATE_VEL,
+    // Prediction of the path of the body being spawned, on the preview thread
+    PROFILE_PREVIEW,
+    // Requesting that path and simplifying whatever part of it is ready, on the main thread
+    PROFILE_SPAWN_PATH,
+    // Drawing
+    PROFILE_PRINT_ENERGY,
+    PROFILE_DRAW_BODIES,
+    PROFILE_END_DRAWING,
+    PROFILE_PHASE_COUNT,
+} ProfilePhase;
+
+// Frames kept for statistics and CSV exports
+#define PROFILE_HISTORY (256)
+
+#ifdef PROFILER
+
+extern const char* const profile_phase_names[PROFILE_PHASE_COUNT];
+
+// Milliseconds spent in a phase per frame over the history, and during the latest frame
+typedef struct {
+    float min, avg, p99, last;
+} ProfileStats;
+
+#define PROFILE(phase) PROFILE_(phase, EXT_CONCAT_(profile_start_, __LINE__))
+#define PROFILE_(phase, start)                     \
+    for(double start = thread_clock(); start >= 0; \
+        profiler_add((phase), thread_clock() - start), start = -1)
+
+// Adds `seconds` to the frame in progress. Thread safe.
+void profiler_add(ProfilePhase phase, double seconds);
+// Ends the frame in progress. Must always be called from the same thread.
+void profiler_frame(void);
+// Statistics of the frames in the history, all 0 before the first frame. Must be called from the
+// thread calling `profiler_frame`, as must `profiler_write_csv`.
+ProfileStats profiler_stats(ProfilePhase phase);
+// Writes every frame in the history to `path` as CSV, oldest first, one column per phase in
+// milliseconds. Returns false on failure.
+bool profiler_write_csv(const char* path);
+
+#else
+
+#define PROFILE(phase)
+
+#endif  // PROFILER
+
+#endif
@@ -0,0 +1,170 @@
+#include "quadtree.h"
+
+#include <float.h>
+#include <math.h>
+
+#include "raymath.h"
+
+// Also accumulates the potential energy into `u` if not NULL
+static Vector2 point_force(Vector2 p1, float m1, Vector2 p2, float m2, float* u) {
+    // F = G * (m1 * m2 / r^2), U = -G * (m1 * m2 / r)
+    Vector2 r = Vector2Subtract(p2, p1);
+    float r2 = fmaxf(Vector2LengthSqr(r), 1e-6f);
+    if(u) *u -= G * (m1 * m2) / sqrtf(r2);
+    return Vector2Scale(r, G * (m1 * m2) / (r2 * sqrtf(r2)));
+}
+
+static QuadNode* new_nodes(QuadTree* t, size_t count) {
+    QuadNode* nodes = ext_arena_alloc(&t->arena, sizeof(QuadNode) * count);
+    for(size_t i = 0; i < count; i++) {
+        nodes[i] = (QuadNode){.body = -1};
+    }
+    return nodes;
+}
+
+static int quadrant(const QuadNode* n, Vector2 p) {
+    return (p.x >= n->center.x) | ((p.y >= n->center.y) << 1);
+}
+
+static void subdivide(QuadTree* t, QuadNode* n) {
+    float h = n->half_size * 0.5f;
+    n->children = new_nodes(t, 4);
+    for(int q = 0; q < 4; q++) {
+        n->children[q].half_size = h;
+        n->children[q].center = (Vector2){
+            n->center.x + (q & 1 ? h : -h),
+            n->center.y + (q & 2 ? h : -h),
+        };
+    }
+}
+
+// Whether the node is still large enough for its children to be told apart at float precision.
+// Below this, rounding in the child centers makes `contains` unreliable.
+static bool can_split(const QuadNode* n, int depth) {
+    float extent = fmaxf(fabsf(n->center.x), fabsf(n->center.y));
+    return depth < QUADTREE_MAX_DEPTH && n->half_size > extent * (FLT_EPSILON * 1024);
+}
+
+static void insert(QuadTree* t, const CelestialBodies* bodies, int32_t i) {
+    Vector2 pos = bodies->position[i];
+    float m = bodies->mass[i];
+
+    QuadNode* n = t->root;
+    for(int depth = 0;; depth++) {
+        // Accumulate the mass-weighted position, `finalize` turns it into the center of mass
+        n->mass += m;
+        n->center_of_mass = Vector2Add(n->center_of_mass, Vector2Scale(pos, m));
+
+        if(n->children) {
+            n = &n->children[quadrant(n, pos)];
+            continue;
+        }
+
+        if(n->body < 0 || !can_split(n, depth)) {
+            t->next[i] = n->body;
+            n->body = i;
+            return;
+        }
+
+        // Occupied leaf: split it and push the resident body down one level
+        int32_t res = n->body;
+        Vector2 res_pos = bodies->position[res];
+        float res_m = bodies->mass[res];
+        n->body = -1;
+        subdivide(t, n);
+
+        QuadNode* c = &n->children[quadrant(n, res_pos)];
+        c->mass = res_m;
+        c->center_of_mass = Vector2Scale(res_pos, res_m);
+        c->body = res;
+        t->next[res] = -1;
+
+        n = &n->children[quadrant(n, pos)];
+    }
+}
+
+static void finalize(QuadNode* n) {
+    if(n->mass > 0) n->center_of_mass = Vector2Scale(n->center_of_mass, 1.0f / n->mass);
+    if(n->children) {
+        for(int q = 0; q < 4; q++) finalize(&n->children[q]);
+    }
+}
+
+void quadtree_build(QuadTree* t, const CelestialBodies* bodies) {
+    ext_arena_reset(&t->arena);
+    t->root = NULL;
+    t->next = NULL;
+    t->size = bodies->size;
+    if(!bodies->size) return;
+
+    Vector2 min = bodies->position[0], max = min;
+    for(size_t i = 1; i < bodies->size; i++) {
+        min.x = fminf(min.x, bodies->position[i].x);
+        min.y = fminf(min.y, bodies->position[i].y);
+        max.x = fmaxf(max.x, bodies->position[i].x);
+        max.y = fmaxf(max.y, bodies->position[i].y);
+    }
+
+    t->next = ext_arena_alloc(&t->arena, sizeof(int32_t) * bodies->size);
+    t->root = new_nodes(t, 1);
+    t->root->center = Vector2Scale(Vector2Add(min, max), 0.5f);
+    t->root->half_size = fmaxf(fmaxf(max.x - min.x, max.y - min.y) * 0.5f, 1.0f);
+
+    for(size_t i = 0; i < bodies->size; i++) {
+        insert(t, bodies, i);
+    }
+    finalize(t->root);
+}
+
+static bool contains(const QuadNode* n, Vector2 p) {
+    return fabsf(p.x - n->center.x) <= n->half_size && fabsf(p.y - n->center.y) <= n->half_size;
+}
+
+Vector2 quadtree_force(const QuadTree* t, const CelestialBodies* bodies, size_t i,
+                       float* potential) {
+    Vector2 f = {0};
+    float u = 0, *up = potential ? &u : NULL;
+    if(potential) *potential = 0;
+    if(!t->root) return f;
+
+    Vector2 pos = bodies->position[i];
+    float m = bodies->mass[i];
+    float theta2 = t->theta * t->theta;
+
+    // Every visited level pushes at most 4 nodes and pops one
+    const QuadNode* stack[3 * QUADTREE_MAX_DEPTH + 4];
+    size_t sp = 0;
+    stack[sp++] = t->root;
+
+    while(sp) {
+        const QuadNode* n = stack[--sp];
+        if(n->mass == 0) continue;
+
+        if(!n->children) {
+            for(int32_t j = n->body; j >= 0; j = t->next[j]) {
+                if((size_t)j == i) continue;
+                f = Vector2Add(f, point_force(pos, m, bodies->position[j], bodies->mass[j], up));
+            }
+            continue;
+        }
+
+        float s = 2 * n->half_size;
+        float d2 = Vector2DistanceSqr(n->center_of_mass, pos);
+        // Never approximate a node containing the body itself, it would feel its own pull
+        if(s * s < theta2 * d2 && !contains(n, pos)) {
+            f = Vector2Add(f, point_force(pos, m, n->center_of_mass, n->mass, up));
+        } else {
+            for(int q = 0; q < 4; q++) stack[sp++] = &n->children[q];
+        }
+    }
+
+    if(potential) *potential = u;
+    return f;
+}
+
+void quadtree_destroy(QuadTree* t) {
+    ext_arena_destroy(&t->arena);
+    t->root = NULL;
+    t->next = NULL;
+    t->size = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include <stdint.h>
+
+#include "body.h"
+#include "extlib.h"
+#include "raylib.h"
+
+// Default Barnes-Hut opening angle. A node of side `s` at distance `d` is approximated by its
+// center of mass when `s / d < theta`. 0 degenerates to direct summation.
+#define QUADTREE_DEFAULT_THETA (0.5f)
+// Past this depth (or when float precision runs out) bodies are no longer split and share the same
+// leaf. This guards against unbounded subdivision when two bodies end up on top of each other.
+#define QUADTREE_MAX_DEPTH (32)
+
+typedef struct QuadNode {
+    // Square region covered by the node
+    Vector2 center;
+    float half_size;
+    // Aggregated mass and center of mass of all bodies contained in the node
+    float mass;
+    Vector2 center_of_mass;
+    // The four children (NW, NE, SW, SE) allocated contiguously, NULL for leaves
+    struct QuadNode* children;
+    // Leaves only: index of the first contained body, -1 if empty.
+    // Other bodies in the same leaf are chained through `QuadTree.next`.
+    int32_t body;
+} QuadNode;
+
+// Barnes-Hut quadtree. Nodes are allocated from `arena`, which is reset on every build, so after
+// the first few substeps building the tree doesn't allocate at all.
+typedef struct {
+    float theta;
+    QuadNode* root;
+    // Per-body chaining for leaves holding more than one body (see QUADTREE_MAX_DEPTH)
+    int32_t* next;
+    size_t size;
+    Ext_Arena arena;
+} QuadTree;
+
+// Creates a new quadtree with default parameters, overridable with designated initializers.
+//
+// USAGE
+// ```c
+// QuadTree t = quadtree_new(.theta = 0.7f)
+// ```
+#define quadtree_new(...)                                                                \
+    (QuadTree) {                                                                         \
+        .theta = QUADTREE_DEFAULT_THETA,                                                 \
+        .arena = ext_new_arena(.page_size = 1 << 20, .flags = EXT_ARENA_FLEXIBLE_PAGE), \
+        __VA_ARGS__                                                                      \
+    }
+
+// (Re)builds the tree over `bodies`, discarding the previous one
+void quadtree_build(QuadTree* t, const CelestialBodies* bodies);
+// Computes the gravitational force exerted on body `i` by all the other bodies in the tree. Unless
+// `potential` is NULL, also stores the (equally approximate) potential energy of the body into it.
+Vector2 quadtree_force(const QuadTree* t, const CelestialBodies* bodies, size_t i,
+                       float* potential);
+// Frees all memory associated with the tree
+void quadtree_destroy(QuadTree* t);
+
+#endif
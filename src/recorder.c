@@ -0,0 +1,372 @@
+#include "recorder.h"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "extlib.h"
+#include "raymath.h"
+
+const char* const recorder_encoding_names[RECORDER_ENCODING_COUNT] = {
+    [RECORDER_RAW] = "raw",
+    [RECORDER_DELTA] = "delta",
+};
+
+// Frame as captured into a chunk, followed by `count` positions, then by `count` identifiers if
+// `ids`, padded so that the next frame stays aligned
+typedef struct {
+    uint64_t step, generation;
+    uint32_t count;
+    uint8_t after_drop, ids;
+} CapturedFrame;
+
+static size_t captured_size(size_t count, bool ids) {
+    size_t size = sizeof(CapturedFrame) + sizeof(Vector2) * count;
+    return ids ? size + sizeof(uint32_t) * (count + count % 2) : size;
+}
+
+// Quantized coordinates are clamped well within int32, so that deltas can't overflow either way
+#define QUANTIZED_LIMIT (1e9f)
+// Longest LEB128 encoding of a 32 bit value
+#define VARINT_MAX (5)
+
+static int32_t quantize(float x, float inv_quantum) {
+    float q = x * inv_quantum;
+    if(!(q == q)) return 0;
+    return (int32_t)lrintf(Clamp(q, -QUANTIZED_LIMIT, QUANTIZED_LIMIT));
+}
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ -((uint32_t)v >> 31);
+}
+
+static int32_t unzigzag(uint32_t z) {
+    return (int32_t)((z >> 1) ^ -(z & 1));
+}
+
+static size_t put_varint(uint8_t* out, uint32_t v) {
+    size_t n = 0;
+    while(v >= 0x80) {
+        out[n++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+    return n;
+}
+
+// Returns the number of bytes read, 0 if the varint is truncated or too long
+static size_t get_varint(const uint8_t* in, size_t size, uint32_t* v) {
+    *v = 0;
+    for(size_t n = 0; n < size && n < VARINT_MAX; n++) {
+        *v |= (uint32_t)(in[n] & 0x7f) << (7 * n);
+        if(!(in[n] & 0x80)) return n + 1;
+    }
+    return 0;
+}
+
+// Allocator of the writer's buffers. The context allocator isn't thread local unless built with
+// EXTLIB_THREADSAFE, and the thread capturing frames keeps allocating from it meanwhile.
+#define WRITER_ALLOCATOR (&ext_default_allocator.base)
+
+// Encodes a RECORDER_DELTA frame into `r->encoded`, filling in `out`
+static void encode_delta(Recorder* r, const CapturedFrame* f, const Vector2* pos,
+                         RecordingFrame* out) {
+    Ext_Allocator* a = WRITER_ALLOCATOR;
+    size_t n = f->count;
+    if(r->prev_capacity < 2 * n) {
+        r->prev = a->realloc(a, r->prev, sizeof(int32_t) * r->prev_capacity,
+                             sizeof(int32_t) * 2 * n);
+        r->prev_capacity = 2 * n;
+    }
+    if(r->encoded_capacity < 2 * n * VARINT_MAX) {
+        r->encoded = a->realloc(a, r->encoded, r->encoded_capacity, 2 * n * VARINT_MAX);
+        r->encoded_capacity = 2 * n * VARINT_MAX;
+    }
+
+    bool key = f->after_drop || f->ids || n != r->prev_count ||
+               f->generation != r->prev_generation ||
+               r->since_keyframe >= RECORDER_KEYFRAME_INTERVAL;
+    float inv_quantum = 1 / r->header.quantum;
+    size_t size = 0;
+    for(size_t i = 0; i < n; i++) {
+        int32_t q[2] = {quantize(pos[i].x, inv_quantum), quantize(pos[i].y, inv_quantum)};
+        for(int k = 0; k < 2; k++) {
+            int32_t v = key ? q[k] : q[k] - r->prev[2 * i + k];
+            size += put_varint(r->encoded + size, zigzag(v));
+            r->prev[2 * i + k] = q[k];
+        }
+    }
+
+    r->prev_count = n;
+    r->prev_generation = f->generation;
+    r->since_keyframe = key ? 1 : r->since_keyframe + 1;
+    out->flags = key ? RECORDING_KEYFRAME : 0;
+    out->size = size;
+}
+
+static void write_chunk(Recorder* r, const RecorderChunk* c) {
+    for(size_t offset = 0; offset < c->size;) {
+        const CapturedFrame* f = (const CapturedFrame*)(c->data + offset);
+        const Vector2* pos = (const Vector2*)(f + 1);
+        const uint32_t* ids = (const uint32_t*)(pos + f->count);
+        offset += captured_size(f->count, f->ids);
+
+        RecordingFrame out = {.step = f->step, .count = f->count};
+        const void* data;
+        if(r->header.encoding == RECORDER_DELTA) {
+            encode_delta(r, f, pos, &out);
+            data = r->encoded;
+        } else {
+            out.flags = RECORDING_KEYFRAME;
+            out.size = sizeof(Vector2) * f->count;
+            data = pos;
+        }
+        size_t ids_size = f->ids ? sizeof(uint32_t) * f->count : 0;
+        if(f->ids) out.flags |= RECORDING_IDS;
+
+        if(r->failed) continue;
+        if(fwrite(&out, sizeof(out), 1, r->file) != 1 ||
+           (ids_size && fwrite(ids, ids_size, 1, r->file) != 1) ||
+           (out.size && fwrite(data, out.size, 1, r->file) != 1)) {
+            ext_log(EXT_ERROR, "recorder: couldn't write frame: %s", strerror(errno));
+            r->failed = true;
+            continue;
+        }
+        atomic_fetch_add_explicit(&r->bytes, sizeof(out) + ids_size + out.size,
+                                  memory_order_relaxed);
+    }
+}
+
+static void writer_main(void* arg) {
+    Recorder* r = arg;
+    size_t next = 0;
+    mutex_lock(&r->lock);
+    for(;;) {
+        while(next == r->submitted && !r->shutdown) cond_wait(&r->wake, &r->lock);
+        if(next == r->submitted) break;
+        mutex_unlock(&r->lock);
+
+        RecorderChunk* c = &r->chunks[next % RECORDER_CHUNKS];
+        write_chunk(r, c);
+        c->size = c->frames = 0;
+        atomic_store_explicit(&r->written, ++next, memory_order_release);
+
+        mutex_lock(&r->lock);
+    }
+    mutex_unlock(&r->lock);
+
+    Ext_Allocator* a = WRITER_ALLOCATOR;
+    if(r->prev) a->free(a, r->prev, sizeof(int32_t) * r->prev_capacity);
+    if(r->encoded) a->free(a, r->encoded, r->encoded_capacity);
+}
+
+bool recorder_start(Recorder* r, const char* path, size_t interval, RecorderEncoding encoding) {
+    FILE* f = fopen(path, "wb");
+    if(!f) {
+        ext_log(EXT_ERROR, "recorder: couldn't create %s: %s", path, strerror(errno));
+        return false;
+    }
+    *r = (Recorder){
+        .active = true,
+        .interval = interval ? interval : 1,
+        .header = {
+            .magic = RECORDER_MAGIC,
+            .version = RECORDER_VERSION,
+            .encoding = encoding,
+            .interval = interval ? interval : 1,
+            .quantum = RECORDER_DEFAULT_QUANTUM,
+        },
+        .file = f,
+        .allocator = ext_context->alloc,
+        .since_keyframe = RECORDER_KEYFRAME_INTERVAL,
+        .captured_count = SIZE_MAX,
+    };
+    atomic_init(&r->frames, 0);
+    atomic_init(&r->dropped, 0);
+    atomic_init(&r->bytes, 0);
+    atomic_init(&r->written, 0);
+    if(fwrite(&r->header, sizeof(r->header), 1, f) != 1) {
+        ext_log(EXT_ERROR, "recorder: couldn't write %s: %s", path, strerror(errno));
+        fclose(f);
+        r->active = false;
+        return false;
+    }
+    atomic_store_explicit(&r->bytes, sizeof(r->header), memory_order_relaxed);
+
+    for(size_t i = 0; i < RECORDER_CHUNKS; i++) {
+        r->chunks[i].data = r->allocator->alloc(r->allocator, RECORDER_CHUNK_SIZE);
+        r->chunks[i].capacity = RECORDER_CHUNK_SIZE;
+    }
+    mutex_init(&r->lock);
+    cond_init(&r->wake);
+    if(!thread_create(&r->thread, writer_main, r)) {
+        ext_log(EXT_ERROR, "recorder: couldn't start the writer thread");
+        r->shutdown = true;
+        recorder_stop(r);
+        return false;
+    }
+    return true;
+}
+
+// Returns the chunk to capture into, or NULL if the writer still has all of them
+static RecorderChunk* claim_chunk(Recorder* r) {
+    if(!r->filling) {
+        size_t written = atomic_load_explicit(&r->written, memory_order_acquire);
+        if(r->submitted - written >= RECORDER_CHUNKS) return NULL;
+        r->filling = true;
+    }
+    return &r->chunks[r->submitted % RECORDER_CHUNKS];
+}
+
+static void submit_chunk(Recorder* r) {
+    mutex_lock(&r->lock);
+    r->submitted++;
+    cond_signal(&r->wake);
+    mutex_unlock(&r->lock);
+    r->filling = false;
+}
+
+void recorder_capture(Recorder* r, const CelestialBodies* b, size_t step, size_t generation) {
+    if(!r->active || step % r->interval) return;
+
+    // Identifiers only go with the first frame and the ones where the bodies changed
+    bool ids = b->size != r->captured_count || generation != r->captured_generation;
+    size_t size = captured_size(b->size, ids);
+    RecorderChunk* c = claim_chunk(r);
+    if(c && c->size && c->size + size > c->capacity) {
+        submit_chunk(r);
+        c = claim_chunk(r);
+    }
+    if(!c) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        r->after_drop = true;
+        return;
+    }
+    // Only ever for an empty chunk, as the bodies grow past what a chunk can hold
+    if(size > c->capacity) {
+        c->data = r->allocator->realloc(r->allocator, c->data, c->capacity, size);
+        c->capacity = size;
+    }
+
+    CapturedFrame* f = (CapturedFrame*)(c->data + c->size);
+    *f = (CapturedFrame){step, generation, b->size, r->after_drop, ids};
+    if(b->size) memcpy(f + 1, b->position, sizeof(Vector2) * b->size);
+    if(ids && b->size) memcpy((Vector2*)(f + 1) + b->size, b->id, sizeof(uint32_t) * b->size);
+    c->size += size;
+    r->after_drop = false;
+    r->captured_count = b->size;
+    r->captured_generation = generation;
+    atomic_fetch_add_explicit(&r->frames, 1, memory_order_relaxed);
+
+    // Don't keep frames of small scenes in memory for too long
+    if(++c->frames >= RECORDER_CHUNK_FRAMES) submit_chunk(r);
+}
+
+void recorder_stop(Recorder* r) {
+    if(!r->active) return;
+    if(!r->shutdown) {
+        if(r->filling && r->chunks[r->submitted % RECORDER_CHUNKS].size) submit_chunk(r);
+        mutex_lock(&r->lock);
+        r->shutdown = true;
+        cond_signal(&r->wake);
+        mutex_unlock(&r->lock);
+        thread_join(&r->thread);
+    }
+    if(fclose(r->file) != 0 && !r->failed) {
+        ext_log(EXT_ERROR, "recorder: couldn't write frames: %s", strerror(errno));
+    }
+    mutex_destroy(&r->lock);
+    cond_destroy(&r->wake);
+    for(size_t i = 0; i < RECORDER_CHUNKS; i++) {
+        r->allocator->free(r->allocator, r->chunks[i].data, r->chunks[i].capacity);
+    }
+    r->active = false;
+}
+
+bool recording_open(RecordingReader* r, const char* path) {
+    *r = (RecordingReader){0};
+    r->file = fopen(path, "rb");
+    if(!r->file) {
+        ext_log(EXT_ERROR, "couldn't open recording %s: %s", path, strerror(errno));
+        return false;
+    }
+    const RecordingHeader* h = &r->header;
+    if(fread(&r->header, sizeof(r->header), 1, r->file) != 1 ||
+       memcmp(h->magic, RECORDER_MAGIC, sizeof(h->magic)) != 0 || h->version != RECORDER_VERSION ||
+       h->encoding >= RECORDER_ENCODING_COUNT || !(h->quantum > 0)) {
+        ext_log(EXT_ERROR, "couldn't open recording %s: not a supported recording", path);
+        fclose(r->file);
+        r->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Decodes a RECORDER_DELTA frame from `r->data` into the positions
+static bool decode_delta(RecordingReader* r, const RecordingFrame* f) {
+    bool key = f->flags & RECORDING_KEYFRAME;
+    if(!key && f->count != r->count) return false;
+    size_t offset = 0;
+    for(size_t i = 0; i < 2 * (size_t)f->count; i++) {
+        uint32_t z;
+        size_t n = get_varint(r->data + offset, f->size - offset, &z);
+        if(!n) return false;
+        offset += n;
+        int32_t v = unzigzag(z);
+        r->quantized[i] = key ? v : (int32_t)((uint32_t)r->quantized[i] + (uint32_t)v);
+        float* p = i % 2 ? &r->positions[i / 2].y : &r->positions[i / 2].x;
+        *p = r->quantized[i] * r->header.quantum;
+    }
+    return offset == f->size;
+}
+
+bool recording_next(RecordingReader* r, size_t* step, const Vector2** positions,
+                    const uint32_t** ids, size_t* count) {
+    if(!r->file) return false;
+    RecordingFrame f;
+    if(fread(&f, sizeof(f), 1, r->file) != 1) return false;
+
+    if(r->capacity < f.count) {
+        r->positions = ext_realloc(r->positions, sizeof(Vector2) * r->capacity,
+                                   sizeof(Vector2) * f.count);
+        r->ids = ext_realloc(r->ids, sizeof(uint32_t) * r->capacity, sizeof(uint32_t) * f.count);
+        r->quantized = ext_realloc(r->quantized, sizeof(int32_t) * 2 * r->capacity,
+                                   sizeof(int32_t) * 2 * f.count);
+        r->capacity = f.count;
+    }
+    // Frames without identifiers have the same bodies as the previous one
+    bool ok = (f.flags & RECORDING_IDS) || f.count == r->count;
+    if(ok && (f.flags & RECORDING_IDS) && f.count) {
+        ok = fread(r->ids, sizeof(uint32_t) * f.count, 1, r->file) == 1;
+    }
+    if(ok && r->header.encoding == RECORDER_RAW) {
+        ok = f.size == sizeof(Vector2) * f.count &&
+             (!f.size || fread(r->positions, f.size, 1, r->file) == 1);
+    } else if(ok) {
+        if(r->data_capacity < f.size) {
+            r->data = ext_realloc(r->data, r->data_capacity, f.size);
+            r->data_capacity = f.size;
+        }
+        ok = (!f.size || fread(r->data, f.size, 1, r->file) == 1) && decode_delta(r, &f);
+    }
+    if(!ok) {
+        ext_log(EXT_ERROR, "recording: corrupted frame at step %llu", (unsigned long long)f.step);
+        return false;
+    }
+
+    r->count = f.count;
+    *step = f.step;
+    *positions = r->positions;
+    *ids = r->ids;
+    *count = f.count;
+    return true;
+}
+
+void recording_close(RecordingReader* r) {
+    if(r->file) fclose(r->file);
+    if(r->positions) ext_free(r->positions, sizeof(Vector2) * r->capacity);
+    if(r->ids) ext_free(r->ids, sizeof(uint32_t) * r->capacity);
+    if(r->quantized) ext_free(r->quantized, sizeof(int32_t) * 2 * r->capacity);
+    if(r->data) ext_free(r->data, r->data_capacity);
+    *r = (RecordingReader){0};
+}
@@ -0,0 +1,160 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "body.h"
+#include "extlib.h"
+#include "raylib.h"
+#include "thread.h"
+
+// Streaming trajectory recorder, for offline analysis of the positions of every body.
+// Capturing a frame only copies the positions into a ring of preallocated chunks, and full chunks
+// are handed to a background thread that encodes and writes them, so the simulation never waits on
+// the disk. When the disk falls behind and the ring is full, frames are dropped and counted rather
+// than blocking.
+//
+// USAGE
+// ```c
+// Recorder rec;
+// recorder_start(&rec, "trajectory.grec", 4, RECORDER_DELTA);
+// // after every substep
+// recorder_capture(&rec, &sim.bodies, sim.steps, sim.generation);
+// // ...
+// recorder_stop(&rec);
+//
+// RecordingReader rd;
+// recording_open(&rd, "trajectory.grec");
+// size_t step, count;
+// const Vector2* positions;
+// const uint32_t* ids;
+// while(recording_next(&rd, &step, &positions, &ids, &count)) {
+//     // ...
+// }
+// recording_close(&rd);
+// ```
+//
+// FILE FORMAT
+// A `RecordingHeader`, followed by one `RecordingFrame` per frame, each followed by `size` bytes of
+// positions, all in native byte order. RECORDER_RAW frames hold `count` Vector2. RECORDER_DELTA
+// frames hold two LEB128 varints per body (x then y) of the position quantized to multiples of
+// `quantum`: absolute in keyframes, otherwise the difference from the previous frame, both
+// zigzag encoded. Keyframes come every RECORDER_KEYFRAME_INTERVAL frames, and whenever the
+// previous frame can't be used: after dropped frames, or when the bodies changed.
+// Frames flagged RECORDING_IDS, the first one and every one after the bodies changed, hold the
+// `count` uint32 identifiers of the bodies (see `CelestialBodies.id`) before their positions, so
+// that bodies can be followed from frame to frame as they get reordered.
+
+#define RECORDER_MAGIC   "GRAVREC"
+#define RECORDER_VERSION (2)
+// Chunks in the ring, and their initial size. Chunks grow to fit at least one frame if needed.
+#define RECORDER_CHUNKS     (8)
+#define RECORDER_CHUNK_SIZE (4 << 20)
+// Chunks are also handed to the writer after this many frames, so small scenes reach the disk soon
+#define RECORDER_CHUNK_FRAMES (120)
+#define RECORDER_KEYFRAME_INTERVAL (64)
+// Resolution of RECORDER_DELTA positions
+#define RECORDER_DEFAULT_QUANTUM (1.0f / 64)
+
+typedef enum {
+    RECORDER_RAW,
+    RECORDER_DELTA,
+    RECORDER_ENCODING_COUNT,
+} RecorderEncoding;
+
+extern const char* const recorder_encoding_names[RECORDER_ENCODING_COUNT];
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t encoding;
+    // Substeps between frames, and resolution of RECORDER_DELTA positions
+    uint32_t interval;
+    float quantum;
+} RecordingHeader;
+
+#define RECORDING_KEYFRAME (1u << 0)
+#define RECORDING_IDS      (1u << 1)
+
+typedef struct {
+    uint64_t step;
+    uint32_t count;
+    uint32_t flags;
+    uint64_t size;
+} RecordingFrame;
+
+typedef struct {
+    char* data;
+    size_t size, capacity, frames;
+} RecorderChunk;
+
+typedef struct {
+    // Statistics, updated as frames are captured, dropped and written
+    atomic_size_t frames, dropped, bytes;
+
+    // Private fields
+    bool active;
+    size_t interval;
+    RecordingHeader header;
+    FILE* file;
+    Thread thread;
+    Mutex lock;
+    CondVar wake;
+    bool shutdown;
+    // Chunks handed to the writer so far, under `lock`, and written back. The k-th chunk goes in
+    // `chunks[k % RECORDER_CHUNKS]`, which is free once chunk k - RECORDER_CHUNKS was written.
+    // Chunks come from the context allocator of the thread that started recording.
+    RecorderChunk chunks[RECORDER_CHUNKS];
+    Ext_Allocator* allocator;
+    size_t submitted;
+    atomic_size_t written;
+    // Whether the capturing thread owns the current chunk, and dropped frames since the last
+    // captured one, along with its size and generation
+    bool filling, after_drop;
+    size_t captured_count;
+    uint64_t captured_generation;
+    // Writer state: whether writing failed, the previous frame's quantized positions, and the
+    // encoded frame, allocated by the writer thread from the default allocator
+    bool failed;
+    int32_t* prev;
+    size_t prev_count, prev_capacity, since_keyframe;
+    uint64_t prev_generation;
+    uint8_t* encoded;
+    size_t encoded_capacity;
+} Recorder;
+
+// Starts recording into a new file at `path`, one frame every `interval` substeps. Returns false
+// if the file couldn't be created.
+bool recorder_start(Recorder* r, const char* path, size_t interval, RecorderEncoding encoding);
+// Captures the positions of the bodies if a frame is due at substep `step`. `generation` tells
+// when the bodies got reordered (see `Simulation.generation`). Never blocks. Does nothing if the
+// recorder isn't started.
+void recorder_capture(Recorder* r, const CelestialBodies* b, size_t step, size_t generation);
+// Writes out the frames captured so far and closes the file
+void recorder_stop(Recorder* r);
+
+typedef struct {
+    RecordingHeader header;
+    // Private fields
+    FILE* file;
+    Vector2* positions;
+    uint32_t* ids;
+    int32_t* quantized;
+    size_t count, capacity;
+    uint8_t* data;
+    size_t data_capacity;
+} RecordingReader;
+
+// Opens a recording. Returns false on failure.
+bool recording_open(RecordingReader* r, const char* path);
+// Decodes the next frame, along with the identifiers of its bodies. `positions` and `ids` stay valid
+// until the next call. Returns false at the end of the recording or on failure.
+bool recording_next(RecordingReader* r, size_t* step, const Vector2** positions,
+                    const uint32_t** ids, size_t* count);
+void recording_close(RecordingReader* r);
+
+#endif
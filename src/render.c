@@ -0,0 +1,235 @@
+#include "render.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "extlib.h"
+#include "raylib.h"
+#include "raymath.h"
+#include "rlgl.h"
+
+typedef struct {
+    Vector2 center;
+    float radius;
+    Color color;
+} Instance;
+
+// Sums over the bodies aggregated into a splat
+typedef struct {
+    uint32_t count;
+    uint32_t r, g, b, a;
+} SplatCell;
+
+// WebGL 2 takes GLSL ES 3.00, the same language as GLSL 3.30 for these shaders
+#ifdef EXT_EMSCRIPTEN
+#define SHADER_VERSION "#version 300 es\nprecision highp float;\n"
+#else
+#define SHADER_VERSION "#version 330\n"
+#endif
+
+static const char* vertex_shader =
+    SHADER_VERSION
+    "in vec2 corner;\n"
+    "in vec3 center_radius;\n"
+    "in vec4 color;\n"
+    "uniform mat4 mvp;\n"
+    "out vec2 local;\n"
+    "out vec4 tint;\n"
+    "void main() {\n"
+    "    local = corner;\n"
+    "    tint = color;\n"
+    "    gl_Position = mvp * vec4(center_radius.xy + corner * center_radius.z, 0.0, 1.0);\n"
+    "}\n";
+
+// Coverage from the distance to the circle's edge, antialiased over about a pixel
+static const char* fragment_shader =
+    SHADER_VERSION
+    "in vec2 local;\n"
+    "in vec4 tint;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "    float d = length(local);\n"
+    "    float coverage = 1.0 - smoothstep(1.0 - fwidth(d), 1.0, d);\n"
+    "    if(coverage <= 0.0) discard;\n"
+    "    frag_color = vec4(tint.rgb, tint.a * coverage);\n"
+    "}\n";
+
+// Two triangles covering the [-1, 1] square
+static const float quad[] = {-1, -1, 1, -1, 1, 1, -1, -1, 1, 1, -1, 1};
+
+// (Re)creates the instance buffer to hold as many instances as the staging buffer
+static void load_instance_buffer(BodyRenderer* r) {
+    if(r->instance_vbo) rlUnloadVertexBuffer(r->instance_vbo);
+    rlEnableVertexArray(r->vao);
+    r->instance_vbo = rlLoadVertexBuffer(NULL, sizeof(Instance) * r->capacity, true);
+    rlSetVertexAttribute(r->center_radius_attrib, 3, RL_FLOAT, false, sizeof(Instance),
+                         offsetof(Instance, center));
+    rlSetVertexAttributeDivisor(r->center_radius_attrib, 1);
+    rlEnableVertexAttribute(r->center_radius_attrib);
+    rlSetVertexAttribute(r->color_attrib, 4, RL_UNSIGNED_BYTE, true, sizeof(Instance),
+                         offsetof(Instance, color));
+    rlSetVertexAttributeDivisor(r->color_attrib, 1);
+    rlEnableVertexAttribute(r->color_attrib);
+    rlDisableVertexArray();
+}
+
+// Grows the staging buffer to hold at least `count` instances, along with the instance buffer
+// when drawing instanced
+static void reserve_instances(BodyRenderer* r, size_t count) {
+    if(count <= r->capacity) return;
+    size_t capacity = r->capacity ? r->capacity : 1024;
+    while(capacity < count) capacity *= 2;
+    if(r->instances) ext_free(r->instances, sizeof(Instance) * r->capacity);
+    r->instances = ext_alloc(sizeof(Instance) * capacity);
+    r->capacity = capacity;
+    if(r->available) load_instance_buffer(r);
+}
+
+// Grows the splat grid to at least `count` cells, all empty
+static void reserve_cells(BodyRenderer* r, size_t count) {
+    if(count <= r->cell_capacity) return;
+    if(r->cells) {
+        ext_free(r->cells, sizeof(SplatCell) * r->cell_capacity);
+        ext_free(r->touched, sizeof(uint32_t) * r->cell_capacity);
+    }
+    r->cells = ext_alloc(sizeof(SplatCell) * count);
+    r->touched = ext_alloc(sizeof(uint32_t) * count);
+    memset(r->cells, 0, sizeof(SplatCell) * count);
+    r->cell_capacity = count;
+}
+
+bool renderer_init(BodyRenderer* r) {
+    *r = (BodyRenderer){0};
+    reserve_instances(r, 1024);
+    // On failure rlgl falls back to its default shader
+    r->program = rlLoadShaderCode(vertex_shader, fragment_shader);
+    if(!r->program || r->program == rlGetShaderIdDefault()) {
+        r->program = 0;
+        ext_log(EXT_WARNING, "renderer: couldn't load shaders, drawing bodies one at a time");
+        return false;
+    }
+    r->mvp_loc = rlGetLocationUniform(r->program, "mvp");
+    r->corner_attrib = rlGetLocationAttrib(r->program, "corner");
+    r->center_radius_attrib = rlGetLocationAttrib(r->program, "center_radius");
+    r->color_attrib = rlGetLocationAttrib(r->program, "color");
+
+    r->vao = rlLoadVertexArray();
+    rlEnableVertexArray(r->vao);
+    r->quad_vbo = rlLoadVertexBuffer(quad, sizeof(quad), false);
+    rlSetVertexAttribute(r->corner_attrib, 2, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(r->corner_attrib);
+    rlDisableVertexArray();
+
+    r->available = true;
+    load_instance_buffer(r);
+    return true;
+}
+
+// Packs the instances of the bodies in view, followed by the splats of the ones too small to be
+// drawn on their own, and returns how many there are
+static size_t collect(BodyRenderer* r, const Snapshot* prev, const Snapshot* cur, float alpha,
+                      RenderView view) {
+    Rectangle w = view.world;
+    float cell = SPLAT_CELL / view.zoom, min_radius = 0.5f * SPLAT_MIN_SIZE / view.zoom;
+    size_t cols = (size_t)ceilf(w.width / cell), rows = (size_t)ceilf(w.height / cell);
+    if(!cols || !rows) return 0;
+    reserve_cells(r, cols * rows);
+    // Every splat holds at least one body
+    reserve_instances(r, cur->size);
+
+    Instance* instances = r->instances;
+    SplatCell* cells = r->cells;
+    size_t count = 0, touched = 0;
+    for(size_t i = 0; i < cur->size; i++) {
+        Vector2 p = snapshot_position(prev, cur, i, alpha);
+        float radius = cur->radius[i];
+        if(p.x + radius < w.x || p.x - radius > w.x + w.width || p.y + radius < w.y ||
+           p.y - radius > w.y + w.height) {
+            continue;
+        }
+        Color c = cur->color[i];
+        if(radius >= min_radius) {
+            instances[count++] = (Instance){.center = p, .radius = radius, .color = c};
+            continue;
+        }
+
+        // Bodies barely out of the view still land in its border cells
+        size_t x = (size_t)Clamp((p.x - w.x) / cell, 0, cols - 1);
+        size_t y = (size_t)Clamp((p.y - w.y) / cell, 0, rows - 1);
+        SplatCell* s = &cells[y * cols + x];
+        if(!s->count) r->touched[touched++] = y * cols + x;
+        s->count++;
+        s->r += c.r, s->g += c.g, s->b += c.b, s->a += c.a;
+    }
+    r->drawn = count;
+    r->splats = touched;
+
+    for(size_t t = 0; t < touched; t++) {
+        uint32_t idx = r->touched[t];
+        SplatCell* s = &cells[idx];
+        float opacity = 1 - powf(1 - SPLAT_OPACITY, (float)s->count);
+        instances[count++] = (Instance){
+            .center = {w.x + (idx % cols + 0.5f) * cell, w.y + (idx / cols + 0.5f) * cell},
+            .radius = 0.5f * cell,
+            .color = {
+                s->r / s->count,
+                s->g / s->count,
+                s->b / s->count,
+                (unsigned char)(opacity * s->a / s->count),
+            },
+        };
+        *s = (SplatCell){0};
+    }
+    return count;
+}
+
+void renderer_draw(BodyRenderer* r, const Snapshot* prev, const Snapshot* cur, float alpha,
+                   RenderView view, bool instanced) {
+    size_t count = collect(r, prev, cur, alpha, view);
+    if(!count) return;
+    Instance* instances = r->instances;
+
+    if(!instanced || !r->available) {
+        for(size_t i = 0; i < count; i++) {
+            DrawCircleV(instances[i].center, instances[i].radius, instances[i].color);
+        }
+        // Submit the batch now, so that its cost is accounted to the bodies
+        rlDrawRenderBatchActive();
+        return;
+    }
+
+    rlUpdateVertexBuffer(r->instance_vbo, instances, sizeof(Instance) * count, 0);
+
+    // Flush what raylib batched so far, so that bodies are drawn in order
+    rlDrawRenderBatchActive();
+
+    rlEnableShader(r->program);
+    rlSetUniformMatrix(r->mvp_loc, MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection()));
+    rlEnableVertexArray(r->vao);
+    rlDrawVertexArrayInstanced(0, EXT_ARR_SIZE(quad) / 2, count);
+    rlDisableVertexArray();
+    rlDisableShader();
+}
+
+void renderer_destroy(BodyRenderer* r) {
+    if(r->instance_vbo) rlUnloadVertexBuffer(r->instance_vbo);
+    if(r->quad_vbo) rlUnloadVertexBuffer(r->quad_vbo);
+    if(r->vao) rlUnloadVertexArray(r->vao);
+    if(r->program) rlUnloadShaderProgram(r->program);
+    if(r->instances) ext_free(r->instances, sizeof(Instance) * r->capacity);
+    if(r->cells) {
+        ext_free(r->cells, sizeof(SplatCell) * r->cell_capacity);
+        ext_free(r->touched, sizeof(uint32_t) * r->cell_capacity);
+    }
+    *r = (BodyRenderer){0};
+}
+
+RenderView render_view(Camera2D camera, int width, int height) {
+    Vector2 a = GetScreenToWorld2D((Vector2){0, 0}, camera);
+    Vector2 b = GetScreenToWorld2D((Vector2){width, height}, camera);
+    return (RenderView){
+        .world = {fminf(a.x, b.x), fminf(a.y, b.y), fabsf(b.x - a.x), fabsf(b.y - a.y)},
+        .zoom = camera.zoom,
+    };
+}
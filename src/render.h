@@ -0,0 +1,67 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "raylib.h"
+#include "runner.h"
+
+// Instanced body renderer.
+// Every frame the interpolated position, radius and color of each body in view are packed into a
+// single instance buffer, and all bodies are drawn with one instanced quad whose fragment shader
+// shades an antialiased circle from its signed distance. Compared to one `DrawCircleV` per body
+// this does no tessellation on the CPU and a single draw call.
+// Bodies outside the view are culled, and bodies smaller than SPLAT_MIN_SIZE pixels are binned
+// into a grid of SPLAT_CELL pixel cells, each drawn as a single splat getting more opaque with
+// every body in it. So what gets drawn is bounded by what is visible, however many bodies there
+// are.
+
+// Bodies less than this many pixels across are aggregated into splats
+#define SPLAT_MIN_SIZE (1.0f)
+// Side of the splat cells, in pixels
+#define SPLAT_CELL (2)
+// Opacity of a splat of a single body, stacking up with every other body in the same cell
+#define SPLAT_OPACITY (0.25f)
+
+typedef struct {
+    // Part of the world in view
+    Rectangle world;
+    // Pixels per world unit
+    float zoom;
+} RenderView;
+
+typedef struct {
+    bool available;
+    // Bodies drawn during the last frame, and how many splats the others were aggregated into
+    size_t drawn, splats;
+
+    // Private fields
+    unsigned int program, vao, quad_vbo, instance_vbo;
+    int mvp_loc;
+    int corner_attrib, center_radius_attrib, color_attrib;
+    // Staging copy of the instance buffer, `capacity` instances
+    void* instances;
+    size_t capacity;
+    // Splat grid, and the indices of the cells bodies went into this frame
+    void* cells;
+    uint32_t* touched;
+    size_t cell_capacity;
+} BodyRenderer;
+
+// Compiles the shaders. Must be called after the window is created. Returns false if they
+// couldn't be loaded, leaving `available` unset: bodies are then drawn with raylib's shapes.
+bool renderer_init(BodyRenderer* r);
+// Draws the bodies of `cur` in `view`, interpolating from their position in `prev` by `alpha`,
+// instanced if `instanced` and available or else with one `DrawCircleV` per body or splat. To be
+// called between `BeginMode2D` and `EndMode2D`, with the camera `view` was made from.
+void renderer_draw(BodyRenderer* r, const Snapshot* prev, const Snapshot* cur, float alpha,
+                   RenderView view, bool instanced);
+// Frees all resources associated with the renderer
+void renderer_destroy(BodyRenderer* r);
+
+// Part of the world `camera` shows on a `width` x `height` screen, ignoring its rotation
+RenderView render_view(Camera2D camera, int width, int height);
+
+#endif
@@ -0,0 +1,245 @@
+#include "replay.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "scene.h"
+
+// Longest line of a log, bounding the paths of loaded scenes
+#define INPUT_LINE_MAX (4096)
+
+static void write_event(FILE* f, const InputEvent* e) {
+    switch(e->kind) {
+    case INPUT_SETTINGS: {
+        const InputSettings* st = &e->settings;
+        fprintf(f, "settings %zu %d %a %d %d %d %a\n", e->step, (int)st->solver, st->theta,
+                st->block_steps, st->merge, (int)st->escape, st->escape_radius);
+    } break;
+    case INPUT_SPAWN: {
+        const CelestialBody* b = &e->body;
+        fprintf(f, "spawn %zu %a %a %a %a %a %a %u %u %u %u\n", e->step, b->position.x,
+                b->position.y, b->velocity.x, b->velocity.y, b->radius, b->inv_mass,
+                b->color.r, b->color.g, b->color.b, b->color.a);
+    } break;
+    case INPUT_SCENARIO: {
+        const ScenarioConfig* c = &e->scenario;
+        fprintf(f, "scenario %zu %s %zu %" PRIu64 " %a %a %a\n", e->step, scenario_names[c->kind],
+                c->bodies, c->seed, c->center.x, c->center.y, c->scale);
+    } break;
+    case INPUT_LOAD:
+        fprintf(f, "load %zu %s\n", e->step, e->path);
+        break;
+    default:
+        EXT_UNREACHABLE();
+    }
+    fflush(f);
+}
+
+static InputSettings current_settings(const Simulation* s) {
+    return (InputSettings){
+        .solver = s->solver,
+        .theta = s->tree.theta,
+        .block_steps = s->block_steps,
+        .merge = s->merge,
+        .escape = s->escape,
+        .escape_radius = s->escape_radius,
+    };
+}
+
+bool input_log_open(InputLog* log, const char* path, unsigned seed, float dt, const Simulation* s) {
+    *log = (InputLog){0};
+    log->file = fopen(path, "w");
+    if(!log->file) {
+        ext_log(EXT_ERROR, "couldn't create input log %s: %s", path, strerror(errno));
+        return false;
+    }
+    fprintf(log->file, "%s %d %u %a\n", INPUT_LOG_MAGIC, INPUT_LOG_VERSION, seed, dt);
+    input_log_settings(log, s);
+    return true;
+}
+
+bool input_log_apply(InputLog* log, Simulation* s, InputEvent e, Ext_VmAllocator* vm) {
+    e.step = s->steps;
+    if(!input_apply(s, &e, vm)) return false;
+    if(log->file) write_event(log->file, &e);
+    return true;
+}
+
+void input_log_settings(InputLog* log, const Simulation* s) {
+    if(!log->file) return;
+    InputEvent e = {.kind = INPUT_SETTINGS, .step = s->steps, .settings = current_settings(s)};
+    write_event(log->file, &e);
+}
+
+void input_log_close(InputLog* log, const Simulation* s) {
+    if(!log->file) return;
+    fprintf(log->file, "end %zu %016" PRIx64 "\n", s->steps, input_checksum(s));
+    if(fclose(log->file) != 0) {
+        ext_log(EXT_ERROR, "couldn't write input log: %s", strerror(errno));
+    }
+    log->file = NULL;
+}
+
+bool input_apply(Simulation* s, const InputEvent* e, Ext_VmAllocator* vm) {
+    switch(e->kind) {
+    case INPUT_SETTINGS: {
+        const InputSettings* st = &e->settings;
+        s->solver = st->solver;
+        s->tree.theta = st->theta;
+        s->block_steps = st->block_steps;
+        s->merge = st->merge;
+        s->escape = st->escape;
+        s->escape_radius = st->escape_radius;
+    } break;
+    case INPUT_SPAWN:
+        bodies_push(&s->bodies, e->body);
+        break;
+    case INPUT_SCENARIO:
+        scenario_generate(&s->bodies, &e->scenario);
+        break;
+    case INPUT_LOAD: {
+        size_t steps;
+        if(!scene_load(e->path, &s->bodies, vm, &steps)) return false;
+        // Substeps keep counting from here, only catching up with the saved ones modulo a cycle
+        // of block timesteps, which is all the levels of the bodies depend on
+        s->steps += (steps - s->steps) % (1u << BLOCK_MAX_LEVEL);
+        s->generation++;
+    } break;
+    default:
+        EXT_UNREACHABLE();
+    }
+#ifdef SIMULATION_ENERGY
+    simulation_reset_energy(s);
+#endif
+    return true;
+}
+
+// FNV-1a
+static uint64_t hash(uint64_t h, const void* data, size_t size) {
+    const unsigned char* p = data;
+    for(size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+uint64_t input_checksum(const Simulation* s) {
+    const CelestialBodies* b = &s->bodies;
+    uint64_t h = 0xcbf29ce484222325ull;
+    uint64_t steps = s->steps, size = b->size;
+    h = hash(h, &steps, sizeof(steps));
+    h = hash(h, &size, sizeof(size));
+#define X(T, name) \
+    if(b->size) h = hash(h, b->name, sizeof(T) * b->size);
+    CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    return hash(h, &s->far, sizeof(s->far));
+}
+
+// Parses an event line, or the end of the log if `end` gets set
+static bool parse_event(char* line, InputEvent* e, bool* end, uint64_t* checksum) {
+    char kind[16];
+    int n;
+    *end = false;
+    if(sscanf(line, "%15s %zu %n", kind, &e->step, &n) != 2) return false;
+    const char* args = line + n;
+
+    if(strcmp(kind, "settings") == 0) {
+        int solver, block_steps, merge, escape;
+        InputSettings* st = &e->settings;
+        e->kind = INPUT_SETTINGS;
+        if(sscanf(args, "%d %f %d %d %d %f", &solver, &st->theta, &block_steps, &merge, &escape,
+                  &st->escape_radius) != 6) {
+            return false;
+        }
+        if(solver < 0 || solver >= SOLVER_COUNT || escape < 0 || escape >= ESCAPE_COUNT) {
+            return false;
+        }
+        st->solver = solver;
+        st->block_steps = block_steps;
+        st->merge = merge;
+        st->escape = escape;
+    } else if(strcmp(kind, "spawn") == 0) {
+        CelestialBody* b = &e->body;
+        unsigned c[4];
+        e->kind = INPUT_SPAWN;
+        *b = (CelestialBody){0};
+        if(sscanf(args, "%f %f %f %f %f %f %u %u %u %u", &b->position.x, &b->position.y,
+                  &b->velocity.x, &b->velocity.y, &b->radius, &b->inv_mass, &c[0], &c[1], &c[2],
+                  &c[3]) != 10) {
+            return false;
+        }
+        b->color = (Color){c[0], c[1], c[2], c[3]};
+    } else if(strcmp(kind, "scenario") == 0) {
+        char name[16];
+        ScenarioConfig* c = &e->scenario;
+        e->kind = INPUT_SCENARIO;
+        *c = (ScenarioConfig){0};
+        if(sscanf(args, "%15s %zu %" SCNu64 " %f %f %f", name, &c->bodies, &c->seed, &c->center.x,
+                  &c->center.y, &c->scale) != 6) {
+            return false;
+        }
+        c->kind = SCENARIO_COUNT;
+        for(int k = 0; k < SCENARIO_COUNT; k++) {
+            if(strcmp(name, scenario_names[k]) == 0) c->kind = k;
+        }
+        if(c->kind == SCENARIO_COUNT) return false;
+    } else if(strcmp(kind, "load") == 0) {
+        line[strcspn(line, "\r\n")] = '\0';
+        e->kind = INPUT_LOAD;
+        e->path = args;
+        if(!*e->path) return false;
+    } else if(strcmp(kind, "end") == 0) {
+        *end = true;
+        return sscanf(args, "%" SCNx64, checksum) == 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool replay_run(const char* path, Simulation* s, Ext_VmAllocator* vm, uint64_t* expected) {
+    FILE* f = fopen(path, "r");
+    if(!f) {
+        ext_log(EXT_ERROR, "couldn't open input log %s: %s", path, strerror(errno));
+        return false;
+    }
+    *expected = 0;
+
+    char line[INPUT_LINE_MAX];
+    int version;
+    unsigned seed;
+    float dt;
+    bool ok = fgets(line, sizeof(line), f) &&
+              sscanf(line, INPUT_LOG_MAGIC " %d %u %f", &version, &seed, &dt) == 3 &&
+              version == INPUT_LOG_VERSION;
+    if(!ok) ext_log(EXT_ERROR, "couldn't replay %s: not a supported input log", path);
+
+    for(size_t lineno = 2; ok && fgets(line, sizeof(line), f); lineno++) {
+        if(line[strspn(line, " \t\r\n")] == '\0') continue;
+        InputEvent e;
+        bool end;
+        uint64_t checksum;
+        if(!parse_event(line, &e, &end, &checksum)) {
+            ext_log(EXT_ERROR, "couldn't replay %s: invalid event on line %zu", path, lineno);
+            ok = false;
+            break;
+        }
+        if(e.step < s->steps) {
+            ext_log(EXT_ERROR, "couldn't replay %s: line %zu is at substep %zu, already at %zu",
+                    path, lineno, e.step, s->steps);
+            ok = false;
+            break;
+        }
+
+        while(s->steps < e.step) simulation_step(s, dt);
+        if(end) {
+            *expected = checksum;
+            break;
+        }
+        ok = input_apply(s, &e, vm);
+    }
+    fclose(f);
+    return ok;
+}
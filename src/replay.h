@@ -0,0 +1,113 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "body.h"
+#include "extlib.h"
+#include "scenario.h"
+#include "simulation.h"
+
+// Input logs, to reproduce a session by replaying what was done to the simulation rather than
+// storing its state.
+// The simulation is deterministic given its inputs and the substeps they happened at, so the log
+// only holds the settings, the spawned bodies, the generated scenarios and the loaded scenes, each
+// with the substep index it happened at. Replaying steps a fresh simulation up to each event,
+// applies it, and ends at the substep the session ended at, with a checksum of the state to
+// compare against.
+//
+// USAGE
+// ```c
+// // Recording, with the simulation locked
+// input_log_open(&log, "session.glog", seed, dt, &sim);
+// input_log_apply(&log, &sim, (InputEvent){.kind = INPUT_SPAWN, .body = body}, NULL);
+// input_log_settings(&log, &sim);  // after changing the solver, theta, ...
+// input_log_close(&log, &sim);
+//
+// // Replaying
+// Simulation sim;
+// simulation_init(&sim, 0);
+// uint64_t expected;
+// if(replay_run("session.glog", &sim, NULL, &expected) && expected != input_checksum(&sim)) ...
+// ```
+//
+// FILE FORMAT
+// Text, one line per event. Floats are written as C99 hexadecimal literals, so they read back
+// exactly.
+// ```
+// gravity-inputs 3 <seed> <dt>
+// settings <step> <solver> <theta> <block steps> <merge> <escape> <escape radius>
+// spawn <step> <x> <y> <vx> <vy> <radius> <inverse mass> <r> <g> <b> <a>
+// scenario <step> <name> <bodies> <seed> <center x> <center y> <scale>
+// load <step> <path until the end of the line>
+// end <step> <checksum>
+// ```
+
+#define INPUT_LOG_MAGIC   "gravity-inputs"
+#define INPUT_LOG_VERSION (3)
+
+typedef enum {
+    // Changes of the settings that affect the physics. Also the first event of every log.
+    INPUT_SETTINGS,
+    // A new body, pushed after the others
+    INPUT_SPAWN,
+    // Bodies of a scenario, appended to the others (see scenario.h)
+    INPUT_SCENARIO,
+    // Replaces the bodies with a scene (see scene.h)
+    INPUT_LOAD,
+    INPUT_KIND_COUNT,
+} InputKind;
+
+typedef struct {
+    Solver solver;
+    float theta;
+    bool block_steps, merge;
+    EscapePolicy escape;
+    float escape_radius;
+} InputSettings;
+
+typedef struct {
+    InputKind kind;
+    // Substeps done by the simulation when the event happened
+    size_t step;
+    union {
+        InputSettings settings;
+        CelestialBody body;
+        ScenarioConfig scenario;
+        const char* path;
+    };
+} InputEvent;
+
+typedef struct {
+    // Private fields
+    FILE* file;
+} InputLog;
+
+// Starts logging into a new file at `path`. `seed` is whatever the session seeded its random
+// numbers with, and `dt` the timestep of every substep. Logs the current settings of `s` as the
+// first event. Returns false if the file couldn't be created.
+bool input_log_open(InputLog* log, const char* path, unsigned seed, float dt, const Simulation* s);
+// Applies `e` to the simulation at its current substep, and logs it if that succeeded. `vm` is
+// used to load scenes, as in `scene_load`. Does the same as `input_apply` if the log isn't open.
+bool input_log_apply(InputLog* log, Simulation* s, InputEvent e, Ext_VmAllocator* vm);
+// Logs the current settings of `s`, to be called after changing any of them. Does nothing if the
+// log isn't open.
+void input_log_settings(InputLog* log, const Simulation* s);
+// Ends the log at the current substep of `s`, along with its checksum, and closes the file
+void input_log_close(InputLog* log, const Simulation* s);
+
+// Applies an event to the simulation, regardless of `e->step`. Only fails to load scenes.
+bool input_apply(Simulation* s, const InputEvent* e, Ext_VmAllocator* vm);
+// Hash of everything the physics depends on: the bodies, the far-field aggregate and the substeps
+uint64_t input_checksum(const Simulation* s);
+
+// Replays the log at `path` into `s`, a simulation fresh from `simulation_init`, stopping at the
+// substep the log ended at. `vm` is used to load scenes, as in `scene_load`. Stores the checksum
+// logged at the end into `expected`, or 0 if the log has no end, i.e. the session crashed.
+// Returns false if the log couldn't be read.
+bool replay_run(const char* path, Simulation* s, Ext_VmAllocator* vm, uint64_t* expected);
+
+#endif
@@ -0,0 +1,169 @@
+#include "runner.h"
+
+#include <string.h>
+
+#include "extlib.h"
+
+// Set in `middle` when it holds a snapshot the reader hasn't picked up yet
+#define RUNNER_FRESH ((size_t)1 << 31)
+// The speed is measured over windows of this many seconds
+#define SPEED_WINDOW (0.5)
+
+// Copies the state of the simulation into the back slot and swaps it with the shared one
+static void publish(Runner* r, double now, float speed) {
+    const CelestialBodies* b = &r->sim->bodies;
+    Snapshot* s = &r->slots[r->back];
+    if(s->capacity < b->size) {
+        size_t newcap = s->capacity ? s->capacity : 256;
+        while(newcap < b->size) newcap *= 2;
+        s->position = ext_realloc(s->position, sizeof(Vector2) * s->capacity,
+                                  sizeof(Vector2) * newcap);
+        s->radius = ext_realloc(s->radius, sizeof(float) * s->capacity, sizeof(float) * newcap);
+        s->color = ext_realloc(s->color, sizeof(Color) * s->capacity, sizeof(Color) * newcap);
+        s->capacity = newcap;
+    }
+    if(b->size) {
+        memcpy(s->position, b->position, sizeof(Vector2) * b->size);
+        memcpy(s->radius, b->radius, sizeof(float) * b->size);
+        memcpy(s->color, b->color, sizeof(Color) * b->size);
+    }
+    s->size = b->size;
+    s->step = r->sim->steps;
+    s->published = now;
+    s->speed = speed;
+    s->active = r->sim->active;
+    s->solver = r->sim->solver;
+    s->theta = r->sim->tree.theta;
+    s->merged = r->sim->merged;
+    s->culled = r->sim->culled;
+    s->generation = r->sim->generation;
+#ifdef SIMULATION_ENERGY
+    s->energy = r->sim->energy;
+#endif
+
+    size_t old = atomic_exchange_explicit(&r->middle, r->back | RUNNER_FRESH, memory_order_acq_rel);
+    r->back = old & ~RUNNER_FRESH;
+}
+
+static void runner_main(void* arg) {
+    Runner* r = arg;
+    // Real time the simulation started from, and simulated time since then
+    double start = thread_clock(), simulated = 0;
+    double window_start = start, window_simulated = 0;
+    float speed = 1;
+
+    mutex_lock(&r->lock);
+    while(!r->shutdown) {
+        if(r->paused) {
+            cond_wait(&r->wake, &r->lock);
+            start = window_start = thread_clock();
+            simulated = window_simulated = 0;
+            continue;
+        }
+
+        double now = thread_clock();
+        double behind = now - start - simulated;
+        if(behind > RUNNER_MAX_LAG) {
+            // Give up on the excess rather than trying to catch up with more substeps, which would
+            // only make the next ones later
+            start += behind - RUNNER_MAX_LAG;
+            behind = RUNNER_MAX_LAG;
+        }
+        if(behind < r->dt) {
+            mutex_unlock(&r->lock);
+            thread_sleep(r->dt - behind);
+            mutex_lock(&r->lock);
+            continue;
+        }
+
+        if(r->tuner) tuner_update(r->tuner, r->sim);
+        simulation_step(r->sim, r->dt);
+        if(r->recorder) {
+            recorder_capture(r->recorder, &r->sim->bodies, r->sim->steps, r->sim->generation);
+        }
+        simulated += r->dt;
+        window_simulated += r->dt;
+
+        now = thread_clock();
+        if(now - window_start >= SPEED_WINDOW) {
+            speed = window_simulated / (now - window_start);
+            window_start = now;
+            window_simulated = 0;
+        }
+        publish(r, now, speed);
+
+        // Callers of `runner_lock` get in between substeps
+        if(atomic_load(&r->waiters)) {
+            mutex_unlock(&r->lock);
+            while(atomic_load(&r->waiters)) thread_yield();
+            mutex_lock(&r->lock);
+        }
+    }
+    mutex_unlock(&r->lock);
+}
+
+void runner_init(Runner* r, Simulation* sim, float dt) {
+    *r = (Runner){.sim = sim, .dt = dt, .back = 0, .front = 2, .prev = 3};
+    atomic_init(&r->middle, 1);
+    atomic_init(&r->waiters, 0);
+    mutex_init(&r->lock);
+    cond_init(&r->wake);
+    publish(r, thread_clock(), 1);
+    if(!thread_create(&r->thread, runner_main, r)) {
+        ext_log(EXT_ERROR, "runner: couldn't start the simulation thread");
+        abort();
+    }
+}
+
+float runner_snapshots(Runner* r, const Snapshot** prev, const Snapshot** cur) {
+    if(atomic_load_explicit(&r->middle, memory_order_relaxed) & RUNNER_FRESH) {
+        // Give back the oldest slot, the latest one becomes the previous
+        size_t fresh = atomic_exchange_explicit(&r->middle, r->prev, memory_order_acq_rel);
+        r->prev = r->front;
+        r->front = fresh & ~RUNNER_FRESH;
+    }
+    *prev = &r->slots[r->prev];
+    *cur = &r->slots[r->front];
+
+    // Move from `prev` to `cur` over the time that separated them, as if drawing one snapshot late
+    double span = (*cur)->published - (*prev)->published;
+    if(span <= 0) return 1;
+    return Clamp((thread_clock() - (*cur)->published) / span, 0, 1);
+}
+
+Simulation* runner_lock(Runner* r) {
+    atomic_fetch_add(&r->waiters, 1);
+    mutex_lock(&r->lock);
+    atomic_fetch_sub(&r->waiters, 1);
+    return r->sim;
+}
+
+void runner_unlock(Runner* r) {
+    mutex_unlock(&r->lock);
+}
+
+void runner_pause(Runner* r, bool paused) {
+    mutex_lock(&r->lock);
+    r->paused = paused;
+    cond_signal(&r->wake);
+    mutex_unlock(&r->lock);
+}
+
+void runner_destroy(Runner* r) {
+    mutex_lock(&r->lock);
+    r->shutdown = true;
+    cond_signal(&r->wake);
+    mutex_unlock(&r->lock);
+    thread_join(&r->thread);
+
+    for(size_t i = 0; i < EXT_ARR_SIZE(r->slots); i++) {
+        Snapshot* s = &r->slots[i];
+        if(!s->capacity) continue;
+        ext_free(s->position, sizeof(Vector2) * s->capacity);
+        ext_free(s->radius, sizeof(float) * s->capacity);
+        ext_free(s->color, sizeof(Color) * s->capacity);
+    }
+    mutex_destroy(&r->lock);
+    cond_destroy(&r->wake);
+    *r = (Runner){0};
+}
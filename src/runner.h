@@ -0,0 +1,112 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "raylib.h"
+#include "raymath.h"
+#include "recorder.h"
+#include "simulation.h"
+#include "thread.h"
+#include "tuner.h"
+
+// Runs a `Simulation` on its own thread, paced to real time.
+// After every substep the thread publishes an immutable snapshot of what's needed to draw the
+// bodies through a lock-free triple buffer, whose reader also keeps the snapshot before the
+// latest one, so that frames can interpolate between the last two without ever waiting on the
+// simulation. Anything else touching the simulation must do so between `runner_lock` and
+// `runner_unlock`.
+// When the simulation can't keep up, it falls behind real time by at most `RUNNER_MAX_LAG`
+// seconds and then slows down instead of piling up more and more substeps.
+// On the web the thread is a Web Worker and the snapshots live in the memory it shares with
+// the page, so the page draws them without anything being copied or posted between the two.
+//
+// USAGE
+// ```c
+// runner_init(&r, &sim, dt);
+// // every frame
+// const Snapshot *prev, *cur;
+// float alpha = runner_snapshots(&r, &prev, &cur);
+// // then to change something
+// Simulation* sim = runner_lock(&r);
+// bodies_push(&sim->bodies, body);
+// runner_unlock(&r);
+// ```
+
+// Largest delay behind real time, in seconds, before the simulation slows down
+#define RUNNER_MAX_LAG (0.1)
+
+typedef struct {
+    size_t size, capacity;
+    Vector2* position;
+    float* radius;
+    Color* color;
+    // Substeps done by the simulation, and when the snapshot was published (see `thread_clock`)
+    size_t step;
+    double published;
+    // Simulated seconds per real second, below 1 when the simulation can't keep up
+    float speed;
+    // Copy of the diagnostics of the simulation
+    size_t active;
+    // Solver and opening angle in use, which the tuner may change
+    Solver solver;
+    float theta;
+    // Bodies merged and culled so far, and `Simulation.generation`
+    size_t merged, culled, generation;
+#ifdef SIMULATION_ENERGY
+    EnergyStats energy;
+#endif
+} Snapshot;
+
+typedef struct {
+    // Captures the bodies after every substep unless NULL. Only to be changed between `runner_lock`
+    // and `runner_unlock`.
+    Recorder* recorder;
+    // Picks the solver before every substep unless NULL (see tuner.h). Only to be changed between
+    // `runner_lock` and `runner_unlock`.
+    Tuner* tuner;
+
+    // Private fields
+    Simulation* sim;
+    float dt;
+    Thread thread;
+    // Held by the simulation thread while stepping, and by callers between lock and unlock
+    Mutex lock;
+    CondVar wake;
+    atomic_size_t waiters;
+    bool paused, shutdown;
+    // Slot being written, shared slot with `RUNNER_FRESH` set when newer than the reader's, and
+    // the reader's latest and previous slots
+    Snapshot slots[4];
+    size_t back;
+    atomic_size_t middle;
+    size_t front, prev;
+} Runner;
+
+// Starts stepping `sim` by `dt` on a new thread. Neither must be moved nor accessed outside of
+// `runner_lock` afterwards.
+void runner_init(Runner* r, Simulation* sim, float dt);
+// Returns the two most recent snapshots seen by the caller and how far between them frames should
+// be drawn now, picking up a newer one if it was published. The snapshots stay valid until the
+// next call. Must always be called from the same thread.
+float runner_snapshots(Runner* r, const Snapshot** prev, const Snapshot** cur);
+// Waits for the substep in progress and gives exclusive access to the simulation
+Simulation* runner_lock(Runner* r);
+void runner_unlock(Runner* r);
+// Stops or resumes stepping. A resumed simulation starts again from real time, without catching
+// up on the time spent paused.
+void runner_pause(Runner* r, bool paused);
+// Stops the thread and frees the snapshots. The simulation itself is left to the caller.
+void runner_destroy(Runner* r);
+
+// Position of body `i` between the snapshots, by `alpha`. Bodies added since `prev` are drawn where
+// they are in `cur`, as are all bodies when they were reordered or replaced in between.
+static inline Vector2 snapshot_position(const Snapshot* prev, const Snapshot* cur, size_t i,
+                                        float alpha) {
+    if(i >= prev->size || prev->generation != cur->generation) return cur->position[i];
+    return Vector2Lerp(prev->position[i], cur->position[i], alpha);
+}
+
+#endif
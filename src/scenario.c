@@ -0,0 +1,182 @@
+#include "scenario.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "extlib.h"
+#include "raymath.h"
+
+const char* const scenario_names[SCENARIO_COUNT] = {
+    [SCENARIO_PLUMMER] = "plummer",
+    [SCENARIO_DISK] = "disk",
+    [SCENARIO_COLLISION] = "collision",
+    [SCENARIO_UNIFORM] = "uniform",
+};
+
+// Default side of the uniform square is this times sqrt(bodies), and the Plummer radius or disk
+// scale length a quarter of it
+#define DEFAULT_SPACING (50.0f)
+#define CLUSTER_SCALE   (0.25f)
+// Enclosed mass fraction beyond which Plummer spheres are cut off, at about 10 Plummer radii
+#define PLUMMER_CUTOFF (0.99f)
+// Core of the disk, relative to the mass of the disk, and spread of the velocities relative to
+// circular ones
+#define DISK_CORE_MASS   (0.5f)
+#define DISK_CORE_RADIUS (40.0f)
+#define DISK_DISPERSION  (0.05f)
+// Colliding clusters start this many Plummer radii apart, off center by one, each moving towards
+// the other at this fraction of the escape velocity of the pair
+#define COLLISION_DISTANCE (6.0f)
+#define COLLISION_SPEED    (0.3f)
+
+// SplitMix64
+static uint64_t rng_next(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static float rng_float(uint64_t* state) {
+    return (rng_next(state) >> 40) * 0x1p-24f;
+}
+
+// Standard normal, by Box-Muller
+static float rng_gaussian(uint64_t* state) {
+    float u = 1 - rng_float(state), v = rng_float(state);
+    return sqrtf(-2 * logf(u)) * cosf(2 * PI * v);
+}
+
+// Grows the bodies by `n` bodies at rest of the default mass and radius, returning the first one.
+// Storage is reserved up front by `scenario_generate`.
+static size_t append(CelestialBodies* b, size_t n, Color color) {
+    size_t first = b->size;
+    bodies_reserve_exact(b, first + n);
+    b->size += n;
+    memset(b->velocity + first, 0, sizeof(Vector2) * n);
+    memset(b->force + first, 0, sizeof(Vector2) * n);
+    memset(b->level + first, 0, n);
+    for(size_t i = first; i < first + n; i++) {
+        b->mass[i] = SCENARIO_BODY_MASS;
+        b->inv_mass[i] = 1 / SCENARIO_BODY_MASS;
+        b->radius[i] = SCENARIO_BODY_RADIUS;
+        b->color[i] = color;
+        b->id[i] = b->next_id++;
+    }
+    return first;
+}
+
+// Moves bodies [first, first + n) so that their center of mass is at `center`, moving at
+// `velocity`
+static void recenter(CelestialBodies* b, size_t first, size_t n, Vector2 center, Vector2 velocity) {
+    double mass = 0, x = 0, y = 0, vx = 0, vy = 0;
+    for(size_t i = first; i < first + n; i++) {
+        mass += b->mass[i];
+        x += (double)b->mass[i] * b->position[i].x;
+        y += (double)b->mass[i] * b->position[i].y;
+        vx += (double)b->mass[i] * b->velocity[i].x;
+        vy += (double)b->mass[i] * b->velocity[i].y;
+    }
+    if(mass <= 0) return;
+    Vector2 dx = {center.x - x / mass, center.y - y / mass};
+    Vector2 dv = {velocity.x - vx / mass, velocity.y - vy / mass};
+    for(size_t i = first; i < first + n; i++) {
+        b->position[i] = Vector2Add(b->position[i], dx);
+        b->velocity[i] = Vector2Add(b->velocity[i], dv);
+    }
+}
+
+static void plummer(CelestialBodies* b, size_t n, float a, Vector2 center, Vector2 velocity,
+                    Color color, uint64_t* rng) {
+    size_t first = append(b, n, color);
+    float mass = SCENARIO_BODY_MASS * n;
+    for(size_t i = first; i < first + n; i++) {
+        // Inverse of the projected enclosed mass fraction r^2 / (r^2 + a^2)
+        float u = rng_float(rng) * PLUMMER_CUTOFF;
+        float r = a * sqrtf(u / (1 - u));
+        float angle = 2 * PI * rng_float(rng);
+        b->position[i] = (Vector2){r * cosf(angle), r * sinf(angle)};
+        // Isotropic velocity dispersion of the sphere at that radius, doubled in variance as the
+        // sphere squashed into the plane is more tightly bound, which keeps it near virial
+        // equilibrium
+        float sigma = sqrtf(G * mass / (3 * sqrtf(r * r + a * a)));
+        b->velocity[i] = (Vector2){sigma * rng_gaussian(rng), sigma * rng_gaussian(rng)};
+    }
+    recenter(b, first, n, center, velocity);
+}
+
+static void disk(CelestialBodies* b, size_t n, float h, Vector2 center, Color color,
+                 uint64_t* rng) {
+    float disk_mass = SCENARIO_BODY_MASS * n, core_mass = DISK_CORE_MASS * disk_mass;
+    size_t core = append(b, 1, BLACK);
+    b->position[core] = (Vector2){0};
+    b->mass[core] = core_mass;
+    b->inv_mass[core] = 1 / core_mass;
+    b->radius[core] = DISK_CORE_RADIUS;
+
+    size_t first = append(b, n, color);
+    for(size_t i = first; i < first + n; i++) {
+        // Surface density exp(-r / h) around the core: r / h is gamma distributed with shape 2
+        float s = -logf((1 - rng_float(rng)) * (1 - rng_float(rng)));
+        float r = 2 * DISK_CORE_RADIUS + h * s;
+        float angle = 2 * PI * rng_float(rng);
+        Vector2 dir = {cosf(angle), sinf(angle)};
+        b->position[i] = Vector2Scale(dir, r);
+
+        // Circular velocity around the core and the part of the disk within r
+        float enclosed = core_mass + disk_mass * (1 - (1 + s) * expf(-s));
+        float v = sqrtf(G * enclosed / r);
+        b->velocity[i] = (Vector2){
+            dir.y * v + DISK_DISPERSION * v * rng_gaussian(rng),
+            -dir.x * v + DISK_DISPERSION * v * rng_gaussian(rng),
+        };
+    }
+    recenter(b, core, n + 1, center, (Vector2){0});
+}
+
+static void uniform(CelestialBodies* b, size_t n, float side, Vector2 center, Color color,
+                    uint64_t* rng) {
+    size_t first = append(b, n, color);
+    for(size_t i = first; i < first + n; i++) {
+        b->position[i] = (Vector2){
+            center.x + (rng_float(rng) - 0.5f) * side,
+            center.y + (rng_float(rng) - 0.5f) * side,
+        };
+    }
+}
+
+void scenario_generate(CelestialBodies* b, const ScenarioConfig* config) {
+    size_t n = config->bodies;
+    if(!n) return;
+    bodies_reserve_exact(b, b->size + n + (config->kind == SCENARIO_DISK));
+
+    uint64_t rng = config->seed;
+    float side = DEFAULT_SPACING * sqrtf((float)n);
+    float scale = config->scale > 0 ? config->scale : side * CLUSTER_SCALE;
+    Vector2 center = config->center;
+
+    switch(config->kind) {
+    case SCENARIO_PLUMMER:
+        plummer(b, n, scale, center, (Vector2){0}, ORANGE, &rng);
+        break;
+    case SCENARIO_DISK:
+        disk(b, n, scale, center, DARKBLUE, &rng);
+        break;
+    case SCENARIO_COLLISION: {
+        // Halves moving at opposite velocities, so that the pair's center of mass stays about at
+        // `center`
+        size_t half = n / 2;
+        float a = scale / sqrtf(2), d = COLLISION_DISTANCE * a;
+        float v = COLLISION_SPEED * sqrtf(2 * G * SCENARIO_BODY_MASS * 2 * half / d);
+        Vector2 offset = {d / 2, a / 2};
+        plummer(b, n - half, a, Vector2Subtract(center, offset), (Vector2){v, 0}, ORANGE, &rng);
+        plummer(b, half, a, Vector2Add(center, offset), (Vector2){-v, 0}, DARKBLUE, &rng);
+    } break;
+    case SCENARIO_UNIFORM:
+        uniform(b, n, config->scale > 0 ? config->scale : side, center, DARKGRAY, &rng);
+        break;
+    default:
+        EXT_UNREACHABLE();
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "body.h"
+#include "raylib.h"
+
+// Procedural initial conditions for any number of bodies, reproducible from a seed.
+// Every scenario fills the body storage in bulk, reserving it once, so even a million bodies are
+// generated in a fraction of a second. Bodies are scattered over about `scale` from `center`,
+// with velocities that roughly keep bound systems in equilibrium.
+//
+// USAGE
+// ```c
+// scenario_generate(&sim.bodies, &(ScenarioConfig){.kind = SCENARIO_PLUMMER, .bodies = 100000});
+// ```
+
+typedef enum {
+    // Plummer sphere seen from above: a cluster with density falling off as (1 + r^2/a^2)^-2,
+    // with isotropic random velocities
+    SCENARIO_PLUMMER,
+    // Rotating disk galaxy: an exponential disk on near circular orbits around a heavy core
+    SCENARIO_DISK,
+    // Two Plummer spheres falling into each other
+    SCENARIO_COLLISION,
+    // Bodies at rest, uniformly spread over a square
+    SCENARIO_UNIFORM,
+    SCENARIO_COUNT,
+} Scenario;
+
+// Command line names of the scenarios
+extern const char* const scenario_names[SCENARIO_COUNT];
+
+// Mass and radius of generated bodies, other than the core of the disk
+#define SCENARIO_BODY_MASS   (4.0f)
+#define SCENARIO_BODY_RADIUS (2.0f)
+
+typedef struct {
+    Scenario kind;
+    size_t bodies;
+    uint64_t seed;
+    Vector2 center;
+    // Characteristic length, e.g. the Plummer radius or the side of the square. 0 picks one
+    // growing as sqrt(bodies), so that the density stays comparable across body counts.
+    float scale;
+} ScenarioConfig;
+
+// Appends the bodies of the scenario to `b`
+void scenario_generate(CelestialBodies* b, const ScenarioConfig* config);
+
+#endif
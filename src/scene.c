@@ -0,0 +1,185 @@
+#include "scene.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef EXT_WINDOWS
+#define fseeko _fseeki64
+#endif
+
+enum {
+#define X(T, name) FIELD_##name,
+    CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    FIELD_COUNT,
+};
+EXT_STATIC_ASSERT(FIELD_COUNT <= SCENE_MAX_FIELDS, "too many body fields for the scene header");
+
+static uint64_t aligned(uint64_t size) {
+    return size + EXT_ALIGN(size, SCENE_ALIGNMENT);
+}
+
+// Writes `size` bytes, followed by zeros up to the next multiple of SCENE_ALIGNMENT
+static bool write_aligned(FILE* f, const void* data, size_t size) {
+    static const char zeros[4096];
+    if(size && fwrite(data, 1, size, f) != size) return false;
+    for(size_t pad = EXT_ALIGN(size, SCENE_ALIGNMENT); pad > 0;) {
+        size_t n = pad < sizeof(zeros) ? pad : sizeof(zeros);
+        if(fwrite(zeros, 1, n, f) != n) return false;
+        pad -= n;
+    }
+    return true;
+}
+
+bool scene_save(const char* path, const CelestialBodies* b, size_t steps) {
+    SceneHeader h = {
+        .magic = SCENE_MAGIC,
+        .version = SCENE_VERSION,
+        .byte_order = SCENE_BYTE_ORDER,
+        .bodies = b->size,
+        .steps = steps,
+        .field_count = FIELD_COUNT,
+    };
+    uint64_t offset = aligned(sizeof(h));
+#define X(T, name)                                    \
+    h.fields[FIELD_##name].offset = offset;           \
+    h.fields[FIELD_##name].element_size = sizeof(T);  \
+    offset += aligned((uint64_t)sizeof(T) * b->size);
+    CELESTIAL_BODIES_FIELDS(X)
+#undef X
+
+    // Written next to the old scene first, so that a failed save doesn't lose it
+    size_t len = strlen(path);
+    char* tmp = ext_alloc(len + 5);
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    FILE* f = fopen(tmp, "wb");
+    bool ok = f && write_aligned(f, &h, sizeof(h));
+#define X(T, name) ok = ok && write_aligned(f, b->name, sizeof(T) * b->size);
+    CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    if(!ok) ext_log(EXT_ERROR, "couldn't write scene %s: %s", tmp, strerror(errno));
+    if(f && fclose(f) != 0 && ok) {
+        ext_log(EXT_ERROR, "couldn't write scene %s: %s", tmp, strerror(errno));
+        ok = false;
+    }
+    if(ok) {
+        ok = ext_rename_file(tmp, path);
+    } else if(f) {
+        remove(tmp);
+    }
+    ext_free(tmp, len + 5);
+    return ok;
+}
+
+static bool check_header(const SceneHeader* h, const char* path) {
+    const char* error = NULL;
+    if(memcmp(h->magic, SCENE_MAGIC, sizeof(h->magic)) != 0) {
+        error = "not a scene file";
+    } else if(h->version != SCENE_VERSION) {
+        error = "unsupported version";
+    } else if(h->byte_order != SCENE_BYTE_ORDER) {
+        error = "saved with another byte order";
+    } else if(h->field_count != FIELD_COUNT || h->bodies > SIZE_MAX / 64) {
+        error = "unsupported layout";
+    }
+#define X(T, name)                                                    \
+    if(!error && (h->fields[FIELD_##name].element_size != sizeof(T) || \
+                  h->fields[FIELD_##name].offset % SCENE_ALIGNMENT)) { \
+        error = "unsupported layout";                                 \
+    }
+    CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    if(error) ext_log(EXT_ERROR, "couldn't load scene %s: %s", path, error);
+    return !error;
+}
+
+static void* load_array(FILE* f, const char* path, Ext_VmAllocator* vm, Ext_Allocator* a,
+                        uint64_t offset, size_t size) {
+    if(vm) return ext_vm_map_file(vm, path, offset, size);
+    void* mem = a->alloc(a, size);
+    if(fseeko(f, offset, SEEK_SET) < 0 || fread(mem, 1, size, f) != size) {
+        ext_log(EXT_ERROR, "couldn't load scene %s: %s", path,
+                ferror(f) ? strerror(errno) : "truncated file");
+        a->free(a, mem, size);
+        return NULL;
+    }
+    return mem;
+}
+
+bool scene_load(const char* path, CelestialBodies* b, Ext_VmAllocator* vm, size_t* steps) {
+    FILE* f = fopen(path, "rb");
+    if(!f) {
+        ext_log(EXT_ERROR, "couldn't load scene %s: %s", path, strerror(errno));
+        return false;
+    }
+    SceneHeader h;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1;
+    if(!ok) ext_log(EXT_ERROR, "couldn't load scene %s: truncated file", path);
+    ok = ok && check_header(&h, path);
+
+    CelestialBodies loaded = {.allocator = b->allocator ? b->allocator : ext_context->alloc};
+    if(ok && h.bodies) {
+        loaded.size = loaded.capacity = h.bodies;
+#define X(T, name)                                                                              \
+    if(ok) {                                                                                    \
+        loaded.name = load_array(f, path, vm, loaded.allocator, h.fields[FIELD_##name].offset, \
+                                 sizeof(T) * h.bodies);                                         \
+        ok = loaded.name != NULL;                                                               \
+    }
+        CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    }
+    fclose(f);
+
+    if(!ok) {
+        bodies_free(&loaded);
+        return false;
+    }
+    for(size_t i = 0; i < loaded.size; i++) {
+        if(loaded.id[i] >= loaded.next_id) loaded.next_id = loaded.id[i] + 1;
+    }
+    bodies_free(b);
+    *b = loaded;
+    *steps = h.steps;
+    return true;
+}
+
+static void writer_job(void* arg) {
+    SceneWriter* w = arg;
+    w->ok = scene_save(w->path, &w->bodies, w->steps);
+    atomic_store_explicit(&w->done, true, memory_order_release);
+}
+
+bool scene_writer_save(SceneWriter* w, const char* path, const CelestialBodies* b, size_t steps) {
+    if(w->running) return false;
+    bodies_copy(&w->bodies, b);
+    w->steps = steps;
+    if(w->path) ext_free(w->path, strlen(w->path) + 1);
+    w->path = ext_strdup(path);
+    atomic_store_explicit(&w->done, false, memory_order_relaxed);
+    if(!thread_create(&w->thread, writer_job, w)) {
+        ext_log(EXT_ERROR, "couldn't start saving scene %s", path);
+        return false;
+    }
+    w->running = true;
+    return true;
+}
+
+bool scene_writer_poll(SceneWriter* w, bool* ok) {
+    if(!w->running || !atomic_load_explicit(&w->done, memory_order_acquire)) return false;
+    thread_join(&w->thread);
+    w->running = false;
+    *ok = w->ok;
+    return true;
+}
+
+void scene_writer_destroy(SceneWriter* w) {
+    if(w->running) thread_join(&w->thread);
+    w->running = false;
+    bodies_free(&w->bodies);
+    if(w->path) ext_free(w->path, strlen(w->path) + 1);
+    w->path = NULL;
+}
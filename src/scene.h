@@ -0,0 +1,81 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "body.h"
+#include "extlib.h"
+#include "thread.h"
+
+// Binary scene files, to save simulations and resume them later.
+// A scene is a header followed by the raw arrays of `CelestialBodies`, in the order of
+// `CELESTIAL_BODIES_FIELDS` and in native byte order. The header and every array start at a
+// multiple of `SCENE_ALIGNMENT`, a multiple of the page size of every supported system, so that
+// loading can map the arrays straight into body storage without parsing anything.
+//
+// USAGE
+// ```c
+// scene_save("scene.grav", &sim.bodies, sim.steps);
+// // ... later
+// VmAllocator vm = new_vm_allocator();
+// sim.bodies.allocator = &vm.base;
+// size_t steps;
+// if(scene_load("scene.grav", &sim.bodies, &vm, &steps)) sim.steps = steps;
+// ```
+
+#define SCENE_MAGIC     "GRAVSCN"
+#define SCENE_VERSION   (3)
+#define SCENE_ALIGNMENT (64 * 1024)
+// Written into `SceneHeader.byte_order`, to reject files saved on a system of the other endianness
+#define SCENE_BYTE_ORDER (0x01020304u)
+#define SCENE_MAX_FIELDS (16)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t bodies;
+    // Substeps done by the simulation when saved, which block timesteps are aligned to
+    uint64_t steps;
+    uint32_t field_count;
+    uint32_t reserved;
+    // Where each array starts in the file, and the size of its elements
+    struct {
+        uint64_t offset;
+        uint32_t element_size;
+        uint32_t reserved;
+    } fields[SCENE_MAX_FIELDS];
+} SceneHeader;
+
+// Writes the bodies to `path`, along with the substeps done by their simulation. The file is only
+// replaced once fully written. Returns false on failure.
+bool scene_save(const char* path, const CelestialBodies* b, size_t steps);
+// Replaces the bodies with the ones saved at `path` and stores the substeps done when saved into
+// `steps`. Unless `vm` is NULL, it must be the allocator of the bodies, and the arrays are then
+// mapped from the file rather than read (see `ext_vm_map_file`). Returns false on failure, leaving
+// the bodies untouched.
+bool scene_load(const char* path, CelestialBodies* b, Ext_VmAllocator* vm, size_t* steps);
+
+// Saves scenes in the background. The bodies are copied when a save starts, so the simulation can
+// keep running while the copy is written out. Ready to use when zero initialized.
+typedef struct {
+    // Private fields
+    Thread thread;
+    bool running, ok;
+    atomic_bool done;
+    CelestialBodies bodies;
+    size_t steps;
+    char* path;
+} SceneWriter;
+
+// Starts saving a copy of the bodies to `path`. Returns false if the previous save isn't over yet.
+bool scene_writer_save(SceneWriter* w, const char* path, const CelestialBodies* b, size_t steps);
+// Returns true once for every finished save, storing whether it succeeded into `ok`
+bool scene_writer_poll(SceneWriter* w, bool* ok);
+// Waits for the save in progress, if any, and frees the copy of the bodies
+void scene_writer_destroy(SceneWriter* w);
+
+#endif
@@ -0,0 +1,527 @@
+#include "simulation.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "extlib.h"
+#include "kernel.h"
+#include "profiler.h"
+
+const char* const solver_names[SOLVER_COUNT] = {
+    [SOLVER_DIRECT] = "Direct",
+    [SOLVER_DIRECT_SIMD] = "Direct SIMD",
+    [SOLVER_BARNES_HUT] = "Barnes-Hut",
+    [SOLVER_PARTICLE_MESH] = "Particle-mesh",
+    [SOLVER_P3M] = "P3M",
+};
+
+const char* const integrator_name =
+#if INTEGRATOR == INTEGRATOR_VERLET
+    "Verlet";
+#elif INTEGRATOR == INTEGRATOR_YOSHIDA4
+    "Yoshida";
+#else
+    "Forest-Ruth";
+#endif
+
+const char* const solver_keys[SOLVER_COUNT] = {
+    [SOLVER_DIRECT] = "direct",
+    [SOLVER_DIRECT_SIMD] = "simd",
+    [SOLVER_BARNES_HUT] = "barnes-hut",
+    [SOLVER_PARTICLE_MESH] = "pm",
+    [SOLVER_P3M] = "p3m",
+};
+
+static Vector2 compute_gravitational_force(Vector2 p1, float m1, Vector2 p2, float m2) {
+    // F = G * (m1 * m2 / r^2)
+    Vector2 r = Vector2Subtract(p2, p1);
+    float r2 = fmaxf(Vector2LengthSqr(r), 1e-6f);
+    r = Vector2Scale(r, 1 / sqrt(r2));
+    return Vector2Scale(r, G * (m1 * m2) / r2);
+}
+
+Vector2 apply_forces(const Vector2* positions, const float* masses, size_t count, Vector2 pos,
+                     float m, size_t self, float* potential) {
+    Vector2 force = {0};
+    float u = 0;
+    for(size_t j = 0; j < count; j++) {
+        if(j != self) {
+            Vector2 f = compute_gravitational_force(pos, m, positions[j], masses[j]);
+            force = Vector2Add(force, f);
+            // U = -G * (m1 * m2 / r)
+            if(potential) {
+                float r2 = fmaxf(Vector2DistanceSqr(positions[j], pos), 1e-6f);
+                u -= G * (m * masses[j]) / sqrtf(r2);
+            }
+        }
+    }
+    if(potential) *potential = u;
+    return force;
+}
+
+#ifdef SIMULATION_ENERGY
+// Where the force jobs store the potential energy of body `i`, or NULL if not sampling
+#define POTENTIAL(sim, i) ((sim)->sampling ? &(sim)->potential[i] : NULL)
+#else
+#define POTENTIAL(sim, i) NULL
+#endif
+
+// Index of the `k`-th body whose step ends at this substep
+#define ACTIVE(sim, k) ((sim)->active_list ? (size_t)(sim)->active_list[k] : (k))
+
+// Length of the step of body `i`
+static inline float body_step(const Simulation* sim, size_t i) {
+    return sim->blocks ? sim->dt * (float)(1u << sim->bodies.level[i]) : sim->dt;
+}
+
+#if INTEGRATOR == INTEGRATOR_VERLET
+// Whether the step of body `i` starts at this substep
+static inline bool step_starts(const Simulation* sim, size_t i) {
+    return !sim->blocks || sim->steps % (1u << sim->bodies.level[i]) == 0;
+}
+
+// Level of the next step of active body `i`, from BLOCK_ETA * |a| / |da/dt| with the jerk
+// estimated from `old_force`, the force at the start of the step that just ended
+static uint8_t next_level(const Simulation* sim, size_t i, Vector2 old_force) {
+    const CelestialBodies* b = &sim->bodies;
+    uint8_t level = b->level[i];
+    float step = sim->dt * (float)(1u << level);
+    float df = Vector2Length(Vector2Subtract(b->force[i], old_force));
+    float target = df > 0 ? BLOCK_ETA * Vector2Length(b->force[i]) * step / df : INFINITY;
+
+    // Go up at most one level at a time, and only where a step of the coarser level starts
+    size_t tick = sim->steps + 1;
+    if(level < BLOCK_MAX_LEVEL && tick % ((size_t)2 << level) == 0 && 2 * step <= target) {
+        return level + 1;
+    }
+    while(level > 0 && sim->dt * (float)(1u << level) > target) level--;
+    return level;
+}
+#endif
+
+// Adds the pull of the far-field aggregate to the active bodies [start, end)
+static void far_field_forces(Simulation* sim, size_t start, size_t end) {
+    if(sim->far.mass <= 0) return;
+    CelestialBodies* b = &sim->bodies;
+    for(size_t k = start; k < end; k++) {
+        size_t i = ACTIVE(sim, k);
+        float* potential = POTENTIAL(sim, i);
+        float u;
+        Vector2 f = far_field_force(&sim->far, b->position[i], b->mass[i], potential ? &u : NULL);
+        b->force[i] = Vector2Add(b->force[i], f);
+        // Doubled, as the pair isn't also counted from the aggregate's side
+        if(potential) *potential += 2 * u;
+    }
+}
+
+// Every job below only writes to the bodies in its own [start, end) range, so results don't depend
+// on the number of workers nor on how chunks are scheduled.
+
+#ifdef SIMULATION_ENERGY
+EXT_STATIC_ASSERT(INTEGRATE_CHUNK % FORCE_CHUNK == 0, "energy is summed per FORCE_CHUNK bodies");
+
+// Reduces the energy of the bodies [start, end) into one partial sum per FORCE_CHUNK bodies.
+// Ranges always start at multiples of FORCE_CHUNK, so the partial sums and thus the totals don't
+// depend on the number of workers either.
+static void sum_energy(Simulation* sim, size_t start, size_t end) {
+    const CelestialBodies* b = &sim->bodies;
+    for(size_t c = start; c < end; c += FORCE_CHUNK) {
+        size_t c_end = c + FORCE_CHUNK < end ? c + FORCE_CHUNK : end;
+        double kinetic = 0, potential = 0;
+        for(size_t i = c; i < c_end; i++) {
+            kinetic += 0.5 * b->mass[i] * Vector2LengthSqr(b->velocity[i]);
+            potential += sim->potential[i];
+        }
+        double* e = &sim->chunk_energy[2 * (c / FORCE_CHUNK)];
+        e[0] = kinetic;
+        // Every pair's potential energy is counted by both bodies
+        e[1] = 0.5 * potential;
+    }
+}
+#endif
+
+#if INTEGRATOR == INTEGRATOR_VERLET
+// Velocity Verlet runs as kick-drift-kick in two passes. This one opens the steps starting at this
+// substep with their first half kick, and drifts every body. The force pass then closes the steps
+// ending at this substep with their second half kick, block by block right after computing their
+// forces, while the bodies are still in cache.
+static void drift_job(void* ctx, size_t start, size_t end) {
+    Simulation* sim = ctx;
+    CelestialBodies* b = &sim->bodies;
+    for(size_t i = start; i < end; i++) {
+        if(step_starts(sim, i)) {
+            b->velocity[i] = kick_vel(b->velocity[i], b->force[i], b->inv_mass[i],
+                                      0.5f * body_step(sim, i));
+        }
+        b->position[i] = drift_pos(b->position[i], b->velocity[i], sim->dt);
+    }
+}
+
+// Closes the steps of the active bodies [start, end), whose forces were just computed: second half
+// kick, level of the next step, and energy on sampled substeps
+static void close_steps(Simulation* sim, size_t start, size_t end, const Vector2* old_force) {
+    CelestialBodies* b = &sim->bodies;
+    for(size_t k = start; k < end; k++) {
+        size_t i = ACTIVE(sim, k);
+        b->velocity[i] = kick_vel(b->velocity[i], b->force[i], b->inv_mass[i],
+                                  0.5f * body_step(sim, i));
+        if(sim->blocks) b->level[i] = next_level(sim, i, old_force[k - start]);
+    }
+
+#ifdef SIMULATION_ENERGY
+    // Samples are only taken while all bodies are in sync, so here i = k
+    if(sim->sampling) sum_energy(sim, start, end);
+#endif
+}
+#endif
+
+// Index of the `k`-th of `targets`, or `k` if it's NULL
+#define TARGET(targets, k) ((targets) ? (size_t)(targets)[k] : (k))
+
+// Forces of `solver` on the bodies `targets[start..end)` into `out`, and their potential energy
+// into `potential` unless it's NULL, both indexed by body. `targets` can be NULL to process
+// [start, end) directly. The tree or the mesh must be built for `solver`.
+static void solver_forces(const Simulation* sim, Solver solver, const uint32_t* targets,
+                          size_t start, size_t end, Vector2* out, float* potential) {
+    const CelestialBodies* b = &sim->bodies;
+    switch(solver) {
+    case SOLVER_DIRECT:
+        for(size_t k = start; k < end; k++) {
+            size_t i = TARGET(targets, k);
+            out[i] = apply_forces(b->position, b->mass, b->size, b->position[i], b->mass[i], i,
+                                  potential ? &potential[i] : NULL);
+        }
+        break;
+    case SOLVER_DIRECT_SIMD:
+        kernel_forces_indexed(b, targets, start, end, out, potential);
+        break;
+    case SOLVER_BARNES_HUT:
+        for(size_t k = start; k < end; k++) {
+            size_t i = TARGET(targets, k);
+            out[i] = quadtree_force(&sim->tree, b, i, potential ? &potential[i] : NULL);
+        }
+        break;
+    case SOLVER_PARTICLE_MESH:
+    case SOLVER_P3M:
+        for(size_t k = start; k < end; k++) {
+            size_t i = TARGET(targets, k);
+            out[i] = pm_force(&sim->mesh, b, i, potential ? &potential[i] : NULL);
+        }
+        break;
+    case SOLVER_COUNT:
+        UNREACHABLE();
+    }
+}
+
+static void forces_job(void* ctx, size_t start, size_t end) {
+    Simulation* sim = ctx;
+    CelestialBodies* b = &sim->bodies;
+#if INTEGRATOR == INTEGRATOR_VERLET
+    // The forces being replaced, for the jerk estimate of block timesteps
+    Vector2 old_force[FORCE_CHUNK];
+    EXT_ASSERT(end - start <= FORCE_CHUNK, "force jobs must not exceed FORCE_CHUNK bodies");
+    if(sim->blocks) {
+        for(size_t k = start; k < end; k++) old_force[k - start] = b->force[ACTIVE(sim, k)];
+    }
+#endif
+
+    solver_forces(sim, sim->solver, sim->active_list, start, end, b->force, POTENTIAL(sim, 0));
+    far_field_forces(sim, start, end);
+
+#if INTEGRATOR == INTEGRATOR_VERLET
+    close_steps(sim, start, end, old_force);
+#endif
+}
+
+#if INTEGRATOR != INTEGRATOR_VERLET
+// Composition methods: a sequence of stages, each kicking the velocities with the latest forces
+// then drifting the positions, with a force pass after every stage but the last. Every stage gets
+// its own job with its coefficients as constants, so the loops carry no branches nor lookups.
+// Kicks and drifts are in units of the substep; each sums to 1 over the stages.
+
+// Triple jump: Verlet steps of W1, W0 and W1 substeps cancel each other's third order errors
+#define W1 (1.3512071919596578f)
+#define W0 (-1.7024143839193153f)
+#if INTEGRATOR == INTEGRATOR_YOSHIDA4
+// Of velocity Verlet steps. The last force pass is at the final positions, so it doubles as the
+// first of the next substep: 3 force passes per substep.
+#define INTEGRATOR_STAGES(X) \
+    X(0, W1 / 2, W1) X(1, (W0 + W1) / 2, W0) X(2, (W0 + W1) / 2, W1)
+#define INTEGRATOR_LAST(X) X(3, W1 / 2, 0)
+#define INTEGRATOR_FINAL_FORCES (true)
+#elif INTEGRATOR == INTEGRATOR_FOREST_RUTH
+// Of position Verlet steps (Forest-Ruth). The forces at the start go unused but the last drift
+// comes after the last force pass, so sampled substeps take a 4th one for the potential energy.
+#define INTEGRATOR_STAGES(X) \
+    X(0, 0, W1 / 2) X(1, W1, (W0 + W1) / 2) X(2, W0, (W0 + W1) / 2)
+#define INTEGRATOR_LAST(X) X(3, W1, W1 / 2)
+#define INTEGRATOR_FINAL_FORCES (false)
+#else
+#error "unknown INTEGRATOR, see simulation.h"
+#endif
+
+static inline void kick_drift(Simulation* sim, size_t start, size_t end, float kick,
+                              float drift) {
+    CelestialBodies* b = &sim->bodies;
+    float kick_dt = kick * sim->dt, drift_dt = drift * sim->dt;
+    for(size_t i = start; i < end; i++) {
+        if(kick != 0) {
+            b->velocity[i] = kick_vel(b->velocity[i], b->force[i], b->inv_mass[i], kick_dt);
+        }
+        if(drift != 0) b->position[i] = drift_pos(b->position[i], b->velocity[i], drift_dt);
+    }
+}
+
+#define X(k, kick, drift)                                             \
+    static void stage##k##_job(void* ctx, size_t start, size_t end) { \
+        kick_drift(ctx, start, end, (kick), (drift));                 \
+    }
+INTEGRATOR_STAGES(X)
+INTEGRATOR_LAST(X)
+#undef X
+
+#ifdef SIMULATION_ENERGY
+static void energy_job(void* ctx, size_t start, size_t end) {
+    sum_energy(ctx, start, end);
+}
+#endif
+#endif  // INTEGRATOR
+
+#ifdef SIMULATION_ENERGY
+static void reserve_energy(Simulation* sim, size_t n) {
+    if(n <= sim->energy_capacity) return;
+    size_t newcap = sim->energy_capacity ? sim->energy_capacity : FORCE_CHUNK;
+    while(newcap < n) newcap *= 2;
+    // Capacities are multiples of FORCE_CHUNK, two partial sums per chunk
+    size_t old_chunks = sim->energy_capacity / FORCE_CHUNK;
+    size_t new_chunks = newcap / FORCE_CHUNK;
+    sim->potential = ext_realloc(sim->potential, sizeof(float) * sim->energy_capacity,
+                                 sizeof(float) * newcap);
+    sim->chunk_energy = ext_realloc(sim->chunk_energy, sizeof(double) * 2 * old_chunks,
+                                    sizeof(double) * 2 * new_chunks);
+    sim->energy_capacity = newcap;
+}
+
+static void record_energy(Simulation* sim) {
+    double kinetic = 0, potential = 0;
+    for(size_t c = 0; c < (sim->bodies.size + FORCE_CHUNK - 1) / FORCE_CHUNK; c++) {
+        kinetic += sim->chunk_energy[2 * c];
+        potential += sim->chunk_energy[2 * c + 1];
+    }
+    kinetic += 0.5 * sim->far.mass * Vector2LengthSqr(sim->far.velocity);
+
+    EnergyStats* st = &sim->energy;
+    double total = kinetic + potential;
+    if(!st->samples) st->initial = total;
+    st->kinetic = kinetic;
+    st->potential = potential;
+    st->total = total;
+    st->drift = st->initial != 0 ? (total - st->initial) / fabs(st->initial) : 0;
+    st->max_drift = fmax(st->max_drift, fabs(st->drift));
+    st->samples++;
+    st->mean_drift += (fabs(st->drift) - st->mean_drift) / st->samples;
+}
+
+// Takes `energy` removed from the bodies on purpose, by merging or culling them, out of the
+// reference too, so that the drift keeps measuring the error of the integration alone
+static void remove_energy(Simulation* sim, double energy) {
+    if(sim->energy.samples) sim->energy.initial -= energy;
+}
+
+void simulation_reset_energy(Simulation* sim) {
+    sim->energy = (EnergyStats){0};
+    sim->next_sample = sim->steps;
+}
+#endif
+
+void simulation_init(Simulation* sim, size_t workers) {
+    *sim = (Simulation){
+        .solver = SOLVER_BARNES_HUT,
+        .tree = quadtree_new(),
+        .mesh = pm_new(),
+        .escape_radius = ESCAPE_DEFAULT_RADIUS,
+        .reorder = true,
+    };
+    jobs_init(&sim->pool, workers);
+}
+
+// Collects the bodies whose step ends at this substep into `active_list`, which is left NULL if
+// that's all of them
+static void collect_active(Simulation* sim) {
+    const CelestialBodies* b = &sim->bodies;
+    sim->active_list = NULL;
+    sim->active = b->size;
+    size_t tick = sim->steps + 1;
+    if(!sim->blocks || tick % (1u << BLOCK_MAX_LEVEL) == 0) return;
+
+    if(sim->active_capacity < b->size) {
+        size_t newcap = sim->active_capacity ? sim->active_capacity : 256;
+        while(newcap < b->size) newcap *= 2;
+        sim->active_buf = ext_realloc(sim->active_buf, sizeof(uint32_t) * sim->active_capacity,
+                                      sizeof(uint32_t) * newcap);
+        sim->active_capacity = newcap;
+    }
+    size_t count = 0;
+    for(size_t i = 0; i < b->size; i++) {
+        if(tick % (1u << b->level[i]) == 0) sim->active_buf[count++] = i;
+    }
+    sim->active_list = sim->active_buf;
+    sim->active = count;
+}
+
+void simulation_prepare_solver(Simulation* sim, Solver solver) {
+    if(solver == SOLVER_BARNES_HUT) quadtree_build(&sim->tree, &sim->bodies);
+    if(solver == SOLVER_PARTICLE_MESH || solver == SOLVER_P3M) {
+        sim->mesh.short_range = solver == SOLVER_P3M;
+        pm_build(&sim->mesh, &sim->bodies, &sim->pool);
+    }
+}
+
+typedef struct {
+    const Simulation* sim;
+    Solver solver;
+    const uint32_t* targets;
+    Vector2* out;
+} TrialForces;
+
+static void trial_forces_job(void* ctx, size_t start, size_t end) {
+    const TrialForces* trial = ctx;
+    solver_forces(trial->sim, trial->solver, trial->targets, start, end, trial->out, NULL);
+}
+
+void simulation_solver_forces(Simulation* sim, Solver solver, const uint32_t* targets,
+                              size_t count, Vector2* out) {
+    TrialForces trial = {sim, solver, targets, out};
+    jobs_parallel_for(&sim->pool, count, FORCE_CHUNK, trial_forces_job, &trial);
+}
+
+// Computes the forces on the active bodies, and their potential energy on sampled substeps. With
+// Verlet, also closes their steps.
+static void compute_forces(Simulation* sim) {
+    PROFILE(PROFILE_FORCES) {
+        if(sim->active) {
+            simulation_prepare_solver(sim, sim->solver);
+            jobs_parallel_for(&sim->pool, sim->active, FORCE_CHUNK, forces_job, sim);
+        }
+    }
+}
+
+#if INTEGRATOR != INTEGRATOR_VERLET
+// Steps all `n` bodies with the stages of the integrator
+static void integrate(Simulation* sim, size_t n) {
+#define X(k, kick, drift)                                                       \
+    PROFILE(PROFILE_INTEGRATE_POS) {                                            \
+        jobs_parallel_for(&sim->pool, n, INTEGRATE_CHUNK, stage##k##_job, sim); \
+    }                                                                           \
+    compute_forces(sim);
+    INTEGRATOR_STAGES(X)
+#undef X
+#define X(k, kick, drift)                                                       \
+    PROFILE(PROFILE_INTEGRATE_VEL) {                                            \
+        jobs_parallel_for(&sim->pool, n, INTEGRATE_CHUNK, stage##k##_job, sim); \
+    }
+    INTEGRATOR_LAST(X)
+#undef X
+
+#ifdef SIMULATION_ENERGY
+    if(sim->sampling) {
+        if(!INTEGRATOR_FINAL_FORCES) compute_forces(sim);
+        jobs_parallel_for(&sim->pool, n, INTEGRATE_CHUNK, energy_job, sim);
+    }
+#endif
+}
+#endif
+
+void simulation_step(Simulation* sim, float dt) {
+    size_t n = sim->bodies.size;
+    sim->dt = dt;
+    // Scratch memory of the jobs only lives for a substep
+    jobs_reset_scratch(&sim->pool);
+
+#if INTEGRATOR == INTEGRATOR_VERLET
+    // Turning block timesteps off has to wait until all bodies are in sync, where every step is
+    // over. Bodies start over from the finest level when turning them on.
+    bool in_sync = sim->steps % (1u << BLOCK_MAX_LEVEL) == 0;
+    if(sim->block_steps != sim->blocks && (in_sync || !sim->blocks)) {
+        sim->blocks = sim->block_steps;
+        if(sim->blocks && n) memset(sim->bodies.level, 0, n);
+    }
+#endif
+
+#ifdef SIMULATION_ENERGY
+    // With block timesteps, wait for the bodies to be in sync at the end of the substep
+    bool synced = !sim->blocks || (sim->steps + 1) % (1u << BLOCK_MAX_LEVEL) == 0;
+    sim->sampling = sim->energy_interval && sim->steps >= sim->next_sample && synced;
+    if(sim->sampling) {
+        reserve_energy(sim, n);
+        sim->next_sample = sim->steps + sim->energy_interval;
+    }
+#endif
+
+#if INTEGRATOR == INTEGRATOR_VERLET
+    PROFILE(PROFILE_INTEGRATE_POS) {
+        jobs_parallel_for(&sim->pool, n, INTEGRATE_CHUNK, drift_job, sim);
+    }
+    collect_active(sim);
+    compute_forces(sim);
+#else
+    collect_active(sim);
+    integrate(sim, n);
+#endif
+
+#ifdef SIMULATION_ENERGY
+    if(sim->sampling) record_energy(sim);
+#endif
+
+    if(sim->merge) {
+        // With block timesteps only the bodies whose step just ended have an up to date velocity
+        double removed = 0;
+        size_t merged = collisions_merge(&sim->collisions, &sim->bodies,
+                                         sim->blocks ? sim->steps + 1 : 0, &removed);
+        sim->merged += merged;
+        if(merged) sim->generation++;
+#ifdef SIMULATION_ENERGY
+        remove_energy(sim, removed);
+#endif
+    }
+
+    bool check_escape = sim->escape != ESCAPE_KEEP || sim->far.mass > 0;
+    if(check_escape && (sim->steps + 1) % ESCAPE_INTERVAL == 0) {
+        double removed = 0;
+        size_t culled = escape_cull(&sim->bodies, sim->escape, sim->escape_radius, &sim->far,
+                                    &removed);
+        sim->culled += culled;
+        if(culled) sim->generation++;
+#ifdef SIMULATION_ENERGY
+        remove_energy(sim, removed);
+#endif
+    }
+    if(sim->reorder && spatial_order_update(&sim->order, &sim->bodies, sim->steps + 1)) {
+        sim->generation++;
+    }
+    far_field_step(&sim->far, dt);
+    sim->steps++;
+}
+
+void simulation_set_workers(Simulation* sim, size_t workers) {
+    jobs_destroy(&sim->pool);
+    jobs_init(&sim->pool, workers);
+}
+
+void simulation_destroy(Simulation* sim) {
+    jobs_destroy(&sim->pool);
+    if(sim->active_buf) ext_free(sim->active_buf, sizeof(uint32_t) * sim->active_capacity);
+#ifdef SIMULATION_ENERGY
+    if(sim->energy_capacity) {
+        size_t chunks = sim->energy_capacity / FORCE_CHUNK;
+        ext_free(sim->potential, sizeof(float) * sim->energy_capacity);
+        ext_free(sim->chunk_energy, sizeof(double) * 2 * chunks);
+    }
+#endif
+    collisions_destroy(&sim->collisions);
+    quadtree_destroy(&sim->tree);
+    pm_destroy(&sim->mesh);
+    spatial_order_destroy(&sim->order);
+    bodies_free(&sim->bodies);
+}
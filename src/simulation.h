@@ -0,0 +1,195 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "body.h"
+#include "collision.h"
+#include "escape.h"
+#include "jobs.h"
+#include "order.h"
+#include "pm.h"
+#include "quadtree.h"
+#include "raylib.h"
+#include "raymath.h"
+
+// The physics core, independent of any window or rendering, shared by the interactive program and
+// the headless benchmark.
+
+// Substeps per simulated second, configurable with `-DSIMULATION_STEPS=...`
+#ifndef SIMULATION_STEPS
+#define SIMULATION_STEPS (120)
+#endif
+
+// Time integrators, one picked at compile time with `-DINTEGRATOR=...`, each stepping the bodies
+// with a loop specialized for it.
+// - Velocity Verlet: second order, one force pass per substep, the only one with block timesteps
+// - Yoshida: fourth order composition of velocity Verlet steps, three force passes per substep
+// - Forest-Ruth: fourth order composition of position Verlet steps, three force passes per substep
+// Both fourth order methods are symplectic, and for a given energy error they allow substeps so
+// much longer they end up needing fewer force passes. The spawn preview and the GPU solver always
+// use Verlet.
+#define INTEGRATOR_VERLET      (0)
+#define INTEGRATOR_YOSHIDA4    (1)
+#define INTEGRATOR_FOREST_RUTH (2)
+#ifndef INTEGRATOR
+#define INTEGRATOR INTEGRATOR_VERLET
+#endif
+// Bodies per job. Integration is cheap and memory bound, so it is split coarsely; force
+// evaluation is O(N) or O(log N) per body, so smaller chunks keep the workers balanced.
+#define INTEGRATE_CHUNK (1024)
+#define FORCE_CHUNK     (64)
+
+// Block timesteps. When enabled, each body advances with its own timestep of the substep times
+// 2^level, up to 2^BLOCK_MAX_LEVEL, picked from its acceleration and jerk as
+// BLOCK_ETA * |a| / |da/dt|. Every substep all bodies drift, but only those whose step ends get
+// their forces recomputed. Steps of a level always start at multiples of 2^level substeps, so
+// every 2^BLOCK_MAX_LEVEL substeps all bodies are in sync.
+#define BLOCK_MAX_LEVEL (5)
+#define BLOCK_ETA       (0.05f)
+
+// Substeps between checks for escaped bodies, so that they always happen with all bodies in sync
+#define ESCAPE_INTERVAL (1 << BLOCK_MAX_LEVEL)
+
+// Energy diagnostics are compiled in unless built with `-DENERGY_DIAGNOSTICS=OFF`. When enabled,
+// the force pass also computes the potential energy of each body on sampled substeps, and reduces
+// it with the kinetic energy after the last kick, so no separate O(N^2) loop is needed.
+#ifdef SIMULATION_ENERGY
+typedef struct {
+    // Energy at the latest sample
+    double kinetic, potential, total;
+    // Total energy at the first sample since the last reset, less the energy merges and escapes
+    // took out since
+    double initial;
+    // Drift of the total energy relative to `initial`: latest, largest and mean magnitude
+    double drift, max_drift, mean_drift;
+    size_t samples;
+} EnergyStats;
+#endif
+
+typedef enum {
+    // Direct O(N^2) summation over all pairs, kept as the reference
+    SOLVER_DIRECT,
+    // Direct summation, vectorized (see kernel.h)
+    SOLVER_DIRECT_SIMD,
+    // O(N log N) Barnes-Hut approximation (see quadtree.h)
+    SOLVER_BARNES_HUT,
+    // O(N + M^2 log M) particle-mesh on an FFT grid (see pm.h), softened over a few cells
+    SOLVER_PARTICLE_MESH,
+    // Particle-mesh with direct short-range forces (P3M)
+    SOLVER_P3M,
+    SOLVER_COUNT,
+} Solver;
+
+extern const char* const integrator_name;
+extern const char* const solver_names[SOLVER_COUNT];
+// Names of the solvers on the command line
+extern const char* const solver_keys[SOLVER_COUNT];
+
+// The simulation must not be moved after `simulation_init`, as it owns a running `JobPool`.
+typedef struct {
+    CelestialBodies bodies;
+    Solver solver;
+    QuadTree tree;
+    ParticleMesh mesh;
+    JobPool pool;
+    // Number of substeps done since `simulation_init`
+    size_t steps;
+    // Whether to use block timesteps. Changes take effect the next time all bodies are in sync.
+    // Ignored unless built with the Verlet integrator.
+    bool block_steps;
+    // Number of bodies whose forces were computed during the last substep
+    size_t active;
+    // Incremented whenever the bodies get reordered or replaced, by merging, culling, or by the
+    // caller e.g. when loading a scene
+    size_t generation;
+    // Whether the bodies get sorted along a Morton curve from time to time, which reorders them
+    // (see order.h). On by default.
+    bool reorder;
+    SpatialOrder order;
+    // Whether overlapping bodies merge at the end of every substep (see collision.h), and how many
+    // bodies were absorbed so far. Merging reorders the bodies.
+    bool merge;
+    size_t merged;
+    // What happens to bodies escaping beyond `escape_radius` (see escape.h), and how many were
+    // culled so far. `far` is the aggregate of the bodies folded with ESCAPE_AGGREGATE.
+    EscapePolicy escape;
+    float escape_radius;
+    size_t culled;
+    FarField far;
+#ifdef SIMULATION_ENERGY
+    // Energy is sampled every `energy_interval` substeps, 0 disables sampling
+    size_t energy_interval;
+    EnergyStats energy;
+#endif
+
+    // Private fields, read by the jobs
+    // Timestep of the substep in progress
+    float dt;
+    // Whether block timesteps are in effect, and the bodies whose step ends at this substep, or
+    // NULL if all of them
+    bool blocks;
+    uint32_t* active_list;
+    uint32_t* active_buf;
+    size_t active_capacity;
+    Collisions collisions;
+#ifdef SIMULATION_ENERGY
+    // Whether the substep in progress is sampled, and when the next sample is due
+    bool sampling;
+    size_t next_sample;
+    // Potential energy of each body, and kinetic plus potential energy of each integration chunk
+    float* potential;
+    double* chunk_energy;
+    size_t energy_capacity;
+#endif
+} Simulation;
+
+// Initializes an empty simulation using the Barnes-Hut solver and `workers` threads (0 for one per
+// hardware thread). `bodies.allocator` can be configured before pushing the first body.
+void simulation_init(Simulation* sim, size_t workers);
+// Advances the simulation by `dt` seconds
+void simulation_step(Simulation* sim, float dt);
+// Restarts the job pool with a different number of workers
+void simulation_set_workers(Simulation* sim, size_t workers);
+#ifdef SIMULATION_ENERGY
+// Discards the energy statistics, taking the next sample as the new reference. To be called
+// whenever energy is added or removed, e.g. when spawning a body.
+void simulation_reset_energy(Simulation* sim);
+#endif
+// Frees all memory associated with the simulation
+void simulation_destroy(Simulation* sim);
+
+// Builds the tree or the mesh `solver` needs, if any, over the current bodies
+void simulation_prepare_solver(Simulation* sim, Solver solver);
+// Computes the forces of `solver` on the bodies `targets[0..count)` into `out`, indexed by body,
+// without the far field and without touching the bodies, e.g. to compare solvers (see tuner.h).
+// `targets` can be NULL for the bodies [0, count). The solver must be prepared since the bodies
+// last moved.
+void simulation_solver_forces(Simulation* sim, Solver solver, const uint32_t* targets,
+                              size_t count, Vector2* out);
+
+// Force exerted by `count` bodies at `positions` with `masses` on a body of mass `m` at `pos`.
+// `self` is the index of the body to skip, or `SIZE_MAX` if the body isn't one of them. Unless
+// `potential` is NULL, also stores the potential energy of the body into it.
+Vector2 apply_forces(const Vector2* positions, const float* masses, size_t count, Vector2 pos,
+                     float m, size_t self, float* potential);
+
+// Velocity Verlet, as kick-drift-kick
+//   v(t + dt/2) = v(t) + a(t) * dt/2
+//   x(t + dt) = x(t) + v(t + dt/2) * dt
+//   v(t + dt) = v(t + dt/2) + a(t + dt) * dt/2
+// Each kick only needs the latest force, so the second one can be done as soon as the force is
+// known without keeping the previous one around.
+
+static inline Vector2 kick_vel(Vector2 v, Vector2 f, float inv_mass, float dt) {
+    // a = F / m
+    return Vector2Add(v, Vector2Scale(f, dt * inv_mass));
+}
+
+static inline Vector2 drift_pos(Vector2 x, Vector2 v, float dt) {
+    return Vector2Add(x, Vector2Scale(v, dt));
+}
+
+#endif
@@ -0,0 +1,93 @@
+// The extlib hashmap around its last bucket, where probing wraps around to the first one: entries
+// landing there are found, erased and cleared like any other
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EXTLIB_IMPL
+#include "extlib.h"
+#include "test.h"
+
+typedef struct {
+    uint32_t key;
+    uint32_t value;
+} Entry;
+
+typedef struct {
+    Entry* entries;
+    size_t* hashes;
+    size_t size, capacity;
+    Ext_Allocator* allocator;
+} Map;
+
+static size_t count_entries(Map* map) {
+    size_t count = 0;
+    ext_hmap_foreach(Entry, it, map) count++;
+    return count;
+}
+
+static bool has(Map* map, uint32_t key, uint32_t value) {
+    Entry* e;
+    ext_hmap_get_int(map, key, &e);
+    return e && e->key == key && e->value == value;
+}
+
+static bool missing(Map* map, uint32_t key) {
+    Entry* e;
+    ext_hmap_get_int(map, key, &e);
+    return e == NULL;
+}
+
+int main(void) {
+    Map map = {0};
+    ext_hmap_reserve(&map, 16);
+    const size_t capacity = map.capacity;
+
+    // Keys hashing to the last bucket, the second one wrapping around past it, and one hashing to
+    // the first bucket that the wrapped one pushes further
+    uint32_t last[2], first = 0;
+    size_t found = 0;
+    for(uint32_t k = 1; found < 2 || !first; k++) {
+        size_t bucket = ext_hmap_hash_int_(&k) & map.capacity;
+        if(bucket == map.capacity && found < 2) last[found++] = k;
+        if(bucket == 0 && !first) first = k;
+    }
+
+    ext_hmap_put_int(&map, last[0], 1);
+    ext_hmap_put_int(&map, last[1], 2);
+    ext_hmap_put_int(&map, first, 3);
+    CHECK(map.size == 3 && count_entries(&map) == 3);
+    CHECK(has(&map, last[0], 1) && has(&map, last[1], 2) && has(&map, first, 3));
+
+    // Erasing the entry in the last bucket leaves the ones probed past it reachable
+    ext_hmap_delete_int(&map, last[0]);
+    CHECK(map.size == 2 && count_entries(&map) == 2);
+    CHECK(missing(&map, last[0]) && has(&map, last[1], 2) && has(&map, first, 3));
+    ext_hmap_put_int(&map, last[0], 4);
+    CHECK(has(&map, last[0], 4) && count_entries(&map) == 3);
+
+    // Clearing empties every bucket, the last one included
+    ext_hmap_clear(&map);
+    CHECK(map.size == 0 && count_entries(&map) == 0);
+    ext_hmap_put_int(&map, last[1], 5);
+    CHECK(map.size == 1 && count_entries(&map) == 1);
+    CHECK(missing(&map, last[0]) && has(&map, last[1], 5) && missing(&map, first));
+
+    // Refilled and cleared over and over, as the collision broadphase does every substep, without
+    // the map growing past its reservation. Other keys are far from the ones found above.
+    for(uint32_t round = 0; round < 64; round++) {
+        uint32_t base = (1u << 20) + round * 7;
+        ext_hmap_clear(&map);
+        for(uint32_t k = 0; k < 12; k++) ext_hmap_put_int(&map, base + k, k);
+        ext_hmap_put_int(&map, last[round % 2], 100);
+        CHECK(map.size == 13 && count_entries(&map) == 13);
+        CHECK(has(&map, last[round % 2], 100) && missing(&map, last[(round + 1) % 2]));
+        for(uint32_t k = 0; k < 12; k += 2) ext_hmap_delete_int(&map, base + k);
+        CHECK(map.size == 7 && count_entries(&map) == 7);
+    }
+    CHECK(map.capacity == capacity);
+
+    ext_hmap_free(&map);
+    return TEST_RESULT;
+}
@@ -0,0 +1,57 @@
+// The SIMD kernel against the scalar reference, on body counts that leave a partial last register
+
+#include <math.h>
+#include <stdint.h>
+
+#define EXTLIB_IMPL
+#include "body.h"
+#include "extlib.h"
+#include "kernel.h"
+#include "scenario.h"
+#include "test.h"
+
+// Single precision 1/r estimate refined by one Newton-Raphson step
+#define TOLERANCE (1e-4f)
+
+int main(void) {
+    const size_t sizes[] = {1, 7, 203};
+    for(size_t s = 0; s < EXT_ARR_SIZE(sizes); s++) {
+        CelestialBodies b = {0};
+        ScenarioConfig config = {.kind = SCENARIO_PLUMMER, .bodies = sizes[s], .seed = 1};
+        scenario_generate(&b, &config);
+        CHECK(kernel_max_error(&b) < TOLERANCE);
+
+        // Every other body, through the indexed entry point, potentials included
+        uint32_t* targets = ext_alloc(sizeof(uint32_t) * b.size);
+        Vector2* simd = ext_alloc(sizeof(Vector2) * b.size);
+        Vector2* scalar = ext_alloc(sizeof(Vector2) * b.size);
+        float* simd_u = ext_alloc(sizeof(float) * b.size);
+        float* scalar_u = ext_alloc(sizeof(float) * b.size);
+        size_t count = 0;
+        for(size_t i = 0; i < b.size; i += 2) targets[count++] = i;
+
+        kernel_forces_indexed(&b, targets, 0, count, simd, simd_u);
+        kernel_forces_scalar(&b, targets, 0, count, scalar, scalar_u);
+
+        float max_force = 0, max_u = 0;
+        for(size_t i = 0; i < count; i++) {
+            uint32_t t = targets[i];
+            max_force = fmaxf(max_force, hypotf(scalar[t].x, scalar[t].y));
+            max_u = fmaxf(max_u, fabsf(scalar_u[t]));
+        }
+        for(size_t i = 0; i < count; i++) {
+            uint32_t t = targets[i];
+            float error = hypotf(simd[t].x - scalar[t].x, simd[t].y - scalar[t].y);
+            CHECK(error <= TOLERANCE * max_force);
+            CHECK(fabsf(simd_u[t] - scalar_u[t]) <= TOLERANCE * max_u);
+        }
+
+        ext_free(targets, sizeof(uint32_t) * b.size);
+        ext_free(simd, sizeof(Vector2) * b.size);
+        ext_free(scalar, sizeof(Vector2) * b.size);
+        ext_free(simd_u, sizeof(float) * b.size);
+        ext_free(scalar_u, sizeof(float) * b.size);
+        bodies_free(&b);
+    }
+    return TEST_RESULT;
+}
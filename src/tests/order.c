@@ -0,0 +1,104 @@
+// Morton ordering: the radix sort moves every body whole, keeping its identifier, and keeps the
+// relative order of bodies with the same code
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define EXTLIB_IMPL
+#include "body.h"
+#include "extlib.h"
+#include "order.h"
+#include "scenario.h"
+#include "test.h"
+
+// Whether `b` holds the bodies of `original` in any order, every body keeping all its fields
+static bool is_permutation(const CelestialBodies* b, const CelestialBodies* original) {
+    if(b->size != original->size || b->next_id != original->next_id) return false;
+    // Index of each identifier in `original`, and whether it was found in `b` yet
+    size_t* where = ext_alloc(sizeof(size_t) * original->next_id);
+    bool* seen = ext_alloc(sizeof(bool) * original->next_id);
+    for(size_t id = 0; id < original->next_id; id++) where[id] = SIZE_MAX, seen[id] = false;
+    for(size_t i = 0; i < original->size; i++) where[original->id[i]] = i;
+
+    bool ok = true;
+    for(size_t i = 0; ok && i < b->size; i++) {
+        uint32_t id = b->id[i];
+        ok = id < original->next_id && where[id] != SIZE_MAX && !seen[id];
+        if(!ok) break;
+        seen[id] = true;
+#define X(T, name) ok = ok && memcmp(&b->name[i], &original->name[where[id]], sizeof(T)) == 0;
+        CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    }
+    ext_free(where, sizeof(size_t) * original->next_id);
+    ext_free(seen, sizeof(bool) * original->next_id);
+    return ok;
+}
+
+int main(void) {
+    SpatialOrder order = {0};
+
+    // Bodies generated in random order
+    CelestialBodies b = {0};
+    ScenarioConfig config = {.kind = SCENARIO_UNIFORM, .bodies = 5000, .seed = 11};
+    scenario_generate(&b, &config);
+    for(size_t i = 0; i < b.size; i++) b.velocity[i] = (Vector2){i, -(float)i};
+    CelestialBodies original = {0};
+    bodies_copy(&original, &b);
+
+    float spread = bodies_spread(&b);
+    CHECK(spatial_order_sort(&order, &b, 16));
+    CHECK(is_permutation(&b, &original));
+    CHECK(bodies_spread(&b) < spread / 4);
+    CHECK(order.sorts == 1 && order.sorted_step == 16);
+    // Already sorted, and sorting is stable
+    CHECK(!spatial_order_sort(&order, &b, 32));
+    CHECK(order.sorts == 1);
+
+    // Plus one far away enough to be clipped, in front of the others
+    bodies_push(&b, (CelestialBody){.position = {-1e7f, -1e7f}, .inv_mass = 1, .level = 3});
+    bodies_copy(&original, &b);
+    CHECK(spatial_order_sort(&order, &b, 48));
+    CHECK(is_permutation(&b, &original));
+    CHECK(b.id[0] == original.id[original.size - 1]);
+
+    // Bodies stacked on a few spots, in an order unrelated to them: the bodies of each spot keep
+    // the order they had
+    const Vector2 spots[] = {{-50, -50}, {50, 50}, {-50, 50}, {50, -50}};
+    CelestialBodies stacked = {0};
+    for(size_t i = 0; i < 400; i++) {
+        bodies_push(&stacked, (CelestialBody){.position = spots[i * 7 % 4], .inv_mass = 1});
+    }
+    bodies_copy(&original, &stacked);
+    CHECK(spatial_order_sort(&order, &stacked, 64));
+    CHECK(is_permutation(&stacked, &original));
+    for(size_t i = 1; i < stacked.size; i++) {
+        bool same = stacked.position[i].x == stacked.position[i - 1].x &&
+                    stacked.position[i].y == stacked.position[i - 1].y;
+        if(same) CHECK(stacked.id[i] > stacked.id[i - 1]);
+    }
+    for(size_t s = 0; s < EXT_ARR_SIZE(spots); s++) {
+        size_t runs = 0;
+        for(size_t i = 0; i < stacked.size; i++) {
+            Vector2 p = stacked.position[i];
+            bool starts = p.x == spots[s].x && p.y == spots[s].y &&
+                          (i == 0 || stacked.position[i - 1].x != p.x ||
+                           stacked.position[i - 1].y != p.y);
+            if(starts) runs++;
+        }
+        CHECK(runs == 1);
+    }
+
+    // Nothing to sort
+    CelestialBodies single = {0};
+    bodies_push(&single, (CelestialBody){.inv_mass = 1});
+    CHECK(!spatial_order_sort(&order, &single, 80));
+
+    bodies_free(&single);
+    bodies_free(&stacked);
+    bodies_free(&original);
+    bodies_free(&b);
+    spatial_order_destroy(&order);
+    return TEST_RESULT;
+}
@@ -0,0 +1,71 @@
+// Douglas-Peucker simplification: endpoints are kept and no removed point strays past the tolerance
+
+#include <math.h>
+#include <stdbool.h>
+
+#define EXTLIB_IMPL
+#include "extlib.h"
+#include "path.h"
+#include "raymath.h"
+#include "test.h"
+
+#define POINTS (200)
+
+// Distance of `p` from the polyline
+static float polyline_distance(Vector2 p, const Vector2* points, size_t count) {
+    float min = INFINITY;
+    for(size_t i = 0; i + 1 < count; i++) {
+        Vector2 a = points[i], ab = Vector2Subtract(points[i + 1], a);
+        float len2 = Vector2LengthSqr(ab);
+        float t = len2 > 0 ? Clamp(Vector2DotProduct(Vector2Subtract(p, a), ab) / len2, 0, 1) : 0;
+        min = fminf(min, Vector2Distance(p, Vector2Add(a, Vector2Scale(ab, t))));
+    }
+    return min;
+}
+
+int main(void) {
+    // Too short to simplify
+    Vector2 pair[] = {{0, 0}, {1, 1}};
+    CHECK(path_simplify(pair, 2, 0.1f) == 2);
+    CHECK(path_simplify(pair, 1, 0.1f) == 1);
+    CHECK(path_simplify(pair, 0, 0.1f) == 0);
+
+    // A straight line keeps its endpoints only
+    Vector2 line[POINTS];
+    for(size_t i = 0; i < POINTS; i++) line[i] = (Vector2){i * 2.0f, i * 1.0f};
+    CHECK(path_simplify(line, POINTS, 0.01f) == 2);
+    CHECK(line[0].x == 0 && line[0].y == 0);
+    CHECK(line[1].x == (POINTS - 1) * 2.0f && line[1].y == POINTS - 1);
+
+    // A spike past the tolerance is kept along with the corners at its feet, a bump within it isn't
+    Vector2 spike[] = {{0, 0}, {1, 0}, {2, 5}, {3, 0}, {4, 0.05f}, {5, 0}};
+    CHECK(path_simplify(spike, EXT_ARR_SIZE(spike), 0.1f) == 5);
+    CHECK(spike[2].x == 2 && spike[2].y == 5);
+    CHECK(spike[3].x == 3 && spike[4].x == 5);
+
+    // A sine wave, at a few tolerances
+    const float tolerances[] = {0.01f, 0.5f, 4.0f};
+    for(size_t t = 0; t < EXT_ARR_SIZE(tolerances); t++) {
+        Vector2 wave[POINTS], original[POINTS];
+        for(size_t i = 0; i < POINTS; i++) {
+            wave[i] = original[i] = (Vector2){i, 10 * sinf(i * 0.1f)};
+        }
+        size_t count = path_simplify(wave, POINTS, tolerances[t]);
+        CHECK(count >= 2 && count < POINTS);
+        CHECK(wave[0].x == original[0].x && wave[0].y == original[0].y);
+        CHECK(wave[count - 1].x == original[POINTS - 1].x);
+        CHECK(wave[count - 1].y == original[POINTS - 1].y);
+
+        // Kept points are original ones, in order
+        for(size_t i = 0; i < count; i++) {
+            size_t j = wave[i].x;
+            CHECK(wave[i].x == original[j].x && wave[i].y == original[j].y);
+            if(i) CHECK(wave[i].x > wave[i - 1].x);
+        }
+        for(size_t i = 0; i < POINTS; i++) {
+            CHECK(polyline_distance(original[i], wave, count) <= tolerances[t] * 1.001f);
+        }
+    }
+
+    return TEST_RESULT;
+}
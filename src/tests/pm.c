@@ -0,0 +1,136 @@
+// Particle-mesh solvers against direct summation: P3M forces and energies, the energy of the mesh
+// alone against the long-range potential it stands for, and builds that don't depend on the number
+// of workers
+
+#include <math.h>
+#include <string.h>
+
+#define EXTLIB_IMPL
+#include "body.h"
+#include "extlib.h"
+#include "jobs.h"
+#include "pm.h"
+#include "scenario.h"
+#include "simulation.h"
+#include "test.h"
+
+// RMS error of the P3M forces relative to the RMS force, as forces from beyond the cutoff are
+// left to the mesh with relative errors around 1e-3 (see pm.h)
+#define FORCE_TOLERANCE (1e-3)
+// Relative error of the total potential energy. Far above what the solvers achieve, far below what
+// the mesh adds when the bodies' own potential isn't taken back out exactly.
+#define ENERGY_TOLERANCE (2e-4)
+// Bodies sparse enough for their own potential on the mesh to dwarf that of all the others
+#define SPARSE_TOLERANCE (1e-3)
+
+static double direct_energy(const CelestialBodies* b) {
+    double energy = 0;
+    for(size_t i = 0; i < b->size; i++) {
+        float u;
+        apply_forces(b->position, b->mass, b->size, b->position[i], b->mass[i], i, &u);
+        energy += 0.5 * u;
+    }
+    return energy;
+}
+
+// Builds a mesh on `pool` and sums the potential energy of the bodies on it
+static double mesh_energy(const CelestialBodies* b, bool short_range, JobPool* pool,
+                          float* cell) {
+    ParticleMesh pm = pm_new(.short_range = short_range);
+    pm_build(&pm, b, pool);
+    double energy = 0;
+    for(size_t i = 0; i < b->size; i++) {
+        float u;
+        pm_force(&pm, b, i, &u);
+        energy += 0.5 * u;
+    }
+    if(cell) *cell = pm.cell;
+    pm_destroy(&pm);
+    jobs_reset_scratch(pool);
+    return energy;
+}
+
+static bool within(double value, double expected, double tolerance) {
+    return fabs(value - expected) <= tolerance * fabs(expected);
+}
+
+int main(void) {
+    JobPool pool;
+    jobs_init(&pool, 1);
+
+    // P3M forces against the direct solver
+    Simulation sim;
+    simulation_init(&sim, 1);
+    ScenarioConfig plummer = {.kind = SCENARIO_PLUMMER, .bodies = 8000, .seed = 5};
+    scenario_generate(&sim.bodies, &plummer);
+    const CelestialBodies* b = &sim.bodies;
+    size_t n = b->size;
+    Vector2* direct = ext_alloc(sizeof(Vector2) * n);
+    Vector2* p3m = ext_alloc(sizeof(Vector2) * n);
+    simulation_prepare_solver(&sim, SOLVER_DIRECT);
+    simulation_solver_forces(&sim, SOLVER_DIRECT, NULL, n, direct);
+    simulation_prepare_solver(&sim, SOLVER_P3M);
+    simulation_solver_forces(&sim, SOLVER_P3M, NULL, n, p3m);
+    double error = 0, norm = 0;
+    for(size_t i = 0; i < n; i++) {
+        double ex = p3m[i].x - direct[i].x, ey = p3m[i].y - direct[i].y;
+        error += ex * ex + ey * ey;
+        norm += (double)direct[i].x * direct[i].x + (double)direct[i].y * direct[i].y;
+    }
+    CHECK(sqrt(error / norm) < FORCE_TOLERANCE);
+    ext_free(direct, sizeof(Vector2) * n);
+    ext_free(p3m, sizeof(Vector2) * n);
+
+    // P3M energies against direct summation, on a cluster and on a handful of bodies each alone in
+    // its region of the mesh
+    CHECK(within(mesh_energy(b, true, &pool, NULL), direct_energy(b), ENERGY_TOLERANCE));
+    CelestialBodies sparse = {0};
+    ScenarioConfig scattered = {.kind = SCENARIO_UNIFORM, .bodies = 16, .seed = 9, .scale = 4000};
+    scenario_generate(&sparse, &scattered);
+    CHECK(within(mesh_energy(&sparse, true, &pool, NULL), direct_energy(&sparse),
+                 SPARSE_TOLERANCE));
+    bodies_free(&sparse);
+
+    // The mesh alone against the long-range potential -G erf(r / 2r_s) / r it carries, summed
+    // directly. Uniform bodies all fall on the grid, so none of them interacts exactly.
+    CelestialBodies uniform = {0};
+    ScenarioConfig square = {.kind = SCENARIO_UNIFORM, .bodies = 2000, .seed = 2};
+    scenario_generate(&uniform, &square);
+    float cell;
+    double mesh = mesh_energy(&uniform, false, &pool, &cell);
+    double rs = PM_SPLIT * cell, long_range = 0;
+    for(size_t i = 0; i < uniform.size; i++) {
+        for(size_t j = 0; j < i; j++) {
+            double dx = uniform.position[i].x - uniform.position[j].x;
+            double dy = uniform.position[i].y - uniform.position[j].y, d = sqrt(dx * dx + dy * dy);
+            long_range -= G * (double)uniform.mass[i] * uniform.mass[j] * erf(d / (2 * rs)) / d;
+        }
+    }
+    CHECK(within(mesh, long_range, ENERGY_TOLERANCE));
+    bodies_free(&uniform);
+
+    // Builds on 1 and 4 workers, the deposit split in as many chunks, are bit for bit the same
+    JobPool pool4;
+    jobs_init(&pool4, 4);
+    ParticleMesh one = pm_new(.short_range = true), four = pm_new(.short_range = true);
+    pm_build(&one, b, &pool);
+    pm_build(&four, b, &pool4);
+    CHECK(one.partials == 1 && four.partials == 4);
+    size_t nodes = one.size * one.size;
+    CHECK(memcmp(one.potential, four.potential, sizeof(float) * nodes) == 0);
+    CHECK(memcmp(one.accel, four.accel, sizeof(Vector2) * nodes) == 0);
+    bool same = true;
+    for(size_t i = 0; i < n; i++) {
+        float u1, u4;
+        Vector2 f1 = pm_force(&one, b, i, &u1), f4 = pm_force(&four, b, i, &u4);
+        same = same && memcmp(&f1, &f4, sizeof(f1)) == 0 && memcmp(&u1, &u4, sizeof(u1)) == 0;
+    }
+    CHECK(same);
+    pm_destroy(&one);
+    pm_destroy(&four);
+    jobs_destroy(&pool4);
+
+    simulation_destroy(&sim);
+    jobs_destroy(&pool);
+    return TEST_RESULT;
+}
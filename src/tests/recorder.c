@@ -0,0 +1,106 @@
+// Recordings decode back to the captured frames: exactly when raw, within half a quantum when delta
+// encoded, across keyframes, large jumps, removed bodies and reorderings
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EXTLIB_IMPL
+#include "body.h"
+#include "extlib.h"
+#include "recorder.h"
+#include "test.h"
+
+#define PATH     "test_recording.grec"
+#define BODIES   (64)
+#define STEPS    (400)
+#define INTERVAL (2)
+#define FRAMES   (STEPS / INTERVAL)
+
+typedef struct {
+    size_t step, count;
+    Vector2 positions[BODIES];
+    uint32_t ids[BODIES];
+} Frame;
+
+static Frame frames[FRAMES];
+
+// Moves the bodies for substep `step`, changing them along the way as the simulation does
+static void advance(CelestialBodies* b, size_t step, size_t* generation) {
+    for(size_t i = 0; i < b->size; i++) {
+        float phase = step * 0.05f + b->id[i];
+        b->position[i] = (Vector2){b->id[i] * 40.0f - 1000 + 300 * sinf(phase), 200 * cosf(phase)};
+    }
+    // Far enough in both directions to take every varint length
+    if(step >= 100 && b->size > 3) {
+        b->position[3].x += 1e5f;
+        b->position[2].y -= 3e4f;
+    }
+    if(step == 200) {
+        bodies_swap_remove(b, 5);
+        (*generation)++;
+    }
+    if(step == 300) {
+        for(size_t i = 0, j = b->size - 1; i < j; i++, j--) {
+            Vector2 position = b->position[i];
+            uint32_t id = b->id[i];
+            b->position[i] = b->position[j], b->position[j] = position;
+            b->id[i] = b->id[j], b->id[j] = id;
+        }
+        (*generation)++;
+    }
+}
+
+static void check_roundtrip(RecorderEncoding encoding) {
+    CelestialBodies b = {0};
+    for(size_t i = 0; i < BODIES; i++) bodies_push(&b, (CelestialBody){.inv_mass = 1});
+
+    Recorder rec;
+    CHECK(recorder_start(&rec, PATH, INTERVAL, encoding));
+    size_t generation = 0, captured = 0;
+    for(size_t step = 0; step < STEPS; step++) {
+        advance(&b, step, &generation);
+        recorder_capture(&rec, &b, step, generation);
+        if(step % INTERVAL == 0) {
+            Frame* f = &frames[captured++];
+            f->step = step;
+            f->count = b.size;
+            memcpy(f->positions, b.position, sizeof(Vector2) * b.size);
+            memcpy(f->ids, b.id, sizeof(uint32_t) * b.size);
+        }
+    }
+    recorder_stop(&rec);
+    CHECK(atomic_load(&rec.frames) == FRAMES);
+    CHECK(atomic_load(&rec.dropped) == 0);
+
+    RecordingReader rd;
+    CHECK(recording_open(&rd, PATH));
+    CHECK(rd.header.encoding == encoding && rd.header.interval == INTERVAL);
+    float tolerance = encoding == RECORDER_RAW ? 0 : rd.header.quantum / 2;
+    size_t read = 0, step, count;
+    const Vector2* positions;
+    const uint32_t* ids;
+    while(read < FRAMES && recording_next(&rd, &step, &positions, &ids, &count)) {
+        const Frame* f = &frames[read++];
+        CHECK(step == f->step && count == f->count);
+        if(count != f->count) break;
+        CHECK(memcmp(ids, f->ids, sizeof(uint32_t) * count) == 0);
+        for(size_t i = 0; i < count; i++) {
+            CHECK(fabsf(positions[i].x - f->positions[i].x) <= tolerance);
+            CHECK(fabsf(positions[i].y - f->positions[i].y) <= tolerance);
+        }
+    }
+    CHECK(read == FRAMES);
+    CHECK(!recording_next(&rd, &step, &positions, &ids, &count));
+    recording_close(&rd);
+
+    remove(PATH);
+    bodies_free(&b);
+}
+
+int main(void) {
+    check_roundtrip(RECORDER_RAW);
+    check_roundtrip(RECORDER_DELTA);
+    return TEST_RESULT;
+}
@@ -0,0 +1,101 @@
+// Input logs: replaying a session reproduces its checksum, a tampered log doesn't, and logs that
+// can't be replayed are rejected
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EXTLIB_IMPL
+#include "extlib.h"
+#include "replay.h"
+#include "scenario.h"
+#include "simulation.h"
+#include "test.h"
+
+#define PATH     "test_session.glog"
+#define TAMPERED "test_tampered.glog"
+#define DT       (1.0f / 60)
+
+// Copies the log at PATH to TAMPERED, replacing its first line starting with `kind` by
+// `replacement`, or dropping it if NULL
+static void tamper(const char* kind, const char* replacement) {
+    FILE* in = fopen(PATH, "r");
+    FILE* out = fopen(TAMPERED, "w");
+    CHECK(in && out);
+    if(!in || !out) return;
+    char line[512];
+    bool replaced = false;
+    while(fgets(line, sizeof(line), in)) {
+        if(!replaced && strncmp(line, kind, strlen(kind)) == 0 && line[strlen(kind)] == ' ') {
+            replaced = true;
+            if(replacement) fprintf(out, "%s\n", replacement);
+        } else {
+            fputs(line, out);
+        }
+    }
+    CHECK(replaced);
+    fclose(in);
+    fclose(out);
+}
+
+// Replays the log at `path`, storing the logged checksum into `expected` and returning the one of
+// the replayed state, or 0 if the replay failed
+static uint64_t replay(const char* path, uint64_t* expected) {
+    Simulation sim;
+    simulation_init(&sim, 1);
+    bool ok = replay_run(path, &sim, NULL, expected);
+    uint64_t checksum = ok ? input_checksum(&sim) : 0;
+    simulation_destroy(&sim);
+    return checksum;
+}
+
+int main(void) {
+    // A session: a cluster, a spawned body, and a change of solver with merging on
+    Simulation sim;
+    simulation_init(&sim, 1);
+    InputLog log;
+    CHECK(input_log_open(&log, PATH, 1, DT, &sim));
+    ScenarioConfig cluster = {.kind = SCENARIO_PLUMMER, .bodies = 200, .seed = 3};
+    CHECK(input_log_apply(&log, &sim, (InputEvent){.kind = INPUT_SCENARIO, .scenario = cluster},
+                          NULL));
+    for(int i = 0; i < 30; i++) simulation_step(&sim, DT);
+    CelestialBody body = {
+        .position = {10, -20}, .velocity = {1, 0}, .radius = 2, .inv_mass = 0.25f, .color = RED};
+    CHECK(input_log_apply(&log, &sim, (InputEvent){.kind = INPUT_SPAWN, .body = body}, NULL));
+    for(int i = 0; i < 30; i++) simulation_step(&sim, DT);
+    sim.solver = SOLVER_BARNES_HUT;
+    sim.merge = true;
+    input_log_settings(&log, &sim);
+    for(int i = 0; i < 30; i++) simulation_step(&sim, DT);
+    input_log_close(&log, &sim);
+    uint64_t session = input_checksum(&sim);
+    simulation_destroy(&sim);
+
+    uint64_t expected = 0;
+    CHECK(replay(PATH, &expected) == session);
+    CHECK(expected == session);
+
+    // The body spawned somewhere else replays fine, to another state than the logged one
+    tamper("spawn", "spawn 30 10 20 1 0 2 0.25 230 41 55 255");
+    uint64_t checksum = replay(TAMPERED, &expected);
+    CHECK(checksum != 0 && expected == session && checksum != expected);
+
+    // A session that crashed replays up to its last event, with no checksum to compare with
+    tamper("end", NULL);
+    CHECK(replay(TAMPERED, &expected) != 0);
+    CHECK(expected == 0);
+
+    // Logs that can't be replayed
+    tamper(INPUT_LOG_MAGIC, INPUT_LOG_MAGIC " 99 1 0x1.111112p-6");
+    CHECK(replay(TAMPERED, &expected) == 0);
+    tamper("scenario", "scenario 0 nebula 200 3 0 0 0");
+    CHECK(replay(TAMPERED, &expected) == 0);
+    tamper("end", "end 10 0");
+    CHECK(replay(TAMPERED, &expected) == 0);
+    remove(TAMPERED);
+    CHECK(replay(TAMPERED, &expected) == 0);
+
+    remove(PATH);
+    return TEST_RESULT;
+}
@@ -0,0 +1,101 @@
+// Scene files: a save loads back field for field, read or mapped, and damaged headers are rejected
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EXTLIB_IMPL
+#include "body.h"
+#include "extlib.h"
+#include "scenario.h"
+#include "scene.h"
+#include "test.h"
+
+#define PATH "test_scene.grav"
+
+static bool bodies_equal(const CelestialBodies* a, const CelestialBodies* b) {
+    if(a->size != b->size || a->next_id != b->next_id) return false;
+#define X(T, name) \
+    if(a->size && memcmp(a->name, b->name, sizeof(T) * a->size) != 0) return false;
+    CELESTIAL_BODIES_FIELDS(X)
+#undef X
+    return true;
+}
+
+// Overwrites the header of the scene at PATH with `h`
+static void write_header(const SceneHeader* h) {
+    FILE* f = fopen(PATH, "r+b");
+    CHECK(f && fwrite(h, sizeof(*h), 1, f) == 1);
+    if(f) fclose(f);
+}
+
+int main(void) {
+    CelestialBodies saved = {0};
+    ScenarioConfig config = {.kind = SCENARIO_DISK, .bodies = 300, .seed = 7};
+    scenario_generate(&saved, &config);
+    // Identifiers out of order, the next one still coming after the largest
+    bodies_swap_remove(&saved, 0);
+    CHECK(scene_save(PATH, &saved, 1234));
+
+    CelestialBodies loaded = {0};
+    size_t steps = 0;
+    CHECK(scene_load(PATH, &loaded, NULL, &steps));
+    CHECK(steps == 1234);
+    CHECK(bodies_equal(&saved, &loaded));
+    bodies_free(&loaded);
+
+    Ext_VmAllocator vm = ext_new_vm_allocator();
+    CelestialBodies mapped = {.allocator = &vm.base};
+    steps = 0;
+    CHECK(scene_load(PATH, &mapped, &vm, &steps));
+    CHECK(steps == 1234);
+    CHECK(bodies_equal(&saved, &mapped));
+    bodies_free(&mapped);
+    ext_vm_destroy(&vm);
+
+    // An empty scene
+    CelestialBodies empty = {0};
+    CHECK(scene_save(PATH, &empty, 0));
+    loaded = (CelestialBodies){0};
+    CHECK(scene_load(PATH, &loaded, NULL, &steps) && loaded.size == 0 && steps == 0);
+    bodies_free(&loaded);
+
+    // Every damaged header fails to load, leaving the bodies untouched
+    CHECK(scene_save(PATH, &saved, 1234));
+    FILE* f = fopen(PATH, "rb");
+    SceneHeader good;
+    CHECK(f && fread(&good, sizeof(good), 1, f) == 1);
+    if(f) fclose(f);
+
+    SceneHeader damaged[5];
+    for(size_t i = 0; i < EXT_ARR_SIZE(damaged); i++) damaged[i] = good;
+    damaged[0].magic[0] = 'X';
+    damaged[1].version = SCENE_VERSION + 1;
+    damaged[2].byte_order = 0x04030201u;
+    damaged[3].field_count--;
+    damaged[4].fields[0].element_size++;
+
+    CelestialBodies kept = {0};
+    bodies_copy(&kept, &saved);
+    for(size_t i = 0; i < EXT_ARR_SIZE(damaged); i++) {
+        write_header(&damaged[i]);
+        steps = 42;
+        CHECK(!scene_load(PATH, &kept, NULL, &steps));
+        CHECK(steps == 42);
+        CHECK(bodies_equal(&saved, &kept));
+    }
+
+    // A file cut short of its arrays
+    f = fopen(PATH, "wb");
+    CHECK(f && fwrite(&good, sizeof(good), 1, f) == 1);
+    if(f) fclose(f);
+    CHECK(!scene_load(PATH, &kept, NULL, &steps));
+    CHECK(bodies_equal(&saved, &kept));
+
+    remove(PATH);
+    CHECK(!scene_load(PATH, &kept, NULL, &steps));
+
+    bodies_free(&kept);
+    bodies_free(&saved);
+    return TEST_RESULT;
+}
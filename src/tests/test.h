@@ -0,0 +1,21 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Minimal checks for the unit tests. A failed check prints where it failed and the test goes on,
+// returning `TEST_RESULT` from `main` so that ctest reports it as failed.
+
+static int test_failures;
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if(!(cond)) {                                                                   \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);    \
+            test_failures++;                                                            \
+        }                                                                               \
+    } while(0)
+
+#define TEST_RESULT (test_failures ? 1 : 0)
+
+#endif
@@ -0,0 +1,176 @@
+#include "thread.h"
+
+#ifdef EXT_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+EXT_STATIC_ASSERT(sizeof(SRWLOCK) == sizeof(void*), "SRWLOCK doesn't fit in Mutex");
+EXT_STATIC_ASSERT(sizeof(CONDITION_VARIABLE) == sizeof(void*), "CONDITION_VARIABLE doesn't fit");
+
+static DWORD WINAPI thread_trampoline(LPVOID arg) {
+    Thread* t = arg;
+    t->fn(t->arg);
+    return 0;
+}
+
+bool thread_create(Thread* t, ThreadFn fn, void* arg) {
+    t->fn = fn;
+    t->arg = arg;
+    t->handle = CreateThread(NULL, 0, thread_trampoline, t, 0, NULL);
+    if(!t->handle) {
+        ext_log(EXT_ERROR, "couldn't create thread: error %lu", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+void thread_join(Thread* t) {
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+    t->handle = NULL;
+}
+
+void thread_yield(void) {
+    SwitchToThread();
+}
+
+void thread_sleep(double seconds) {
+    Sleep((DWORD)(seconds * 1000));
+}
+
+double thread_clock(void) {
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double)count.QuadPart / freq.QuadPart;
+}
+
+size_t thread_hardware_concurrency(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+void mutex_init(Mutex* m) {
+    InitializeSRWLock((PSRWLOCK)&m->srw);
+}
+
+void mutex_lock(Mutex* m) {
+    AcquireSRWLockExclusive((PSRWLOCK)&m->srw);
+}
+
+void mutex_unlock(Mutex* m) {
+    ReleaseSRWLockExclusive((PSRWLOCK)&m->srw);
+}
+
+void mutex_destroy(Mutex* m) {
+    // SRW locks need no cleanup
+    (void)m;
+}
+
+void cond_init(CondVar* c) {
+    InitializeConditionVariable((PCONDITION_VARIABLE)&c->cv);
+}
+
+void cond_wait(CondVar* c, Mutex* m) {
+    SleepConditionVariableSRW((PCONDITION_VARIABLE)&c->cv, (PSRWLOCK)&m->srw, INFINITE, 0);
+}
+
+void cond_signal(CondVar* c) {
+    WakeConditionVariable((PCONDITION_VARIABLE)&c->cv);
+}
+
+void cond_broadcast(CondVar* c) {
+    WakeAllConditionVariable((PCONDITION_VARIABLE)&c->cv);
+}
+
+void cond_destroy(CondVar* c) {
+    // Condition variables need no cleanup
+    (void)c;
+}
+#else
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static void* thread_trampoline(void* arg) {
+    Thread* t = arg;
+    t->fn(t->arg);
+    return NULL;
+}
+
+bool thread_create(Thread* t, ThreadFn fn, void* arg) {
+    t->fn = fn;
+    t->arg = arg;
+    int res = pthread_create(&t->handle, NULL, thread_trampoline, t);
+    if(res != 0) {
+        ext_log(EXT_ERROR, "couldn't create thread: %s", strerror(res));
+        return false;
+    }
+    return true;
+}
+
+void thread_join(Thread* t) {
+    pthread_join(t->handle, NULL);
+}
+
+void thread_yield(void) {
+    sched_yield();
+}
+
+void thread_sleep(double seconds) {
+    struct timespec ts = {.tv_sec = (time_t)seconds};
+    ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+    // Resume with the remaining time when interrupted by a signal
+    while(nanosleep(&ts, &ts) == -1 && errno == EINTR) continue;
+}
+
+double thread_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+size_t thread_hardware_concurrency(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+}
+
+void mutex_init(Mutex* m) {
+    pthread_mutex_init(&m->m, NULL);
+}
+
+void mutex_lock(Mutex* m) {
+    pthread_mutex_lock(&m->m);
+}
+
+void mutex_unlock(Mutex* m) {
+    pthread_mutex_unlock(&m->m);
+}
+
+void mutex_destroy(Mutex* m) {
+    pthread_mutex_destroy(&m->m);
+}
+
+void cond_init(CondVar* c) {
+    pthread_cond_init(&c->c, NULL);
+}
+
+void cond_wait(CondVar* c, Mutex* m) {
+    pthread_cond_wait(&c->c, &m->m);
+}
+
+void cond_signal(CondVar* c) {
+    pthread_cond_signal(&c->c);
+}
+
+void cond_broadcast(CondVar* c) {
+    pthread_cond_broadcast(&c->c);
+}
+
+void cond_destroy(CondVar* c) {
+    pthread_cond_destroy(&c->c);
+}
+#endif  // EXT_WINDOWS
@@ -0,0 +1,77 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "extlib.h"
+
+// Minimal cross-platform threading primitives: threads, mutexes and condition variables.
+// Backed by pthreads on posix systems and by the win32 API on windows. On windows the native
+// handles are stored as opaque pointers so that this header doesn't drag in windows.h, which
+// conflicts with raylib. Emscripten's pthreads run on Web Workers sharing the memory of the module,
+// which need to be started ahead of time (see PTHREAD_POOL_SIZE in src/CMakeLists.txt).
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+typedef void (*ThreadFn)(void* arg);
+
+#ifdef EXT_WINDOWS
+typedef struct Thread {
+    void* handle;
+    ThreadFn fn;
+    void* arg;
+} Thread;
+typedef struct {
+    void* srw;
+} Mutex;
+typedef struct {
+    void* cv;
+} CondVar;
+#else
+#include <pthread.h>
+typedef struct Thread {
+    pthread_t handle;
+    ThreadFn fn;
+    void* arg;
+} Thread;
+typedef struct {
+    pthread_mutex_t m;
+} Mutex;
+typedef struct {
+    pthread_cond_t c;
+} CondVar;
+#endif  // EXT_WINDOWS
+
+// Spawns a new thread running `fn(arg)`. Returns false on failure.
+// `t` must stay valid (i.e. not move) until the thread is joined.
+bool thread_create(Thread* t, ThreadFn fn, void* arg);
+// Waits for the thread to exit
+void thread_join(Thread* t);
+// Yields the rest of the calling thread's time slice
+void thread_yield(void);
+// Suspends the calling thread for at least `seconds`
+void thread_sleep(double seconds);
+// Seconds elapsed on a monotonic clock since an arbitrary point, for measuring intervals
+double thread_clock(void);
+// Number of hardware threads available to the process
+size_t thread_hardware_concurrency(void);
+
+void mutex_init(Mutex* m);
+void mutex_lock(Mutex* m);
+void mutex_unlock(Mutex* m);
+void mutex_destroy(Mutex* m);
+
+void cond_init(CondVar* c);
+// Atomically releases `m` and waits for the condition to be signaled. `m` is re-acquired before
+// returning. Spurious wakeups are possible, always wait in a loop.
+void cond_wait(CondVar* c, Mutex* m);
+void cond_signal(CondVar* c);
+void cond_broadcast(CondVar* c);
+void cond_destroy(CondVar* c);
+
+#endif
@@ -0,0 +1,205 @@
+#include "tuner.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include "extlib.h"
+#include "thread.h"
+
+EXT_STATIC_ASSERT(TUNER_TARGETS % FORCE_CHUNK == 0, "targets are timed in runs of FORCE_CHUNK");
+EXT_STATIC_ASSERT(TUNER_TARGETS <= TUNER_MAX_TARGETS, "targets must fit TUNER_MAX_TARGETS");
+
+#define THETA_VALUE(theta) theta,
+static const float thetas[] = {TUNER_THETAS(THETA_VALUE)};
+
+static void reserve(Tuner* t, size_t n) {
+    if(t->capacity >= n) return;
+    size_t newcap = t->capacity ? t->capacity : 256;
+    while(newcap < n) newcap *= 2;
+    t->forces = ext_realloc(t->forces, sizeof(Vector2) * t->capacity, sizeof(Vector2) * newcap);
+    t->reference = ext_realloc(t->reference, sizeof(Vector2) * t->capacity,
+                               sizeof(Vector2) * newcap);
+    t->capacity = newcap;
+}
+
+// Picks the timed targets among `n` bodies, a run of FORCE_CHUNK per worker or TUNER_TARGETS if
+// more, returning how many. The runs are evenly spread, so that they see dense and sparse regions
+// alike, but consecutive within, so that tree walks get the same cache locality from the order of
+// the bodies as in a full pass.
+static size_t pick_targets(Tuner* t, size_t n, size_t workers) {
+    size_t runs = TUNER_TARGETS / FORCE_CHUNK;
+    if(runs < workers) runs = workers;
+    if(n <= runs * FORCE_CHUNK) {
+        for(size_t i = 0; i < n; i++) t->targets[i] = i;
+        return n;
+    }
+    for(size_t r = 0; r < runs; r++) {
+        // At least FORCE_CHUNK bodies apart, as n > runs * FORCE_CHUNK
+        size_t first = r * n / runs;
+        for(size_t k = 0; k < FORCE_CHUNK; k++) t->targets[r * FORCE_CHUNK + k] = first + k;
+    }
+    return runs * FORCE_CHUNK;
+}
+
+// Picks the bodies the error is measured on, evenly strided, returning how many
+static size_t pick_sample(Tuner* t, size_t n) {
+    size_t count = n < TUNER_SAMPLE ? n : TUNER_SAMPLE;
+    for(size_t j = 0; j < count; j++) t->sample[j] = j * n / count;
+    return count;
+}
+
+// Mean relative difference of the forces on the sample with the reference ones. Close encounters
+// dominate any sum of the forces themselves, and every solver but the mesh resolves them exactly,
+// so errors are relative to each body's own force.
+static float force_error(const Tuner* t, size_t samples) {
+    double sum = 0;
+    size_t count = 0;
+    for(size_t j = 0; j < samples; j++) {
+        Vector2 f = t->forces[t->sample[j]], ref = t->reference[t->sample[j]];
+        double norm = sqrt((double)ref.x * ref.x + (double)ref.y * ref.y);
+        if(norm <= 0) continue;
+        double dx = f.x - ref.x, dy = f.y - ref.y;
+        sum += sqrt(dx * dx + dy * dy) / norm;
+        count++;
+    }
+    return count ? sum / count : 0;
+}
+
+// Seconds per force pass over all `n` bodies, from `elapsed` seconds over `targets` of them. Chunks
+// of FORCE_CHUNK bodies run `workers` at a time, so both are counted in rounds of parallel chunks:
+// a candidate timed on fewer chunks than there are workers ran on fewer threads than a full pass.
+static double extrapolate(double elapsed, size_t targets, size_t n, size_t workers) {
+    size_t chunks = (targets + FORCE_CHUNK - 1) / FORCE_CHUNK;
+    size_t total = (n + FORCE_CHUNK - 1) / FORCE_CHUNK;
+    size_t rounds = (chunks + workers - 1) / workers;
+    size_t total_rounds = (total + workers - 1) / workers;
+    return elapsed * total_rounds / rounds;
+}
+
+// Times `solver` on the first `targets` timed targets, extrapolating to all bodies on top of the
+// `build` seconds it took to prepare, and measures its error on the sample
+static TunerTrial try_solver(Tuner* t, Simulation* sim, Solver solver, double build,
+                             size_t targets, size_t samples) {
+    double start = thread_clock();
+    simulation_solver_forces(sim, solver, t->targets, targets, t->forces);
+    double elapsed = thread_clock() - start;
+    double seconds = build + extrapolate(elapsed, targets, sim->bodies.size, sim->pool.workers);
+    // Direct summation is the reference itself
+    float error = 0;
+    if(solver != SOLVER_DIRECT) {
+        simulation_solver_forces(sim, solver, t->sample, samples, t->forces);
+        error = force_error(t, samples);
+    }
+    return (TunerTrial){solver, solver == SOLVER_BARNES_HUT ? sim->tree.theta : 0, seconds, error};
+}
+
+bool tuner_run(Tuner* t, Simulation* sim) {
+    size_t n = sim->bodies.size;
+    reserve(t, n);
+    size_t targets = pick_targets(t, n, sim->pool.workers), samples = pick_sample(t, n);
+    // The direct solvers are O(N) per target, so they get fewer targets past TUNER_DIRECT_PAIRS,
+    // though still a chunk per worker so that they're timed as parallel as the others
+    size_t direct = TUNER_DIRECT_PAIRS / n;
+    if(direct < FORCE_CHUNK * sim->pool.workers) direct = FORCE_CHUNK * sim->pool.workers;
+    if(direct > targets) direct = targets;
+    simulation_solver_forces(sim, SOLVER_DIRECT, t->sample, samples, t->reference);
+
+    float theta = sim->tree.theta;
+    t->count = 0;
+    for(Solver s = 0; s < SOLVER_COUNT; s++) {
+        // Prepared once untimed first, so that lazily grown buffers are already in place
+        simulation_prepare_solver(sim, s);
+        double start = thread_clock();
+        simulation_prepare_solver(sim, s);
+        double build = thread_clock() - start;
+        if(s == SOLVER_BARNES_HUT) {
+            for(size_t k = 0; k < EXT_ARR_SIZE(thetas); k++) {
+                sim->tree.theta = thetas[k];
+                t->candidates[t->count++] = try_solver(t, sim, s, build, targets, samples);
+            }
+            sim->tree.theta = theta;
+        } else {
+            bool quadratic = s == SOLVER_DIRECT || s == SOLVER_DIRECT_SIMD;
+            t->candidates[t->count++] =
+                try_solver(t, sim, s, build, quadratic ? direct : targets, samples);
+        }
+    }
+
+    // Direct summation comes first, and is always within budget
+    size_t best = 0;
+    for(size_t k = 1; k < t->count; k++) {
+        const TunerTrial* c = &t->candidates[k];
+        if(c->error <= t->force_error && c->seconds < t->candidates[best].seconds) best = k;
+    }
+    t->picked = best;
+    t->trials++;
+    t->tuned_size = n;
+
+    const TunerTrial* pick = &t->candidates[best];
+    bool is_tree = pick->solver == SOLVER_BARNES_HUT;
+    bool changed = pick->solver != sim->solver || (is_tree && pick->theta != sim->tree.theta);
+    sim->solver = pick->solver;
+    if(is_tree) sim->tree.theta = pick->theta;
+#ifdef SIMULATION_ENERGY
+    if(changed) simulation_reset_energy(sim);
+#endif
+
+    char angle[32] = "";
+    if(is_tree) snprintf(angle, sizeof(angle), " (theta = %.1f)", pick->theta);
+    ext_log(EXT_INFO,
+            "Tuner: %s%s for %zu bodies, %.3f ms per force pass, force error %.1e within %.1e",
+            solver_names[pick->solver], angle, n, pick->seconds * 1e3, pick->error,
+            t->force_error);
+    return changed;
+}
+
+bool tuner_update(Tuner* t, Simulation* sim) {
+    size_t n = sim->bodies.size;
+    if(n < 2) return false;
+    bool due = !t->trials || n >= t->tuned_size * TUNER_RETUNE_FACTOR ||
+               n * TUNER_RETUNE_FACTOR <= t->tuned_size;
+#ifdef SIMULATION_ENERGY
+    const EnergyStats* e = &sim->energy;
+    if(due) {
+        // Other bodies, maybe another timestep limit
+        t->drift_limited = false;
+        t->tightened_from = 0;
+    } else if(!t->drift_limited && e->samples >= TUNER_DRIFT_SAMPLES) {
+        float error = t->candidates[t->picked].error;
+        if(t->tightened_from > 0 && e->mean_drift > t->drift_before / 2) {
+            ext_log(EXT_WARNING,
+                    "Tuner: mean energy drift %.1e over %.1e regardless of the force error, "
+                    "limited by the timestep rather than the solver",
+                    e->mean_drift, t->drift_budget);
+            t->force_error = t->tightened_from;
+            t->drift_limited = true;
+            due = true;
+        } else if(e->mean_drift > t->drift_budget && error > TUNER_MIN_FORCE_ERROR) {
+            // Below the error of the pick, so that the next trials settle on a more accurate one
+            t->tightened_from = t->force_error;
+            t->drift_before = e->mean_drift;
+            t->force_error = fmaxf(error / 2, TUNER_MIN_FORCE_ERROR);
+            ext_log(EXT_INFO,
+                    "Tuner: mean energy drift %.1e over %.1e, force error tightened to %.1e",
+                    e->mean_drift, t->drift_budget, t->force_error);
+            due = true;
+        } else if(e->mean_drift > t->drift_budget) {
+            ext_log(EXT_WARNING,
+                    "Tuner: mean energy drift %.1e over %.1e with a force error of %.1e, "
+                    "limited by the timestep rather than the solver",
+                    e->mean_drift, t->drift_budget, error);
+            t->drift_limited = true;
+        } else {
+            t->tightened_from = 0;
+        }
+        // Measured again with whatever gets picked
+        if(due) simulation_reset_energy(sim);
+    }
+#endif
+    return due && tuner_run(t, sim);
+}
+
+void tuner_destroy(Tuner* t) {
+    ext_free(t->forces, sizeof(Vector2) * t->capacity);
+    ext_free(t->reference, sizeof(Vector2) * t->capacity);
+}
@@ -0,0 +1,114 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "raylib.h"
+#include "simulation.h"
+
+// Picks the force solver, and the opening angle of Barnes-Hut, from how they actually perform on
+// the current bodies and hardware rather than from fixed thresholds.
+// Trials time one force pass of every candidate (each CPU solver, and Barnes-Hut at each of
+// TUNER_THETAS) on TUNER_TARGETS bodies spread over the simulation, extrapolated to all bodies in
+// rounds of one chunk per worker, and measure its mean relative force error against direct
+// summation on TUNER_SAMPLE bodies. The fastest candidate whose error is within `force_error`
+// wins. Trials run on the first update, and again whenever the number of bodies grew or shrank by
+// TUNER_RETUNE_FACTOR since the last ones.
+// With energy diagnostics the drift is also watched in between, and keeps counting across merges
+// and escapes (see `EnergyStats`): once its mean over TUNER_DRIFT_SAMPLES samples exceeds
+// `drift_budget`, `force_error` is tightened to half the error of the pick, down to
+// TUNER_MIN_FORCE_ERROR, and the trials run again, which closes Barnes-Hut's opening angle or moves
+// to a more accurate solver. Tightening that doesn't at least halve the drift is undone: the drift
+// then comes from the timestep or close encounters, which no solver fixes, so it's left alone until
+// the number of bodies changes.
+// The mesh of PM softens forces over a few cells, so it only qualifies with a loose budget.
+// Picks are logged. They depend on timings, so sessions tuned this way can't be replayed.
+//
+// USAGE
+// ```c
+// Tuner t = tuner_new(.force_error = 1e-3f);
+// // between substeps
+// tuner_update(&t, &sim);
+// tuner_destroy(&t);
+// ```
+
+// Mean relative force error allowed by default, about that of Barnes-Hut at the default opening
+// angle, and the least it gets tightened to
+#define TUNER_FORCE_ERROR     (2e-2f)
+#define TUNER_MIN_FORCE_ERROR (1e-4f)
+// Mean relative drift of the total energy allowed by default
+#define TUNER_DRIFT_BUDGET (1e-3)
+// Energy samples the drift is averaged over before it's held against the budget
+#define TUNER_DRIFT_SAMPLES (8)
+// Change in the number of bodies since the last trials triggering new ones
+#define TUNER_RETUNE_FACTOR (2)
+// Bodies whose forces are timed, in runs of FORCE_CHUNK consecutive ones, and at least a run per
+// worker, then bodies the force error is measured on
+#define TUNER_TARGETS     (1024)
+#define TUNER_MAX_TARGETS (JOBS_MAX_WORKERS * FORCE_CHUNK)
+#define TUNER_SAMPLE      (256)
+// Pairs the direct solvers are timed on at most, so that trials stay short with many bodies
+#define TUNER_DIRECT_PAIRS ((size_t)1 << 24)
+// Opening angles tried for Barnes-Hut
+#define TUNER_THETAS(X) X(0.3f) X(0.5f) X(0.7f) X(0.9f) X(1.2f)
+#define TUNER_ONE_(theta) +1
+#define TUNER_CANDIDATES  (SOLVER_COUNT - 1 TUNER_THETAS(TUNER_ONE_))
+
+typedef struct {
+    Solver solver;
+    // Opening angle, Barnes-Hut only
+    float theta;
+    // Estimated seconds per force pass over all bodies, and mean relative force error
+    double seconds;
+    float error;
+} TunerTrial;
+
+typedef struct {
+    // Mean relative force error allowed
+    float force_error;
+#ifdef SIMULATION_ENERGY
+    // Mean relative energy drift allowed before tightening `force_error`
+    double drift_budget;
+#endif
+    // Trials run so far, the number of bodies at the last ones, their candidates and the index of
+    // the one picked
+    size_t trials, tuned_size;
+    TunerTrial candidates[TUNER_CANDIDATES];
+    size_t count, picked;
+
+    // Private fields
+    // Forces of the candidate being tried and of direct summation, indexed by body
+    Vector2 *forces, *reference;
+    size_t capacity;
+    uint32_t targets[TUNER_MAX_TARGETS], sample[TUNER_SAMPLE];
+#ifdef SIMULATION_ENERGY
+    // Budget before the last tightening while it's on trial, or 0, and the drift that caused it
+    float tightened_from;
+    double drift_before;
+    // Whether the drift was found to be over budget whatever the solver, which stops the
+    // tightening until the number of bodies changes
+    bool drift_limited;
+#endif
+} Tuner;
+
+// Creates a new tuner with default parameters, overridable with designated initializers
+#ifdef SIMULATION_ENERGY
+#define tuner_new(...) \
+    (Tuner) { .force_error = TUNER_FORCE_ERROR, .drift_budget = TUNER_DRIFT_BUDGET, __VA_ARGS__ }
+#else
+#define tuner_new(...) \
+    (Tuner) { .force_error = TUNER_FORCE_ERROR, __VA_ARGS__ }
+#endif
+
+// Runs trials if they are due, and watches the energy drift. To be called between substeps.
+// Returns whether the solver or the opening angle changed.
+bool tuner_update(Tuner* t, Simulation* sim);
+// Runs trials now and switches the simulation to the pick. Returns whether the solver or the
+// opening angle changed.
+bool tuner_run(Tuner* t, Simulation* sim);
+// Frees all memory associated with the tuner
+void tuner_destroy(Tuner* t);
+
+#endif